@@ -430,20 +430,22 @@ class bitVector {
 
   public:
 
-    bitVector() : _size(0)
+    bitVector() : _size(0), _owned(true)
     {
         _bitArray = nullptr;
+        sync_ranks();
     }
 
-    bitVector(uint64_t n) : _size(n)
+    bitVector(uint64_t n) : _size(n), _owned(true)
     {
         _nchar  = (1ULL+n/64ULL);
         _bitArray =  (uint64_t *) calloc (_nchar,sizeof(uint64_t));
+        sync_ranks();
     }
 
     ~bitVector()
     {
-        if(_bitArray != nullptr)
+        if(_bitArray != nullptr && _owned)
             free(_bitArray);
     }
 
@@ -452,9 +454,11 @@ class bitVector {
     {
         _size =  r._size;
         _nchar = r._nchar;
-        _ranks = r._ranks;
+        _ranks.assign(r._rank_data, r._rank_data + r._nranks);
+        _owned = true;
         _bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
         memcpy(_bitArray, r._bitArray, _nchar*sizeof(uint64_t) );
+        sync_ranks();
     }
 
     // Copy assignment operator
@@ -464,11 +468,13 @@ class bitVector {
         {
             _size =  r._size;
             _nchar = r._nchar;
-            _ranks = r._ranks;
-            if(_bitArray != nullptr)
+            _ranks.assign(r._rank_data, r._rank_data + r._nranks);
+            if(_bitArray != nullptr && _owned)
                 free(_bitArray);
+            _owned = true;
             _bitArray = (uint64_t *) calloc (_nchar,sizeof(uint64_t));
             memcpy(_bitArray, r._bitArray, _nchar*sizeof(uint64_t) );
+            sync_ranks();
         }
         return *this;
     }
@@ -479,19 +485,24 @@ class bitVector {
         //printf("bitVector move assignment \n");
         if (&r != this)
         {
-            if(_bitArray != nullptr)
+            if(_bitArray != nullptr && _owned)
                 free(_bitArray);
 
             _size =  std::move (r._size);
             _nchar = std::move (r._nchar);
             _ranks = std::move (r._ranks);
+            _owned = r._owned;
             _bitArray = r._bitArray;
+            _rank_data = r._rank_data;
+            _nranks = r._nranks;
             r._bitArray = nullptr;
+            r._owned = true;
+            r.sync_ranks();
         }
         return *this;
     }
     // Move constructor
-    bitVector(bitVector &&r) : _bitArray ( nullptr),_size(0)
+    bitVector(bitVector &&r) : _bitArray ( nullptr),_size(0), _owned(true)
     {
         *this = std::move(r);
     }
@@ -500,6 +511,7 @@ class bitVector {
     void resize(uint64_t newsize)
     {
         //printf("bitvector resize from  %llu bits to %llu \n",_size,newsize);
+        assert(_owned);
         _nchar  = (1ULL+newsize/64ULL);
         _bitArray = (uint64_t *) realloc(_bitArray,_nchar*sizeof(uint64_t));
         _size = newsize;
@@ -510,7 +522,7 @@ class bitVector {
         return _size;
     }
 
-    uint64_t bitSize() const {return (_nchar*64ULL + _ranks.capacity()*64ULL );}
+    uint64_t bitSize() const {return (_nchar*64ULL + (_owned ? _ranks.capacity() : _nranks)*64ULL );}
 
     //clear whole array
     void clear()
@@ -554,10 +566,10 @@ class bitVector {
         }
         printf("\n");
 
-        printf("rank array : size %lu \n",_ranks.size());
-        for (uint64_t ii = 0; ii< _ranks.size(); ii++)
+        printf("rank array : size %lu \n",_nranks);
+        for (uint64_t ii = 0; ii< _nranks; ii++)
         {
-            printf("%llu :  %lli,  ",ii,_ranks[ii]);
+            printf("%llu :  %lli,  ",ii,_rank_data[ii]);
         }
         printf("\n");
     }
@@ -609,6 +621,7 @@ class bitVector {
             }
             curent_rank +=  popcount_64(_bitArray[ii]);
         }
+        sync_ranks();
 
         return curent_rank;
     }
@@ -617,7 +630,7 @@ class bitVector {
         uint64_t word_idx = pos / 64ULL;
         uint64_t word_offset = pos % 64;
         uint64_t block = pos / _nb_bits_per_rank_sample;
-        uint64_t r = _ranks[block];
+        uint64_t r = _rank_data[block];
         for (uint64_t w = block * _nb_bits_per_rank_sample / 64; w < word_idx; ++w)
             r += popcount_64(_bitArray[w]);
         uint64_t mask = (uint64_t(1) << word_offset ) - 1;
@@ -626,15 +639,27 @@ class bitVector {
         return r;
     }
 
+    void prefetch(uint64_t pos) const {
+        __builtin_prefetch(_bitArray + (pos >> 6));
+    }
+
+    // Everything rank(pos) reads: the rank sample and the words since it
+    void prefetch_rank(uint64_t pos) const {
+        uint64_t block = pos / _nb_bits_per_rank_sample;
+        __builtin_prefetch(_rank_data + block);
+        __builtin_prefetch(_bitArray + block * _nb_bits_per_rank_sample / 64);
+        __builtin_prefetch(_bitArray + (pos >> 6));
+    }
+
 
 
     void save(std::ostream& os) const {
         os.write(reinterpret_cast<char const*>(&_size), sizeof(_size));
         os.write(reinterpret_cast<char const*>(&_nchar), sizeof(_nchar));
         os.write(reinterpret_cast<char const*>(_bitArray), (std::streamsize)(sizeof(uint64_t) * _nchar));
-        size_t sizer = _ranks.size();
+        size_t sizer = _nranks;
         os.write(reinterpret_cast<char const*>(&sizer),  sizeof(size_t));
-        os.write(reinterpret_cast<char const*>(_ranks.data()), (std::streamsize)(sizeof(_ranks[0]) * _ranks.size()));
+        os.write(reinterpret_cast<char const*>(_rank_data), (std::streamsize)(sizeof(_rank_data[0]) * _nranks));
     }
 
     void load(std::istream& is) {
@@ -647,6 +672,25 @@ class bitVector {
         is.read(reinterpret_cast<char *>(&sizer),  sizeof(size_t));
         _ranks.resize(sizer);
         is.read(reinterpret_cast<char*>(_ranks.data()), (std::streamsize)(sizeof(_ranks[0]) * _ranks.size()));
+        sync_ranks();
+    }
+
+    // Attach to the bitvector stored via save() in memory (e.g. mmap'ed file)
+    // without copying. The memory must outlive the bitvector and be 8-byte
+    // aligned. Returns the pointer past the end of the bitvector data.
+    const uint64_t *map(const uint64_t *data) {
+        if(_bitArray != nullptr && _owned)
+            free(_bitArray);
+        std::vector<uint64_t>().swap(_ranks);
+
+        _owned = false;
+        _size = data[0];
+        _nchar = data[1];
+        _bitArray = const_cast<uint64_t*>(data + 2);
+        _nranks = data[2 + _nchar];
+        _rank_data = data + 3 + _nchar;
+
+        return _rank_data + _nranks;
     }
 
 
@@ -660,6 +704,16 @@ class bitVector {
     // additional size for rank is epsilon * _size
     static const uint64_t _nb_bits_per_rank_sample = 512; //512 seems ok
     std::vector<uint64_t> _ranks;
+
+    // Rank samples used for queries: either _ranks or the mapped memory
+    const uint64_t *_rank_data;
+    uint64_t _nranks;
+    bool _owned;
+
+    void sync_ranks() {
+        _rank_data = _ranks.data();
+        _nranks = _ranks.size();
+    }
 };
 
 ////////////////////////////////////////////////////////////////
@@ -686,6 +740,10 @@ class level{
         return bitset.get(hashi);
     }
 
+    void prefetch(uint64_t hash_raw) const {
+        bitset.prefetch(fastrange64(hash_raw, hash_domain));
+    }
+
     uint64_t idx_begin;
     uint64_t hash_domain;
     bitVector bitset;
@@ -838,6 +896,64 @@ class mphf {
         return minimal_hp;
     }
 
+    // The lookup split into steps, so the lookups of several elements could be
+    // interleaved: every step tests a single level and prefetches the memory
+    // the next step of the same element needs. The result is the same as the
+    // one of lookup().
+    struct lookup_state {
+        hash_pair_t bbhash;
+        hash_pair_t xorshift;
+        uint64_t hash_raw;
+        int level;
+        bool done;
+    };
+
+    template<class elem_t>
+    void lookup_start(const elem_t &elem, lookup_state &s) const {
+        s.bbhash = _hasher.hashpair128(elem);
+        s.xorshift = s.bbhash;
+        s.hash_raw = s.bbhash[0];
+        s.level = 0;
+        s.done = !_built || _nb_levels == 1;
+        if (!s.done)
+            _levels[0].prefetch(s.hash_raw);
+    }
+
+    // Returns true when the level of the element is known
+    bool lookup_step(lookup_state &s) const {
+        if (s.done)
+            return true;
+
+        if (_levels[s.level].get(s.hash_raw)) {
+            s.done = true;
+            _levels[s.level].bitset.prefetch_rank(fastrange64(s.hash_raw, _levels[s.level].hash_domain));
+            return true;
+        }
+
+        s.level += 1;
+        if (s.level == _nb_levels - 1) {
+            s.done = true;
+            return true;
+        }
+
+        s.hash_raw = (s.level == 1 ? s.bbhash[1] : _hasher.next(s.xorshift));
+        _levels[s.level].prefetch(s.hash_raw);
+        return false;
+    }
+
+    uint64_t lookup_finish(const lookup_state &s) const {
+        if (!_built) return ULLONG_MAX;
+
+        if (s.level == (_nb_levels-1)) {
+            auto in_final_map  = _final_hash.find(s.bbhash);
+            if (in_final_map == _final_hash.end())
+                return ULLONG_MAX;
+            return in_final_map->second + _lastbitsetrank;
+        }
+
+        return _levels[s.level].bitset.rank(fastrange64(s.hash_raw, _levels[s.level].hash_domain));
+    }
+
     uint64_t size() const {
         return _nelem;
     }
@@ -1071,19 +1187,7 @@ class mphf {
 
 
 
-        //mini setup, recompute size of each level
-        _proba_collision = 1.0 -  pow(((_gamma*(double)_nelem -1 ) / (_gamma*(double)_nelem)),_nelem-1);
-        uint64_t previous_idx =0;
-        _hash_domain = (size_t)  (ceil(double(_nelem) * _gamma)) ;
-        for(int ii=0; ii<_nb_levels; ii++)
-        {
-            //_levels[ii] = new level();
-            _levels[ii].idx_begin = previous_idx;
-            _levels[ii].hash_domain =  (( (uint64_t) (_hash_domain * pow(_proba_collision,ii)) + 63) / 64 ) * 64;
-            if(_levels[ii].hash_domain == 0 )
-                _levels[ii].hash_domain  = 64 ;
-            previous_idx += _levels[ii].hash_domain;
-        }
+        restore_levels();
 
         //restore final hash
 
@@ -1105,9 +1209,74 @@ class mphf {
         _built = true;
     }
 
+    // Same as save(), but all the fields are 64-bit words, so the result
+    // could be used in-place via map()
+    void save_mapped(std::ostream& os) const {
+        uint64_t nb_levels = _nb_levels;
+        os.write(reinterpret_cast<char const*>(&_gamma), sizeof(_gamma));
+        os.write(reinterpret_cast<char const*>(&nb_levels), sizeof(nb_levels));
+        os.write(reinterpret_cast<char const*>(&_lastbitsetrank), sizeof(_lastbitsetrank));
+        os.write(reinterpret_cast<char const*>(&_nelem), sizeof(_nelem));
+        for(int ii=0; ii<_nb_levels; ii++)
+            _levels[ii].bitset.save(os);
+
+        uint64_t final_hash_size = _final_hash.size();
+        os.write(reinterpret_cast<char const*>(&final_hash_size), sizeof(final_hash_size));
+        for (auto it = _final_hash.begin(); it != _final_hash.end(); ++it) {
+            os.write(reinterpret_cast<char const*>(&(it->first)), sizeof(internal_hash_t));
+            os.write(reinterpret_cast<char const*>(&(it->second)), sizeof(uint64_t));
+        }
+    }
+
+    // Attach to the data written by save_mapped() without copying the
+    // bitsets. Only the (tiny) final hash is loaded into memory. Returns
+    // the pointer past the end of mphf data.
+    const uint64_t *map(const uint64_t *data) {
+        static_assert(sizeof(_gamma) == sizeof(uint64_t), "unexpected layout");
+        memcpy(&_gamma, data, sizeof(_gamma));
+        _nb_levels = (int)data[1];
+        _lastbitsetrank = data[2];
+        _nelem = data[3];
+        data += 4;
+
+        _levels.resize(_nb_levels);
+        for(int ii=0; ii<_nb_levels; ii++)
+            data = _levels[ii].bitset.map(data);
+
+        restore_levels();
+
+        _final_hash.clear();
+        uint64_t final_hash_size = *data++;
+        for (uint64_t ii = 0; ii < final_hash_size; ii++) {
+            internal_hash_t key;
+            memcpy(&key, data, sizeof(internal_hash_t));
+            data += sizeof(internal_hash_t) / sizeof(uint64_t);
+            _final_hash[key] = *data++;
+        }
+        _built = true;
+
+        return data;
+    }
+
 
   private :
 
+    // mini setup after load, recompute size of each level
+    void restore_levels() {
+        _proba_collision = 1.0 -  pow(((_gamma*(double)_nelem -1 ) / (_gamma*(double)_nelem)),_nelem-1);
+        uint64_t previous_idx =0;
+        _hash_domain = (size_t)  (ceil(double(_nelem) * _gamma)) ;
+        for(int ii=0; ii<_nb_levels; ii++)
+        {
+            //_levels[ii] = new level();
+            _levels[ii].idx_begin = previous_idx;
+            _levels[ii].hash_domain =  (( (uint64_t) (_hash_domain * pow(_proba_collision,ii)) + 63) / 64 ) * 64;
+            if(_levels[ii].hash_domain == 0 )
+                _levels[ii].hash_domain  = 64 ;
+            previous_idx += _levels[ii].hash_domain;
+        }
+    }
+
     void setup()
     {
         pthread_mutex_init(&_mutex, NULL);
@@ -309,6 +309,8 @@ def fill_cfg(options_to_parse, log, secondary_filling=False):
                               ' (should be either 33, 64, or \'auto\')', log)
         elif opt == "--save-gp":
             options_storage.save_gp = True
+        elif opt == "--single-process-k":
+            options_storage.single_process_k = True
         elif opt == "--cov-cutoff":
             if arg == 'auto' or arg == 'off':
                 options_storage.cov_cutoff = arg
@@ -506,6 +508,7 @@ def fill_cfg(options_to_parse, log, secondary_filling=False):
         cfg["assembly"].__dict__["cov_cutoff"] = options_storage.cov_cutoff
         cfg["assembly"].__dict__["lcer_cutoff"] = options_storage.lcer_cutoff
         cfg["assembly"].__dict__["save_gp"] = options_storage.save_gp
+        cfg["assembly"].__dict__["single_process_k"] = options_storage.single_process_k
         if options_storage.spades_heap_check:
             cfg["assembly"].__dict__["heap_check"] = options_storage.spades_heap_check
         if options_storage.read_buffer_size:
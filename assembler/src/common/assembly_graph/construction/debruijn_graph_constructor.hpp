@@ -190,6 +190,8 @@ private:
 
     Index &origin_;
     size_t kmer_size_;
+    // If provided, sequences are stored in the arena instead of separate buffers
+    SequenceArena *arena_;
 
     bool IsJunction(KeyWithHash kwh) const {
         return IsJunction(origin_.get_value(kwh));
@@ -234,7 +236,7 @@ private:
         return false;
     }
 
-    Sequence ConstructSequenceWithEdge(DeEdge edge, SequenceBuilder &builder) const {
+    void BuildSequenceWithEdge(DeEdge edge, SequenceBuilder &builder) const {
         builder.clear(); // We reuse the buffer to reduce malloc traffic
         builder.append(edge.start.key());
         builder.append(edge.end[kmer_size_ - 1]);
@@ -242,7 +244,26 @@ private:
         while (StepRightIfPossible(edge) && edge != initial) {
             builder.append(edge.end[kmer_size_ - 1]);
         }
-        return builder.BuildSequence();
+    }
+
+    Sequence BuildSequence(SequenceBuilder &builder) const {
+        return arena_ ? arena_->Append(builder) : builder.BuildSequence();
+    }
+
+    Sequence ConstructSequenceWithEdge(DeEdge edge, SequenceBuilder &builder) const {
+        BuildSequenceWithEdge(edge, builder);
+        return BuildSequence(builder);
+    }
+
+    // Same as !(s < !s) for the sequence s in builder, allows to skip
+    // non-canonical sequences before they are stored
+    static bool IsCanonical(const SequenceBuilder &builder) {
+        for (size_t i = 0, j = builder.size(); i < builder.size(); ++i) {
+            char c = builder[i], rc = complement(builder[--j]);
+            if (c != rc)
+                return c > rc;
+        }
+        return true;
     }
 
     // Loop consists of 4 parts: 2 selfRC k+1-mers and two sequences of arbitrary length RC to each other; pos is a position of one of selfRC edges
@@ -276,10 +297,11 @@ private:
             AddStartDeEdges(kh, start_edges);
 
             for (auto edge : start_edges) {
-                Sequence s = ConstructSequenceWithEdge(edge, builder);
-                if (s < !s)
+                BuildSequenceWithEdge(edge, builder);
+                if (!IsCanonical(builder))
                     continue;
 
+                Sequence s = BuildSequence(builder);
                 sequences.push_back(s);
                 TRACE("From " << edge << " calculated sequence\n" << s);
             }
@@ -345,8 +367,8 @@ private:
     }
 
 public:
-    UnbranchingPathExtractor(Index &origin, size_t k)
-            : origin_(origin), kmer_size_(k) {}
+    UnbranchingPathExtractor(Index &origin, size_t k, SequenceArena *arena = nullptr)
+            : origin_(origin), kmer_size_(k), arena_(arena) {}
 
     //TODO very large vector is returned. But I hate to make all those artificial changes that can fix it.
     const std::vector<Sequence> ExtractUnbranchingPaths(unsigned nchunks) const {
@@ -532,9 +554,9 @@ public:
         std::vector<Sequence> edge_sequences;
         unsigned nchunks = 16 * omp_get_max_threads();
         if (keep_perfect_loops)
-            edge_sequences = UnbranchingPathExtractor(origin_, kmer_size_).ExtractUnbranchingPathsAndLoops(nchunks);
+            edge_sequences = UnbranchingPathExtractor(origin_, kmer_size_, &graph_.master().arena()).ExtractUnbranchingPathsAndLoops(nchunks);
         else
-            edge_sequences = UnbranchingPathExtractor(origin_, kmer_size_).ExtractUnbranchingPaths(nchunks);
+            edge_sequences = UnbranchingPathExtractor(origin_, kmer_size_, &graph_.master().arena()).ExtractUnbranchingPaths(nchunks);
         FastGraphFromSequencesConstructor<Graph>(kmer_size_, origin_).ConstructGraph(graph_, edge_sequences);
     }
 
@@ -109,6 +109,40 @@ public:
     virtual void HandleSplit(EdgeId /*old_edge*/, EdgeId /*new_edge_1*/,
                              EdgeId /*new_edge_2*/) { }
 
+    /**
+     * Batched low level event which is triggered for handlers accepting batches when the batch
+     * of graph modifications is finished (see ObservableGraph::BeginBatch) instead of
+     * HandleDelete(EdgeId) for the edges which existed before the batch and were deleted during it.
+     * The edges are already unlinked from the graph by then, but their data (nucleotides, coverage)
+     * and conjugates are still available. Their start and end vertices could be already deleted,
+     * so they should not be accessed. Paired handlers get both edges of each conjugate pair.
+     * @param edges deleted edges
+     */
+    virtual void HandleBatchDelete(const std::vector<EdgeId> &edges) {
+        for (EdgeId e : edges)
+            HandleDelete(e);
+    }
+
+    /**
+     * Batched low level event which is triggered for handlers accepting batches right after
+     * HandleBatchDelete instead of HandleAdd(EdgeId) for the edges which were added during the
+     * batch and still exist. Paired handlers get both edges of each conjugate pair.
+     * @param edges new edges
+     */
+    virtual void HandleBatchAdd(const std::vector<EdgeId> &edges) {
+        for (EdgeId e : edges)
+            HandleAdd(e);
+    }
+
+    /**
+     * Handlers which do not depend on the order of edge additions and deletions relative to the
+     * other events could override this method to receive them with HandleBatchDelete and
+     * HandleBatchAdd. All the other events are still triggered one by one.
+     */
+    virtual bool AcceptsBatches() const {
+        return false;
+    }
+
     /**
      * Every thread safe descendant should override this method for correct concurrent graph processing.
      */
@@ -191,6 +225,12 @@ public:
     virtual void
             ApplyDelete(Handler &handler, EdgeId e) const = 0;
 
+    virtual void
+            ApplyAdd(Handler &handler, const std::vector<EdgeId> &edges) const = 0;
+
+    virtual void
+            ApplyDelete(Handler &handler, const std::vector<EdgeId> &edges) const = 0;
+
     virtual void ApplyMerge(Handler &handler, const std::vector<EdgeId> &old_edges,
                             EdgeId new_edge) const = 0;
 
@@ -231,6 +271,14 @@ public:
         handler.HandleDelete(e);
     }
 
+    void ApplyAdd(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleBatchAdd(edges);
+    }
+
+    void ApplyDelete(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleBatchDelete(edges);
+    }
+
     void ApplyMerge(Handler &handler, const std::vector<EdgeId> &old_edges,
                             EdgeId new_edge) const override {
         handler.HandleMerge(old_edges, new_edge);
@@ -274,6 +322,19 @@ private:
         return rc_path;
     }
 
+    std::vector<EdgeId> WithConjugates(const std::vector<EdgeId> &edges) const {
+        std::vector<EdgeId> res;
+        res.reserve(2 * edges.size());
+        for (EdgeId e : edges) {
+            EdgeId rce = graph_.conjugate(e);
+            res.push_back(e);
+            if (e != rce) {
+                res.push_back(rce);
+            }
+        }
+        return res;
+    }
+
 public:
     PairedHandlerApplier(Graph &graph)
             : graph_(graph) {
@@ -311,6 +372,14 @@ public:
         }
     }
 
+    void ApplyAdd(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleBatchAdd(WithConjugates(edges));
+    }
+
+    void ApplyDelete(Handler &handler, const std::vector<EdgeId> &edges) const override {
+        handler.HandleBatchDelete(WithConjugates(edges));
+    }
+
     void ApplyMerge(Handler &handler, const std::vector<EdgeId> &old_edges,
                             EdgeId new_edge) const override {
         EdgeId rce = graph_.conjugate(new_edge);
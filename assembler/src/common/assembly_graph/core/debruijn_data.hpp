@@ -12,6 +12,7 @@
 #include "utils/verify.hpp"
 #include "utils/logger/logger.hpp"
 #include "sequence/sequence_tools.hpp"
+#include "sequence/sequence_arena.hpp"
 #include "utils/standard_base.hpp"
 
 namespace debruijn_graph {
@@ -97,13 +98,21 @@ public:
 class DeBruijnDataMaster {
 private:
     const size_t k_;
+    // Shared storage of edge nucleotides of the constructed graph. Conjugate
+    // edges and split parts are views into the same ranges, merged edges get
+    // their own buffers (see SequenceArena::Merge).
+    std::shared_ptr<SequenceArena> arena_;
 
 public:
     typedef DeBruijnVertexData VertexData;
     typedef DeBruijnEdgeData EdgeData;
 
     DeBruijnDataMaster(size_t k) :
-            k_(k) {
+            k_(k), arena_(std::make_shared<SequenceArena>()) {
+    }
+
+    SequenceArena &arena() const {
+        return *arena_;
     }
 
     const EdgeData MergeData(const std::vector<const EdgeData*>& to_merge, bool safe_merging = true) const;
@@ -148,7 +157,7 @@ inline const DeBruijnEdgeData DeBruijnDataMaster::MergeData(const std::vector<co
     for (auto it = to_merge.begin(); it != to_merge.end(); ++it) {
         ss.push_back((*it)->nucls());
     }
-    return EdgeData(MergeOverlappingSequences(ss, k_, safe_merging));
+    return EdgeData(SequenceArena::Merge(ss, k_, safe_merging));
 }
 
 inline std::pair<DeBruijnVertexData, std::pair<DeBruijnEdgeData, DeBruijnEdgeData>> DeBruijnDataMaster::SplitData(const EdgeData& edge,
@@ -0,0 +1,354 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <type_traits>
+#include <utility>
+#include <cstdlib>
+#include <cstdint>
+
+namespace omnigraph {
+
+/**
+ * Arena for graph elements (vertices or edges) addressed by their int ids.
+ *
+ * Elements live in fixed-size chunks of slots, slot of the element is
+ * defined by its id, so the elements are never moved and their pointers are
+ * stable. Chunks are allocated lazily; the chunk which became empty is put to
+ * the free list and reused later. Chunks emptied inside a parallel region are
+ * only recorded there and released at the next sequential create / destroy
+ * or ReleaseEmptyChunks call. Ids coming from different distributors
+ * never clash, so creation and destruction of distinct elements could happen
+ * concurrently without any locking (apart from rare chunk allocation).
+ *
+ * Every element is either detached (just created) or attached (belongs to the
+ * graph). Attached elements could be iterated in the increasing order of ids
+ * via linear scan of the slots.
+ */
+template<class T>
+class ElementStorage : private boost::noncopyable {
+public:
+    static const unsigned ChunkBits = 12;
+    static const size_t ChunkSize = size_t(1) << ChunkBits;
+
+private:
+    static const unsigned DirBits = 10;
+    static const unsigned TopBits = 10;
+    static const size_t DirSize = size_t(1) << DirBits;
+    static const size_t TopSize = size_t(1) << TopBits;
+
+    enum SlotState : uint8_t {
+        Free = 0,
+        Detached = 1,
+        Attached = 2
+    };
+
+    struct Chunk {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[ChunkSize];
+        std::atomic<uint8_t> state[ChunkSize];
+        std::atomic<size_t> live;
+
+        Chunk() : live(0) {
+            for (auto &s : state)
+                s.store(Free, std::memory_order_relaxed);
+        }
+
+        T *slot(size_t idx) {
+            return reinterpret_cast<T*>(&slots[idx]);
+        }
+    };
+
+    struct Dir {
+        std::atomic<Chunk*> chunks[DirSize];
+
+        Dir() {
+            for (auto &c : chunks)
+                c.store(nullptr, std::memory_order_relaxed);
+        }
+    };
+
+public:
+    static const size_t MaxId = TopSize * DirSize * ChunkSize;
+    static const size_t npos = size_t(-1);
+
+    class const_iterator : public boost::iterator_facade<const_iterator,
+            std::pair<T*, size_t>, boost::forward_traversal_tag, std::pair<T*, size_t>> {
+    public:
+        const_iterator()
+                : storage_(nullptr), id_(npos) {}
+
+        const_iterator(const ElementStorage *storage, size_t id)
+                : storage_(storage), id_(id) {}
+
+        size_t id() const { return id_; }
+
+    private:
+        friend class boost::iterator_core_access;
+
+        void increment() {
+            id_ = storage_->next_attached(id_ + 1);
+        }
+
+        bool equal(const const_iterator &other) const {
+            return id_ == other.id_;
+        }
+
+        std::pair<T*, size_t> dereference() const {
+            return { storage_->get(id_), id_ };
+        }
+
+        const ElementStorage *storage_;
+        size_t id_;
+    };
+
+    ElementStorage()
+            : attached_(0), max_id_(0), first_hint_(npos), has_emptied_(false) {
+        for (auto &d : top_)
+            d.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~ElementStorage() {
+        for (auto &d : top_) {
+            Dir *dir = d.load(std::memory_order_relaxed);
+            if (!dir)
+                continue;
+            for (auto &c : dir->chunks) {
+                Chunk *chunk = c.load(std::memory_order_relaxed);
+                if (!chunk)
+                    continue;
+                for (size_t i = 0; i < ChunkSize && chunk->live; ++i)
+                    if (chunk->state[i].load(std::memory_order_relaxed) != Free) {
+                        chunk->slot(i)->~T();
+                        chunk->live -= 1;
+                    }
+                delete chunk;
+            }
+            delete dir;
+        }
+
+        for (Chunk *chunk : free_chunks_)
+            delete chunk;
+    }
+
+    template<class... Args>
+    T *create(size_t id, Args&&... args) {
+        if (has_emptied_.load(std::memory_order_relaxed) && !omp_in_parallel())
+            ReleaseEmptyChunks();
+
+        Chunk *chunk = ensure_chunk(id);
+        size_t idx = id & (ChunkSize - 1);
+        VERIFY(chunk->state[idx].load(std::memory_order_relaxed) == Free);
+
+        T *res = new (chunk->slot(idx)) T(std::forward<Args>(args)...);
+        chunk->live.fetch_add(1, std::memory_order_relaxed);
+        chunk->state[idx].store(Detached, std::memory_order_release);
+
+        size_t max_id = max_id_.load(std::memory_order_relaxed);
+        while (max_id < id + 1 &&
+               !max_id_.compare_exchange_weak(max_id, id + 1, std::memory_order_relaxed));
+
+        return res;
+    }
+
+    void destroy(size_t id) {
+        Chunk *chunk = find_chunk(id);
+        size_t idx = id & (ChunkSize - 1);
+        VERIFY(chunk);
+        uint8_t state = chunk->state[idx].exchange(Free, std::memory_order_acq_rel);
+        VERIFY(state != Free);
+        if (state == Attached)
+            attached_.fetch_sub(1, std::memory_order_relaxed);
+
+        chunk->slot(idx)->~T();
+        // Chunks could not be reclaimed safely while other threads might
+        // create elements in them, so the ones emptied in parallel are deferred
+        bool emptied = chunk->live.fetch_sub(1, std::memory_order_acq_rel) == 1;
+        if (omp_in_parallel()) {
+            if (emptied) {
+                std::lock_guard<std::mutex> lock(free_lock_);
+                emptied_chunks_.push_back(id >> ChunkBits);
+                has_emptied_.store(true, std::memory_order_relaxed);
+            }
+            return;
+        }
+
+        if (emptied)
+            release_chunk(id);
+        if (has_emptied_.load(std::memory_order_relaxed))
+            ReleaseEmptyChunks();
+    }
+
+    // Puts the chunks emptied inside parallel regions to the free list,
+    // should be called in sequential code
+    void ReleaseEmptyChunks() {
+        VERIFY(!omp_in_parallel());
+        std::vector<size_t> emptied;
+        {
+            std::lock_guard<std::mutex> lock(free_lock_);
+            emptied.swap(emptied_chunks_);
+            has_emptied_.store(false, std::memory_order_relaxed);
+        }
+
+        // Chunk could be filled again or recorded several times since
+        for (size_t chunk_idx : emptied) {
+            size_t id = chunk_idx << ChunkBits;
+            Chunk *chunk = find_chunk(id);
+            if (chunk && chunk->live.load(std::memory_order_acquire) == 0)
+                release_chunk(id);
+        }
+    }
+
+    void attach(size_t id) {
+        Chunk *chunk = find_chunk(id);
+        size_t idx = id & (ChunkSize - 1);
+        VERIFY(chunk);
+        uint8_t expected = Detached;
+        if (!chunk->state[idx].compare_exchange_strong(expected, Attached))
+            return;
+        attached_.fetch_add(1, std::memory_order_relaxed);
+
+        size_t hint = first_hint_.load(std::memory_order_relaxed);
+        while (id < hint &&
+               !first_hint_.compare_exchange_weak(hint, id, std::memory_order_relaxed));
+    }
+
+    void detach(size_t id) {
+        Chunk *chunk = find_chunk(id);
+        size_t idx = id & (ChunkSize - 1);
+        VERIFY(chunk);
+        uint8_t expected = Attached;
+        if (chunk->state[idx].compare_exchange_strong(expected, Detached))
+            attached_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    T *get(size_t id) const {
+        Chunk *chunk = find_chunk(id);
+        VERIFY(chunk);
+        return chunk->slot(id & (ChunkSize - 1));
+    }
+
+    // Number of attached elements
+    size_t size() const {
+        return attached_.load(std::memory_order_relaxed);
+    }
+
+    const_iterator begin() const {
+        size_t hint = first_hint_.load(std::memory_order_relaxed);
+        size_t first = next_attached(hint == npos ? 0 : hint);
+        // Nothing could be attached before the hint, so we could safely advance it
+        first_hint_.compare_exchange_strong(hint, first, std::memory_order_relaxed);
+        return const_iterator(this, first);
+    }
+
+    const_iterator end() const {
+        return const_iterator(this, npos);
+    }
+
+private:
+    std::atomic<Dir*> top_[TopSize];
+    std::atomic<size_t> attached_;
+    std::atomic<size_t> max_id_;
+    mutable std::atomic<size_t> first_hint_;
+
+    std::mutex free_lock_;
+    std::vector<Chunk*> free_chunks_;
+    // Indices of the chunks emptied inside parallel regions
+    std::vector<size_t> emptied_chunks_;
+    std::atomic<bool> has_emptied_;
+
+    static size_t top_idx(size_t id) { return id >> (ChunkBits + DirBits); }
+    static size_t dir_idx(size_t id) { return (id >> ChunkBits) & (DirSize - 1); }
+
+    Chunk *find_chunk(size_t id) const {
+        Dir *dir = top_[top_idx(id)].load(std::memory_order_acquire);
+        if (!dir)
+            return nullptr;
+        return dir->chunks[dir_idx(id)].load(std::memory_order_acquire);
+    }
+
+    Chunk *ensure_chunk(size_t id) {
+        VERIFY_MSG(id < MaxId, "Graph element id " << id << " is too large");
+
+        std::atomic<Dir*> &dslot = top_[top_idx(id)];
+        Dir *dir = dslot.load(std::memory_order_acquire);
+        if (!dir) {
+            Dir *fresh = new Dir();
+            if (dslot.compare_exchange_strong(dir, fresh, std::memory_order_acq_rel))
+                dir = fresh;
+            else
+                delete fresh;
+        }
+
+        std::atomic<Chunk*> &cslot = dir->chunks[dir_idx(id)];
+        Chunk *chunk = cslot.load(std::memory_order_acquire);
+        if (chunk)
+            return chunk;
+
+        Chunk *fresh = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(free_lock_);
+            if (!free_chunks_.empty()) {
+                fresh = free_chunks_.back();
+                free_chunks_.pop_back();
+            }
+        }
+        if (!fresh)
+            fresh = new Chunk();
+
+        if (cslot.compare_exchange_strong(chunk, fresh, std::memory_order_acq_rel))
+            return fresh;
+
+        std::lock_guard<std::mutex> lock(free_lock_);
+        free_chunks_.push_back(fresh);
+        return chunk;
+    }
+
+    void release_chunk(size_t id) {
+        Dir *dir = top_[top_idx(id)].load(std::memory_order_acquire);
+        Chunk *chunk = dir->chunks[dir_idx(id)].exchange(nullptr, std::memory_order_acq_rel);
+        VERIFY(chunk && chunk->live == 0);
+
+        std::lock_guard<std::mutex> lock(free_lock_);
+        free_chunks_.push_back(chunk);
+    }
+
+    // Returns the id of the first attached element starting from the given
+    // one, or npos if there is no such element
+    size_t next_attached(size_t id) const {
+        size_t limit = max_id_.load(std::memory_order_acquire);
+        while (id < limit) {
+            Dir *dir = top_[top_idx(id)].load(std::memory_order_acquire);
+            if (!dir) {
+                id = (top_idx(id) + 1) << (ChunkBits + DirBits);
+                continue;
+            }
+            Chunk *chunk = dir->chunks[dir_idx(id)].load(std::memory_order_acquire);
+            if (!chunk || chunk->live.load(std::memory_order_relaxed) == 0) {
+                id = ((id >> ChunkBits) + 1) << ChunkBits;
+                continue;
+            }
+
+            size_t chunk_end = ((id >> ChunkBits) + 1) << ChunkBits;
+            for (; id < chunk_end && id < limit; ++id)
+                if (chunk->state[id & (ChunkSize - 1)].load(std::memory_order_acquire) == Attached)
+                    return id;
+        }
+
+        return npos;
+    }
+};
+
+}
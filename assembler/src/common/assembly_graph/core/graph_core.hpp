@@ -11,12 +11,12 @@
 #include "utils/verify.hpp"
 #include "utils/logger/logger.hpp"
 #include "order_and_law.hpp"
+#include "element_storage.hpp"
 #include "utils/stl_utils.hpp"
 
 #include "adt/small_pod_vector.hpp"
 
 #include <boost/iterator/iterator_facade.hpp>
-#include <btree/safe_btree_set.h>
 
 namespace omnigraph {
 
@@ -44,6 +44,7 @@ class PairedEdge {
     friend class GraphCore<DataMaster>;
     friend class ConstructionHelper<DataMaster>;
     friend class PairedElementManipulationHelper<EdgeId>;
+    friend class ElementStorage<PairedEdge<DataMaster>>;
     //todo unfriend
     friend class PairedVertex<DataMaster>;
     VertexId end_;
@@ -138,6 +139,7 @@ private:
     friend class ConstructionHelper<DataMaster>;
     friend class PairedEdge<DataMaster>;
     friend class PairedElementManipulationHelper<VertexId>;
+    friend class ElementStorage<PairedVertex<DataMaster>>;
     friend class conjugate_iterator;
 
     adt::SmallPODVector<EdgeId> outgoing_edges_;
@@ -235,33 +237,81 @@ public:
     typedef typename DataMasterT::EdgeData EdgeData;
     typedef restricted::pure_pointer<PairedEdge<DataMaster>> EdgeId;
     typedef restricted::pure_pointer<PairedVertex<DataMaster>> VertexId;
-    typedef btree::safe_btree_set<VertexId> VertexContainer;
-    typedef typename VertexContainer::const_iterator VertexIt;
+    typedef ElementStorage<PairedVertex<DataMaster>> VertexStorage;
+    typedef ElementStorage<PairedEdge<DataMaster>> EdgeStorage;
     typedef typename PairedVertex<DataMaster>::edge_const_iterator edge_const_iterator;
 
+    // Iterates over the vertices of the graph in the order of their ids
+    class VertexIt : public boost::iterator_facade<VertexIt,
+            VertexId, boost::forward_traversal_tag, VertexId> {
+    public:
+        VertexIt() {}
+
+        explicit VertexIt(typename VertexStorage::const_iterator it)
+                : it_(it) {}
+
+    private:
+        friend class boost::iterator_core_access;
+
+        void increment() {
+            ++it_;
+        }
+
+        bool equal(const VertexIt &other) const {
+            return it_ == other.it_;
+        }
+
+        VertexId dereference() const {
+            auto entry = *it_;
+            return VertexId(entry.first, entry.second);
+        }
+
+        typename VertexStorage::const_iterator it_;
+    };
+
+    // Lightweight view of the graph vertex set
+    class VertexContainer {
+    public:
+        typedef VertexId value_type;
+        typedef VertexIt const_iterator;
+
+        VertexContainer(VertexIt begin, VertexIt end)
+                : begin_(begin), end_(end) {}
+
+        const_iterator begin() const { return begin_; }
+        const_iterator end() const { return end_; }
+
+    private:
+        VertexIt begin_, end_;
+    };
+
 private:
    restricted::LocalIdDistributor id_distributor_;
    DataMaster master_;
-   VertexContainer vertices_;
+   VertexStorage vertices_;
+   EdgeStorage edges_;
 
    friend class ConstructionHelper<DataMaster>;
 public:
    VertexIt begin() const {
-       return vertices_.begin();
+       return VertexIt(vertices_.begin());
    }
 
    VertexIt end() const {
-       return vertices_.end();
-   }
-
-   const std::set<VertexId>& vertices() const {
-       return vertices_;
+       return VertexIt(vertices_.end());
    }
 
    size_t size() const {
        return vertices_.size();
    }
 
+   // Frees the storage of the elements deleted inside parallel regions,
+   // should be called in sequential code
+   void ReleaseEmptyChunks() {
+       vertices_.ReleaseEmptyChunks();
+       edges_.ReleaseEmptyChunks();
+   }
+
    edge_const_iterator out_begin(VertexId v) const {
        return v->out_begin();
    }
@@ -280,14 +330,14 @@ public:
 
 private:
    void DeleteVertexFromGraph(VertexId vertex) {
-       this->vertices_.erase(vertex);
-       this->vertices_.erase(conjugate(vertex));
+       this->vertices_.detach(vertex.int_id());
+       this->vertices_.detach(conjugate(vertex).int_id());
    }
 
    void DestroyVertex(VertexId vertex) {
        VertexId conjugate = vertex->conjugate();
-       delete vertex.get();
-       delete conjugate.get();
+       vertices_.destroy(vertex.int_id());
+       vertices_.destroy(conjugate.int_id());
    }
 
    bool AdditionalCompressCondition(VertexId v) const {
@@ -296,9 +346,17 @@ private:
 
 protected:
 
+   void DestroyEdge(EdgeId edge) {
+       EdgeId conjugate = edge->conjugate();
+       if (edge != conjugate)
+           edges_.destroy(conjugate.int_id());
+       edges_.destroy(edge.int_id());
+   }
+
    VertexId CreateVertex(const VertexData& data1, const VertexData& data2, restricted::IdDistributor& id_distributor) {
-       VertexId vertex1(new PairedVertex<DataMaster>(data1), id_distributor);
-       VertexId vertex2(new PairedVertex<DataMaster>(data2), id_distributor);
+       size_t id1 = id_distributor.GetId(), id2 = id_distributor.GetId();
+       VertexId vertex1(vertices_.create(id1, data1), id1);
+       VertexId vertex2(vertices_.create(id2, data2), id2);
        vertex1->set_conjugate(vertex2);
        vertex2->set_conjugate(vertex1);
        return vertex1;
@@ -313,8 +371,8 @@ protected:
     }
 
     void AddVertexToGraph(VertexId vertex) {
-        vertices_.insert(vertex);
-        vertices_.insert(conjugate(vertex));
+        vertices_.attach(vertex.int_id());
+        vertices_.attach(conjugate(vertex).int_id());
     }
 
     VertexId HiddenAddVertex(const VertexData& data, restricted::IdDistributor& id_distributor) {
@@ -337,7 +395,8 @@ protected:
     ////what with this method?
     EdgeId AddSingleEdge(VertexId v1, VertexId v2, const EdgeData &data,
                          restricted::IdDistributor &idDistributor) {
-        EdgeId newEdge(new PairedEdge<DataMaster>(v2, data), idDistributor);
+        size_t id = idDistributor.GetId();
+        EdgeId newEdge(edges_.create(id, v2, data), id);
         if (v1 != VertexId())
             v1->AddOutgoingEdge(newEdge);
         return newEdge;
@@ -381,17 +440,19 @@ protected:
         return HiddenAddEdge(v1, v2, data, id_distributor_);
     }
 
-    void HiddenDeleteEdge(EdgeId edge) {
-        TRACE("Hidden delete edge " << edge.int_id());
+    //edge data stays available until DestroyEdge
+    void HiddenUnlinkEdge(EdgeId edge) {
         EdgeId rcEdge = conjugate(edge);
         VertexId rcStart = conjugate(edge->end());
         VertexId start = conjugate(rcEdge->end());
         start->RemoveOutgoingEdge(edge);
         rcStart->RemoveOutgoingEdge(rcEdge);
-        if (edge != rcEdge) {
-            delete rcEdge.get();
-        }
-        delete edge.get();
+    }
+
+    void HiddenDeleteEdge(EdgeId edge) {
+        TRACE("Hidden delete edge " << edge.int_id());
+        HiddenUnlinkEdge(edge);
+        DestroyEdge(edge);
     }
 
     void HiddenDeletePath(const std::vector<EdgeId>& edgesToDelete, const std::vector<VertexId>& verticesToDelete) {
@@ -9,7 +9,10 @@
 
 #include <vector>
 #include <set>
+#include <algorithm>
+#include <iterator>
 #include <cstring>
+#include <boost/noncopyable.hpp>
 #include "utils/logger/logger.hpp"
 #include "graph_core.hpp"
 #include "graph_iterators.hpp"
@@ -40,6 +43,12 @@ private:
    //todo switch to smart iterators
    mutable std::vector<Handler*> action_handler_list_;
    const HandlerApplier<VertexId, EdgeId> *applier_;
+   size_t batch_depth_;
+   //edge events are collected only if some attached handler accepts batches
+   bool batching_;
+   //edges added and deleted during the batch, deleted ones are unlinked from the graph but not destroyed yet
+   mutable std::vector<EdgeId> batch_added_edges_;
+   mutable std::vector<EdgeId> batch_deleted_edges_;
 
 public:
 //todo move to graph core
@@ -81,6 +90,18 @@ public:
 
     bool VerifyAllDetached();
 
+    /**
+     * Starts the batch of graph modifications, batches could be nested. Edge additions and deletions
+     * are passed to the handlers accepting batches at once when the outermost batch is finished, the
+     * other handlers are notified as usual. Deleted edges are unlinked from the graph immediately, but
+     * destroyed only after the batch. If no attached handler accepts batches, the batch has no effect
+     * and deleted edges are destroyed immediately. The graph should not be modified concurrently or with
+     * ConstructionHelper inside a batch, handlers accepting batches should not be attached or detached.
+     */
+    void BeginBatch();
+
+    void EndBatch();
+
     //smart iterators
     template<typename Comparator>
     SmartVertexIterator<ObservableGraph, Comparator> SmartVertexBegin(
@@ -110,7 +131,7 @@ public:
     void FireDeletePath(const std::vector<EdgeId>& edges_to_delete, const std::vector<VertexId>& vertices_to_delete) const;
 
     ObservableGraph(const DataMaster& master) :
-            base(master), applier_(new PairedHandlerApplier<ObservableGraph>(*this)) {
+            base(master), applier_(new PairedHandlerApplier<ObservableGraph>(*this)), batch_depth_(0), batching_(false) {
     }
 
     virtual ~ObservableGraph();
@@ -165,9 +186,30 @@ public:
     EdgeId GlueEdges(EdgeId edge1, EdgeId edge2);
 
 private:
+    //destroys the edge or defers it till the end of the batch
+    void ReleaseEdge(EdgeId e);
+
     DECL_LOGGER("ObservableGraph")
 };
 
+/**
+ * Scoped batch of modifications of the graph, see ObservableGraph::BeginBatch
+ */
+template<class Graph>
+class ModificationBatch : private boost::noncopyable {
+    Graph &g_;
+
+public:
+    ModificationBatch(Graph &g)
+            : g_(g) {
+        g_.BeginBatch();
+    }
+
+    ~ModificationBatch() {
+        g_.EndBatch();
+    }
+};
+
 template<class DataMaster>
 typename ObservableGraph<DataMaster>::VertexId ObservableGraph<DataMaster>::AddVertex(const VertexData& data, restricted::IdDistributor& id_distributor) {
     VertexId v = base::HiddenAddVertex(data, id_distributor);
@@ -207,7 +249,15 @@ typename ObservableGraph<DataMaster>::EdgeId ObservableGraph<DataMaster>::AddEdg
 template<class DataMaster>
 void ObservableGraph<DataMaster>::DeleteEdge(EdgeId e) {
     FireDeleteEdge(e);
-    base::HiddenDeleteEdge(e);
+    ReleaseEdge(e);
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::ReleaseEdge(EdgeId e) {
+    if (batching_)
+        base::HiddenUnlinkEdge(e);
+    else
+        base::HiddenDeleteEdge(e);
 }
 
 template<class DataMaster>
@@ -328,8 +378,10 @@ void ObservableGraph<DataMaster>::FireAddVertex(VertexId v) const {
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireAddEdge(EdgeId e) const {
+    if (batching_)
+        batch_added_edges_.push_back(e);
     for (Handler* handler_ptr : action_handler_list_) {
-        if (handler_ptr->IsAttached()) {
+        if (handler_ptr->IsAttached() && !(batching_ && handler_ptr->AcceptsBatches())) {
             TRACE("FireAddEdge to handler " << handler_ptr->name());
             applier_->ApplyAdd(*handler_ptr, e);
         }
@@ -347,8 +399,10 @@ void ObservableGraph<DataMaster>::FireDeleteVertex(VertexId v) const {
 
 template<class DataMaster>
 void ObservableGraph<DataMaster>::FireDeleteEdge(EdgeId e) const {
+    if (batching_)
+        batch_deleted_edges_.push_back(e);
     for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
-        if ((*it)->IsAttached()) {
+        if ((*it)->IsAttached() && !(batching_ && (*it)->AcceptsBatches())) {
             applier_->ApplyDelete(**it, e);
         }
     };
@@ -381,6 +435,62 @@ void ObservableGraph<DataMaster>::FireSplit(EdgeId edge, EdgeId new_edge1, EdgeI
     }
 }
 
+template<class DataMaster>
+void ObservableGraph<DataMaster>::BeginBatch() {
+    if (batch_depth_++ > 0)
+        return;
+    batching_ = std::any_of(action_handler_list_.begin(), action_handler_list_.end(),
+                            [](const Handler *h) { return h->IsAttached() && h->AcceptsBatches(); });
+}
+
+template<class DataMaster>
+void ObservableGraph<DataMaster>::EndBatch() {
+    VERIFY(batch_depth_ > 0);
+    if (--batch_depth_ > 0 || !batching_)
+        return;
+    batching_ = false;
+
+    std::vector<EdgeId> added, deleted;
+    std::swap(added, batch_added_edges_);
+    std::swap(deleted, batch_deleted_edges_);
+    if (added.empty() && deleted.empty())
+        return;
+
+    //edges are reported by either edge of the conjugate pair
+    auto canonical_sorted = [this](const std::vector<EdgeId> &edges) {
+        std::vector<EdgeId> res;
+        res.reserve(edges.size());
+        for (EdgeId e : edges)
+            res.push_back(std::min(e, base::conjugate(e)));
+        std::sort(res.begin(), res.end());
+        return res;
+    };
+    std::vector<EdgeId> canonical_added = canonical_sorted(added);
+    std::vector<EdgeId> canonical_deleted = canonical_sorted(deleted);
+
+    //edges both added and deleted during the batch are not reported
+    std::vector<EdgeId> removed, created;
+    std::set_difference(canonical_deleted.begin(), canonical_deleted.end(),
+                        canonical_added.begin(), canonical_added.end(), std::back_inserter(removed));
+    std::set_difference(canonical_added.begin(), canonical_added.end(),
+                        canonical_deleted.begin(), canonical_deleted.end(), std::back_inserter(created));
+    TRACE("Batch finished, " << removed.size() << " edges deleted, " << created.size() << " edges added");
+
+    for (auto it = action_handler_list_.rbegin(); it != action_handler_list_.rend(); ++it) {
+        if ((*it)->IsAttached() && (*it)->AcceptsBatches() && !removed.empty()) {
+            applier_->ApplyDelete(**it, removed);
+        }
+    }
+    for (Handler* handler_ptr : action_handler_list_) {
+        if (handler_ptr->IsAttached() && handler_ptr->AcceptsBatches() && !created.empty()) {
+            applier_->ApplyAdd(*handler_ptr, created);
+        }
+    }
+
+    for (EdgeId e : deleted)
+        base::DestroyEdge(e);
+}
+
 template<class DataMaster>
 bool ObservableGraph<DataMaster>::VerifyAllDetached() {
     for (Handler* handler_ptr : action_handler_list_) {
@@ -401,6 +511,7 @@ void ObservableGraph<DataMaster>::FireDeletePath(const vector<EdgeId>& edgesToDe
 
 template<class DataMaster>
 ObservableGraph<DataMaster>::~ObservableGraph<DataMaster>() {
+    VERIFY(batch_depth_ == 0);
     while (base::size() > 0) {
         ForceDeleteVertex(*base::begin());
     }
@@ -454,7 +565,10 @@ typename ObservableGraph<DataMaster>::EdgeId ObservableGraph<DataMaster>::MergeP
     vector<VertexId> vertices_to_delete = VerticesToDelete(corrected_path);
     FireDeletePath(edges_to_delete, vertices_to_delete);
     FireAddEdge(new_edge);
-    base::HiddenDeletePath(edges_to_delete, vertices_to_delete);
+    for (EdgeId e : edges_to_delete)
+        ReleaseEdge(e);
+    for (VertexId v : vertices_to_delete)
+        base::HiddenDeleteVertex(v);
     return new_edge;
 }
 
@@ -473,7 +587,7 @@ std::pair<typename ObservableGraph<DataMaster>::EdgeId, typename ObservableGraph
     FireAddVertex(splitVertex);
     FireAddEdge(new_edge1);
     FireAddEdge(new_edge2);
-    base::HiddenDeleteEdge(edge);
+    ReleaseEdge(edge);
     return std::make_pair(new_edge1, new_edge2);
 }
 
@@ -486,8 +600,8 @@ typename ObservableGraph<DataMaster>::EdgeId ObservableGraph<DataMaster>::GlueEd
     FireAddEdge(new_edge);
     VertexId start = base::EdgeStart(edge1);
     VertexId end = base::EdgeEnd(edge1);
-    base::HiddenDeleteEdge(edge1);
-    base::HiddenDeleteEdge(edge2);
+    ReleaseEdge(edge1);
+    ReleaseEdge(edge2);
     if (base::IsDeadStart(start) && base::IsDeadEnd(start)) {
         DeleteVertex(start);
     }
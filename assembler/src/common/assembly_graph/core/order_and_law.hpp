@@ -159,6 +159,12 @@ struct pure_pointer {
         ptr_.init(ptr, MAX_THREAD_CNT);
     }
 
+    // For the elements which id is already known (e.g. arena-allocated)
+    explicit pure_pointer(T *ptr, size_t int_id)
+            : int_id_(int_id) {
+        ptr_.init(ptr, MAX_THREAD_CNT);
+    }
+
 //    lock_pointer_type& get_lockable() {
 //        return ptr_;
 //    }
@@ -7,6 +7,7 @@
 
 #pragma once
 #include "dijkstra_algorithm.hpp"
+#include "flat_dijkstra.hpp"
 
 namespace omnigraph {
 
@@ -50,6 +51,19 @@ public:
                 max_vertex_number);
     }
 
+    //Bounded dijkstra with reusable flat arrays, see FlatDijkstra
+    typedef FlatDijkstra<Graph, BoundedDijkstraSettings> FlatBoundedDijkstra;
+
+    static FlatBoundedDijkstra CreateFlatBoundedDijkstra(const Graph &graph, size_t length_bound,
+            size_t max_vertex_number = -1ul){
+        return FlatBoundedDijkstra(graph, BoundedDijkstraSettings(
+                        LengthCalculator<Graph>(graph),
+                        BoundProcessChecker<Graph>(length_bound),
+                        BoundPutChecker<Graph>(length_bound),
+                        ForwardNeighbourIteratorFactory<Graph>(graph)),
+                max_vertex_number);
+    }
+
     //------------------------------
     // bounded backward dijkstra
     //------------------------------
@@ -0,0 +1,191 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+#pragma once
+
+#include "dijkstra_algorithm.hpp"
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+
+namespace omnigraph {
+
+/*
+ * Dijkstra over the same settings as Dijkstra, which keeps the distances in a flat
+ * open addressing table keyed by vertex int id instead of trees. The table is
+ * reused between the runs: the slot is valid only if its generation is the one of
+ * the current run, so nothing is cleared before a run. The table grows with the
+ * number of vertices reached by a run, not with the graph. Vertices are processed
+ * in exactly the same order as by Dijkstra, but the shortest paths are not stored.
+ *
+ * The instance is intended to be kept per thread and used for many runs.
+ */
+template<class Graph, class DijkstraSettings, typename distance_t = size_t>
+class FlatDijkstra {
+    typedef typename Graph::VertexId VertexId;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef element_t<Graph, distance_t> element;
+    typedef ReverseDistanceComparator<element> comparator;
+
+    // constructor parameters
+    const Graph& graph_;
+    DijkstraSettings settings_;
+    const size_t max_vertex_number_;
+
+    // changeable parameters
+    size_t vertex_number_;
+    bool vertex_limit_exceeded_;
+
+    struct Slot {
+        size_t id;
+        distance_t distance;
+        uint32_t generation;
+    };
+
+    static const unsigned MinTableBits = 6;
+
+    // reusable structures
+    std::vector<Slot> table_;
+    unsigned table_bits_;
+    size_t table_count_;
+    uint32_t generation_;
+    std::vector<element> queue_;
+
+    size_t SlotIdx(size_t id) const {
+        return size_t((uint64_t(id) * 0x9E3779B97F4A7C15ULL) >> (64 - table_bits_));
+    }
+
+    // Slot of the id or the empty one where it should be put
+    size_t FindSlot(size_t id) const {
+        size_t mask = table_.size() - 1;
+        size_t idx = SlotIdx(id);
+        while (table_[idx].generation == generation_ && table_[idx].id != id)
+            idx = (idx + 1) & mask;
+        return idx;
+    }
+
+    void Rehash(unsigned bits) {
+        std::vector<Slot> old(size_t(1) << bits, Slot{ 0, 0, 0 });
+        old.swap(table_);
+        table_bits_ = bits;
+        for (const Slot &slot : old) {
+            if (slot.generation == generation_)
+                table_[FindSlot(slot.id)] = slot;
+        }
+    }
+
+    void SetDistance(size_t id, distance_t distance) {
+        // Load factor is kept under 1/2
+        if (2 * (table_count_ + 1) > table_.size())
+            Rehash(table_bits_ + 1);
+        Slot &slot = table_[FindSlot(id)];
+        VERIFY(slot.generation != generation_);
+        slot = Slot{ id, distance, generation_ };
+        ++table_count_;
+    }
+
+    void Init(VertexId start) {
+        if (++generation_ == 0) {
+            for (Slot &slot : table_)
+                slot.generation = 0;
+            generation_ = 1;
+        }
+        table_count_ = 0;
+
+        vertex_number_ = 0;
+        vertex_limit_exceeded_ = false;
+        queue_.clear();
+        settings_.Init(start);
+        Push(element(0, start, VertexId(), EdgeId()));
+    }
+
+    void Push(const element &e) {
+        queue_.push_back(e);
+        std::push_heap(queue_.begin(), queue_.end(), comparator());
+    }
+
+    element Pop() {
+        std::pop_heap(queue_.begin(), queue_.end(), comparator());
+        element res = queue_.back();
+        queue_.pop_back();
+        return res;
+    }
+
+    bool CheckProcessVertex(VertexId vertex, distance_t distance) {
+        ++vertex_number_;
+        if (vertex_number_ > max_vertex_number_) {
+            vertex_limit_exceeded_ = true;
+            return false;
+        }
+        return (vertex_number_ < max_vertex_number_) && settings_.CheckProcessVertex(vertex, distance);
+    }
+
+    void AddNeighboursToQueue(VertexId cur_vertex, distance_t cur_dist) {
+        auto neigh_iterator = settings_.GetIterator(cur_vertex);
+        while (neigh_iterator.HasNext()) {
+            auto cur_pair = neigh_iterator.Next();
+            if (!DistanceCounted(cur_pair.vertex)) {
+                distance_t new_dist = settings_.GetLength(cur_pair.edge) + cur_dist;
+                if (settings_.CheckPutVertex(cur_pair.vertex, cur_pair.edge, new_dist))
+                    Push(element(new_dist, cur_pair.vertex, cur_vertex, cur_pair.edge));
+            }
+        }
+    }
+
+public:
+    FlatDijkstra(const Graph &graph, DijkstraSettings settings, size_t max_vertex_number = size_t(-1)) :
+        graph_(graph),
+        settings_(settings),
+        max_vertex_number_(max_vertex_number),
+        vertex_number_(0),
+        vertex_limit_exceeded_(false),
+        table_(size_t(1) << MinTableBits, Slot{ 0, 0, 0 }),
+        table_bits_(MinTableBits),
+        table_count_(0),
+        generation_(0) {}
+
+    FlatDijkstra(FlatDijkstra&& /*other*/) = default;
+
+    FlatDijkstra(const FlatDijkstra& /*other*/) = delete;
+
+    FlatDijkstra& operator=(const FlatDijkstra& /*other*/) = delete;
+
+    bool DistanceCounted(VertexId vertex) const {
+        return generation_ != 0 && table_[FindSlot(vertex.int_id())].generation == generation_;
+    }
+
+    distance_t GetDistance(VertexId vertex) const {
+        VERIFY(DistanceCounted(vertex));
+        return table_[FindSlot(vertex.int_id())].distance;
+    }
+
+    void Run(VertexId start) {
+        TRACE("Starting flat dijkstra run from vertex " << graph_.str(start));
+        Init(start);
+
+        while (!queue_.empty()) {
+            element next = Pop();
+            if (DistanceCounted(next.curr_vertex))
+                continue;
+
+            SetDistance(next.curr_vertex.int_id(), next.distance);
+
+            if (!CheckProcessVertex(next.curr_vertex, next.distance))
+                continue;
+            AddNeighboursToQueue(next.curr_vertex, next.distance);
+        }
+        TRACE("Finished flat dijkstra run from vertex " << graph_.str(start));
+    }
+
+    bool VertexLimitExceeded() const {
+        return vertex_limit_exceeded_;
+    }
+
+private:
+    DECL_LOGGER("FlatDijkstra");
+};
+
+}
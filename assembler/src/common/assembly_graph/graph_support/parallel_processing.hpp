@@ -9,8 +9,10 @@
 
 #include "utils/logger/logger.hpp"
 #include "assembly_graph/core/graph_iterators.hpp"
+#include "assembly_graph/core/observable_graph.hpp"
 #include "assembly_graph/graph_support/graph_processing_algorithm.hpp"
 #include "utils/parallel/openmp_wrapper.h"
+#include "utils/perf/hot_counters.hpp"
 
 namespace omnigraph {
 
@@ -163,6 +165,7 @@ public:
                  bool force_primary_launch = false,
                  double iter_run_progress = 1.) {
         if (!comment.empty()) {INFO("Running " << comment);}
+        PERF_DYNAMIC_SCOPED_TIMER("simplification." + (comment.empty() ? std::string("unnamed") : comment));
         size_t triggered = algo.Run(force_primary_launch, iter_run_progress);
         if (!comment.empty()) {INFO(comment << " triggered " << triggered << " times");}
         return triggered;
@@ -205,6 +208,7 @@ public:
             DEBUG("Iteration " << (i + 1));
             size_t algo_triggered = algo.Run(primary, iter_run_progress);
             DEBUG("Triggered " << algo_triggered << " times on iteration " << (i + 1));
+            PERF_HISTOGRAM("simplification.looped_iteration_triggered", algo_triggered);
             changed = (algo_triggered > 0);
             triggered += algo_triggered;
         }
@@ -371,6 +375,7 @@ public:
 
         size_t triggered = 0;
         TRACE("Start processing");
+        ModificationBatch<Graph> batch(this->g());
         for (; !it_.IsEnd(); ++it_) {
             ElementId el = *it_;
             if (!Proceed(el)) {
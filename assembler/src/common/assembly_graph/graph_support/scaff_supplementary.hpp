@@ -111,6 +111,10 @@ public:
 class UsedUniqueStorage {
     set<EdgeId> used_;
     const ScaffoldingUniqueEdgeStorage& unique_;
+    //Speculative mode: edges used in base are seen as used as well,
+    //unique edges looked up by CheckUsedAndUnique are recorded
+    const UsedUniqueStorage *base_;
+    set<EdgeId> accessed_;
 
 public:
     UsedUniqueStorage(const UsedUniqueStorage&) = delete;
@@ -120,7 +124,7 @@ public:
     UsedUniqueStorage& operator=(UsedUniqueStorage&&) = default;
 
     explicit UsedUniqueStorage(const ScaffoldingUniqueEdgeStorage& unique):
-            unique_(unique) {}
+            unique_(unique), base_(nullptr) {}
 
     void insert(EdgeId e) {
         if (unique_.IsUnique(e)) {
@@ -129,12 +133,22 @@ public:
         }
     }
 
-//    const ScaffoldingUniqueEdgeStorage& unique_edge_storage() const {
-//        return unique_;
-//    }
+    const ScaffoldingUniqueEdgeStorage& unique_edge_storage() const {
+        return unique_;
+    }
 
     bool IsUsedAndUnique(EdgeId e) const {
-        return (unique_.IsUnique(e) && used_.find(e) != used_.end());
+        if (!unique_.IsUnique(e))
+            return false;
+        return used_.find(e) != used_.end() ||
+               (base_ != nullptr && base_->used_.find(e) != base_->used_.end());
+    }
+
+    //Same as IsUsedAndUnique, the unique edge is recorded as accessed in speculative mode
+    bool CheckUsedAndUnique(EdgeId e) {
+        if (base_ != nullptr && unique_.IsUnique(e))
+            accessed_.insert(e);
+        return IsUsedAndUnique(e);
     }
 
     bool UniqueCheckEnabled() const {
@@ -143,7 +157,7 @@ public:
 
     bool TryUseEdge(BidirectionalPath &path, EdgeId e, const Gap &gap) {
         if (UniqueCheckEnabled()) {
-            if (IsUsedAndUnique(e)) {
+            if (CheckUsedAndUnique(e)) {
                 return false;
             } else {
                 insert(e);
@@ -153,6 +167,29 @@ public:
         return true;
     }
 
+    //Forgets own used edges and starts speculating over base, which
+    //should not be changed until the used edges are merged back to it
+    void Speculate(const UsedUniqueStorage &base) {
+        VERIFY(&base.unique_ == &unique_);
+        base_ = &base;
+        used_.clear();
+        accessed_.clear();
+    }
+
+    void Merge(const set<EdgeId> &used) {
+        used_.insert(used.begin(), used.end());
+    }
+
+    //Edges used since Speculate
+    const set<EdgeId>& used() const {
+        return used_;
+    }
+
+    //Unique edges looked up since Speculate
+    const set<EdgeId>& accessed() const {
+        return accessed_;
+    }
+
 };
 
 //FIXME rename
@@ -100,7 +100,7 @@ public:
         DeBruijnGraphKMerSplitter<Graph,
                                   utils::StoringTypeFilter<typename Index::storing_type>>
                 splitter(workdir, index.k(), g, read_buffer_size);
-        utils::KMerDiskCounter<RtSeq> counter(workdir, splitter);
+        utils::KMerInMemoryCounter<RtSeq> counter(workdir, splitter);
         BuildIndex(index, counter, 16, nthreads);
 
         // Now use the index to fill the coverage and EdgeId's
@@ -151,6 +151,8 @@ class CoverageFillingEdgeIndexBuilder : public Builder {
     void FillCoverageFromStream(ReadStream &stream,
                                 IndexT &index, bool check_contains) const {
         unsigned k = index.k();
+        std::vector<Kmer> kmers;
+        std::vector<KeyWithHash> kwhs;
 
         while (!stream.eof()) {
             typename ReadStream::ReadT r;
@@ -160,11 +162,20 @@ class CoverageFillingEdgeIndexBuilder : public Builder {
             if (seq.size() < k)
                 continue;
 
-            KeyWithHash kwh = index.ConstructKWH(seq.start<Kmer>(k) >> 'A');
+            // The lookups of the whole read are resolved in a single batch
+            kmers.clear();
+            kwhs.clear();
+            Kmer kmer = seq.start<Kmer>(k) >> 'A';
             for (size_t j = k - 1; j < seq.size(); ++j) {
-                kwh <<= seq[j];
+                kmer <<= seq[j];
+                if (index.ConstructKWH(kmer).is_minimal())
+                    kmers.push_back(kmer);
+            }
+            index.ConstructKWH(kmers, kwhs);
+
+            for (const auto &kwh : kwhs) {
                 //contains is not used since index might be still empty here
-                if (kwh.is_minimal() && index.valid(kwh) && ContainsWrap(check_contains, index, kwh, has_contains<IndexT>())) {
+                if (index.valid(kwh) && ContainsWrap(check_contains, index, kwh, has_contains<IndexT>())) {
 #     pragma omp atomic
                     index.get_raw_value_reference(kwh).count += 1;
                 }
@@ -44,26 +44,61 @@ class EdgeInfoUpdater {
         return false;
     }
 
+    // K-mers of the sequence which are stored in the index (all the k-mers or
+    // the minimal ones only) and their offsets
+    void CollectKMers(const Sequence &nucls, bool minimal_only,
+                      std::vector<Kmer> &kmers, std::vector<size_t> &offsets) const {
+        unsigned k = index_.k();
+        Kmer kmer = nucls.start<Kmer>(k) >> 'A';
+        for (size_t i = k - 1, n = nucls.size(); i < n; ++i) {
+            kmer <<= nucls[i];
+            if (!minimal_only || index_.ConstructKWH(kmer).is_minimal()) {
+                kmers.push_back(kmer);
+                offsets.push_back(i - k + 1);
+            }
+        }
+    }
+
+    // The index stores canonical k-mers, so an edge shares the entries with its conjugate (and
+    // the palindromic k-mers occur in self-conjugate edges only). Distinct edges of the graph do
+    // not share k-mers, so the edges are grouped with their conjugates, and the groups could be
+    // processed in parallel. Group i is sorted[bounds[i]..bounds[i + 1]).
+    void GroupConjugates(const std::vector<EdgeId> &edges,
+                         std::vector<EdgeId> &sorted, std::vector<size_t> &bounds) const {
+        auto canonical = [this](EdgeId e) { return std::min(e, g_.conjugate(e)); };
+        sorted = edges;
+        std::sort(sorted.begin(), sorted.end(), [&](EdgeId a, EdgeId b) {
+            return std::make_pair(canonical(a), a) < std::make_pair(canonical(b), b);
+        });
+        bounds.clear();
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || canonical(sorted[i]) != canonical(sorted[i - 1]))
+                bounds.push_back(i);
+        }
+        bounds.push_back(sorted.size());
+    }
+
+    // The lookups of the whole edge are resolved in a single batch
     void UpdateKMers(const Sequence &nucls, EdgeId e) {
         VERIFY(nucls.size() >= index_.k());
-        KeyWithHash kwh = index_.ConstructKWH(Kmer(index_.k(), nucls));
-        if (kwh.is_minimal())
-            index_.PutInIndex(kwh, e, 0);
-        for (size_t i = index_.k(), n = nucls.size(); i < n; ++i) {
-            kwh <<= nucls[i];
-            if (kwh.is_minimal())
-                index_.PutInIndex(kwh, e, i - index_.k() + 1);
-        }
+        std::vector<Kmer> kmers;
+        std::vector<size_t> offsets;
+        std::vector<KeyWithHash> kwhs;
+        CollectKMers(nucls, /* minimal_only */ true, kmers, offsets);
+        index_.ConstructKWH(kmers, kwhs);
+        for (size_t i = 0; i < kwhs.size(); ++i)
+            index_.PutInIndex(kwhs[i], e, offsets[i]);
     }
 
     void DeleteKMers(const Sequence &nucls, EdgeId e) {
         VERIFY(nucls.size() >= index_.k());
-        KeyWithHash kwh = index_.ConstructKWH(Kmer(index_.k(), nucls));
-        DeleteIfEqual(kwh, e);
-        for (size_t i = index_.k(), n = nucls.size(); i < n; ++i) {
-            kwh <<= nucls[i];
+        std::vector<Kmer> kmers;
+        std::vector<size_t> offsets;
+        std::vector<KeyWithHash> kwhs;
+        CollectKMers(nucls, /* minimal_only */ false, kmers, offsets);
+        index_.ConstructKWH(kmers, kwhs);
+        for (const auto &kwh : kwhs)
             DeleteIfEqual(kwh, e);
-        }
     }
 
  public:
@@ -87,6 +122,28 @@ class EdgeInfoUpdater {
         DeleteKMers(nucls, e);
     }
 
+    void UpdateKmers(const std::vector<EdgeId> &edges) {
+        std::vector<EdgeId> sorted;
+        std::vector<size_t> bounds;
+        GroupConjugates(edges, sorted, bounds);
+        #pragma omp parallel for schedule(guided) if(bounds.size() > 64)
+        for (size_t i = 0; i < bounds.size() - 1; ++i) {
+            for (size_t j = bounds[i]; j < bounds[i + 1]; ++j)
+                UpdateKmers(sorted[j]);
+        }
+    }
+
+    void DeleteKmers(const std::vector<EdgeId> &edges) {
+        std::vector<EdgeId> sorted;
+        std::vector<size_t> bounds;
+        GroupConjugates(edges, sorted, bounds);
+        #pragma omp parallel for schedule(guided) if(bounds.size() > 64)
+        for (size_t i = 0; i < bounds.size() - 1; ++i) {
+            for (size_t j = bounds[i]; j < bounds[i + 1]; ++j)
+                DeleteKmers(sorted[j]);
+        }
+    }
+
     void UpdateAll() {
         unsigned nthreads = omp_get_max_threads();
 
@@ -9,6 +9,7 @@
 
 #include "utils/ph_map/perfect_hash_map.hpp"
 #include "io/reads/single_read.hpp"
+#include "utils/perf/hot_counters.hpp"
 
 namespace debruijn_graph {
 
@@ -90,6 +91,7 @@ public:
      * Shows if kmer has some entry associated with it
      */
     bool contains(const KeyWithHash &kwh) const {
+        PERF_COUNT("edge_index.lookups", 1);
         // Sanity check
         if (!valid(kwh))
             return false;
@@ -97,7 +99,12 @@ public:
         KmerPos entry = base::get_value(kwh);
         if (!entry.valid())
             return false;
-        return graph_.EdgeNucls(entry.edge_id).contains(kwh.key(), entry.offset);
+        if (!graph_.EdgeNucls(entry.edge_id).contains(kwh.key(), entry.offset)) {
+            // The k-mer is not in the graph, but its hash is the one of a graph k-mer
+            PERF_COUNT("edge_index.false_positives", 1);
+            return false;
+        }
+        return true;
     }
 
     void PutInIndex(KeyWithHash &kwh, IdType id, size_t offset) {
@@ -125,21 +132,21 @@ public:
     template<class Writer>
     void BinWrite(Writer &writer) const {
         this->index_ptr_->serialize(writer);
-        size_t sz = this->data_.size();
+        size_t sz = this->size();
         writer.write((char*)&sz, sizeof(sz));
-        for (size_t i = 0; i < sz; ++i)
-            writer.write((char*)&(this->data_[i].count), sizeof(this->data_[0].count));
+        for (auto it = this->value_cbegin(), end = this->value_cend(); it != end; ++it)
+            writer.write((char*)&(it->count), sizeof(it->count));
     }
 
     template<class Reader>
-    void BinRead(Reader &reader, const std::string/* &FileName*/) {
+    void BinRead(Reader &reader, const std::string &FileName) {
         this->clear();
-        this->index_ptr_->deserialize(reader);
+        this->index_ptr_->deserialize(reader, FileName);
         size_t sz = 0;
         reader.read((char*)&sz, sizeof(sz));
-        this->data_.resize(sz);
-        for (size_t i = 0; i < sz; ++i)
-            reader.read((char*)&(this->data_[i].count), sizeof(this->data_[0].count));
+        this->resize(sz);
+        for (auto it = this->value_begin(), end = this->value_end(); it != end; ++it)
+            reader.read((char*)&(it->count), sizeof(it->count));
     }
 };
 
@@ -179,22 +186,22 @@ public:
   template<class Writer>
   void BinWrite(Writer &writer) const {
       this->index_ptr_->serialize(writer);
-      size_t sz = this->data_.size();
+      size_t sz = this->size();
       writer.write((char*)&sz, sizeof(sz));
-      for (size_t i = 0; i < sz; ++i)
-          writer.write((char*)&(this->data_[i].count), sizeof(this->data_[0].count));
+      for (auto it = this->value_cbegin(), end = this->value_cend(); it != end; ++it)
+          writer.write((char*)&(it->count), sizeof(it->count));
       this->BinWriteKmers(writer);
   }
 
   template<class Reader>
   void BinRead(Reader &reader, const std::string &FileName) {
       this->clear();
-      this->index_ptr_->deserialize(reader);
+      this->index_ptr_->deserialize(reader, FileName);
       size_t sz = 0;
       reader.read((char*)&sz, sizeof(sz));
-      this->data_.resize(sz);
-      for (size_t i = 0; i < sz; ++i)
-          reader.read((char*)&(this->data_[i].count), sizeof(this->data_[0].count));
+      this->resize(sz);
+      for (auto it = this->value_begin(), end = this->value_end(); it != end; ++it)
+          reader.read((char*)&(it->count), sizeof(it->count));
       this->BinReadKmers(reader, FileName);
   }
 
@@ -282,6 +282,12 @@ class MappingPath {
         range_mappings_.push_back(range);
     }
 
+    // Keeps the allocated memory, so the path could be reused
+    void clear() {
+        edges_.clear();
+        range_mappings_.clear();
+    }
+
  private:
     std::vector<ElementId> edges_;
     std::vector<MappingRange> range_mappings_;
@@ -308,7 +308,7 @@ struct detail_info_printer {
             string p = saves_folder + "/saves";
             INFO("Saving current state to " << p);
 
-            debruijn_graph::graphio::PrintAll(p, gp_);
+            debruijn_graph::graphio::PrintAll(p, gp_, /*binary*/false);
             debruijn_graph::config::write_lib_data(p);
         }
 
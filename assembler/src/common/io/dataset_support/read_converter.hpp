@@ -21,7 +21,7 @@ typedef SequencingLibrary<LibraryData> SequencingLibraryT;
 
 class ReadConverter {
 
-    static const size_t BINARY_FORMAT_VERSION = 12;
+    static const size_t BINARY_FORMAT_VERSION = 13;
 
     static bool CheckBinaryReadsExist(SequencingLibraryT& lib) {
         return fs::FileExists(lib.data().binary_reads_info.bin_reads_info_file);
@@ -31,6 +31,7 @@
 class MMappedReader {
     int StreamFile;
     bool Unlink;
+    bool Owned;
     std::string FileName;
 
     void remap() {
@@ -71,7 +72,7 @@ private:
     void cleanup() {
         if (StreamFile != -1)
             close(StreamFile);
-        if (MappedRegion)
+        if (MappedRegion && Owned)
             munmap(MappedRegion, BlockSize);
 
         if (Unlink) {
@@ -83,12 +84,19 @@ private:
 
 public:
     MMappedReader()
-            : StreamFile(-1), Unlink(false), FileName(""), MappedRegion(0), FileSize(0), BytesRead(0),
+            : StreamFile(-1), Unlink(false), Owned(true), FileName(""), MappedRegion(0), FileSize(0), BytesRead(0),
+              InitialOffset(0) { }
+
+    // Wraps the region which is already mapped into memory (e.g. anonymous
+    // mapping filled in-place). The region is unmapped on destruction iff owned.
+    MMappedReader(void *region, size_t sz, bool owned)
+            : StreamFile(-1), Unlink(false), Owned(owned), FileName(""),
+              MappedRegion((uint8_t *) region), FileSize(sz), BlockOffset(0), BytesRead(0), BlockSize(sz),
               InitialOffset(0) { }
 
     MMappedReader(const std::string &filename, bool unlink = false,
                   size_t blocksize = 64 * 1024 * 1024, off_t off = 0, size_t sz = 0)
-            : Unlink(unlink), FileName(filename), BlockSize(blocksize) {
+            : Unlink(unlink), Owned(true), FileName(filename), BlockSize(blocksize) {
         struct stat buf;
 
         InitialOffset = off;
@@ -133,6 +141,7 @@ public:
             BlockSize = other.BlockSize;
             FileName = std::move(other.FileName);
             Unlink = other.Unlink;
+            Owned = other.Owned;
             StreamFile = other.StreamFile;
             InitialOffset = other.InitialOffset;
 
@@ -308,6 +317,12 @@ public:
         VERIFY(FileSize % (sizeof(T) * elcnt_) == 0);
     }
 
+    MMappedRecordArrayReader(T *data, size_t elcnt,
+                             size_t sz, bool owned) :
+            MMappedReader(data, sz, owned), elcnt_(elcnt) {
+        VERIFY(FileSize % (sizeof(T) * elcnt_) == 0);
+    }
+
     void read(T *el, size_t amount) {
         MMappedReader::read(el, amount * sizeof(T) * elcnt_);
     }
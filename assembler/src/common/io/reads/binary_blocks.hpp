@@ -0,0 +1,222 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/verify.hpp"
+#include "ireader.hpp"
+
+#include <zlib.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+/*
+ * Block container of binary reads (.seq files):
+ *
+ *   ReadStreamStat                     -- stat of the whole file
+ *   block_0 ... block_{n-1}            -- compressed records of the reads
+ *   BlockInfo_0 ... BlockInfo_{n-1}    -- block index
+ *   index offset, block count, magic   -- footer
+ *
+ * Every block holds the records of consecutive reads as written by their
+ * BinWrite (sequences are already 2-bit packed) and is compressed with
+ * zlib at the fastest level, so that the files are smaller and the blocks
+ * could be read independently.
+ */
+namespace io {
+
+namespace binary {
+
+static const uint64_t BLOCKS_MAGIC = 0x534B434F4C425053ull; // "SPBLOCKS"
+
+struct BlockInfo {
+    uint64_t offset;
+    uint64_t read_count;
+    uint32_t size;
+    uint32_t raw_size;
+};
+
+class BlockWriter {
+    // Raw size of the block, records are never split between blocks
+    static const size_t BLOCK_SIZE = 1 << 20;
+
+    std::ostream &os_;
+    std::ostringstream block_;
+    size_t block_reads_;
+    std::vector<BlockInfo> index_;
+    std::vector<char> compressed_;
+
+    void FlushBlock() {
+        if (block_reads_ == 0)
+            return;
+
+        std::string raw = block_.str();
+        uLongf size = compressBound(raw.size());
+        compressed_.resize(size);
+        int res = compress2((Bytef *) compressed_.data(), &size,
+                            (const Bytef *) raw.data(), raw.size(), Z_BEST_SPEED);
+        VERIFY_MSG(res == Z_OK, "Failed to compress block of binary reads");
+
+        index_.push_back({ uint64_t(os_.tellp()), block_reads_, uint32_t(size), uint32_t(raw.size()) });
+        os_.write(compressed_.data(), size);
+
+        block_.str("");
+        block_reads_ = 0;
+    }
+
+public:
+    // Blocks are written starting from the current position of the stream
+    explicit BlockWriter(std::ostream &os)
+            : os_(os), block_reads_(0) {}
+
+    template<class Writer, class Read>
+    bool Write(const Writer &writer, const Read &r) {
+        bool res = writer.Write(block_, r);
+        block_reads_ += 1;
+        if (size_t(block_.tellp()) >= BLOCK_SIZE)
+            FlushBlock();
+        return res;
+    }
+
+    // Writes the last block and the index
+    void Finish() {
+        FlushBlock();
+
+        uint64_t index_offset = os_.tellp(), block_count = index_.size();
+        os_.write((const char *) index_.data(), index_.size() * sizeof(BlockInfo));
+        os_.write((const char *) &index_offset, sizeof(index_offset));
+        os_.write((const char *) &block_count, sizeof(block_count));
+        os_.write((const char *) &BLOCKS_MAGIC, sizeof(BLOCKS_MAGIC));
+        index_.clear();
+    }
+};
+
+class BlockReader {
+    // Exposes decompressed block to istream without copying
+    class BlockBuf : public std::streambuf {
+    public:
+        void set(char *data, size_t size) {
+            setg(data, data, data + size);
+        }
+    };
+
+    std::ifstream is_;
+    ReadStreamStat stat_;
+    std::vector<BlockInfo> index_;
+
+    size_t block_from_, block_to_;
+    size_t next_block_;
+    size_t block_left_;
+    size_t total_, current_;
+
+    std::vector<char> compressed_;
+    std::vector<char> raw_;
+    BlockBuf buf_;
+    std::istream block_;
+
+    void ReadIndex() {
+        stat_.read(is_);
+
+        uint64_t index_offset, block_count, magic;
+        is_.seekg(-int(3 * sizeof(uint64_t)), std::ios_base::end);
+        is_.read((char *) &index_offset, sizeof(index_offset));
+        is_.read((char *) &block_count, sizeof(block_count));
+        is_.read((char *) &magic, sizeof(magic));
+        VERIFY_MSG(is_.good() && magic == BLOCKS_MAGIC, "Corrupted binary reads file");
+
+        index_.resize(block_count);
+        is_.seekg(index_offset);
+        is_.read((char *) index_.data(), block_count * sizeof(BlockInfo));
+        VERIFY_MSG(is_.good(), "Corrupted binary reads file");
+    }
+
+    void ReadBlock(size_t idx) {
+        const BlockInfo &info = index_[idx];
+        compressed_.resize(info.size);
+        is_.seekg(info.offset);
+        is_.read(compressed_.data(), info.size);
+        VERIFY_MSG(is_.good(), "Failed to read block of binary reads");
+
+        raw_.resize(info.raw_size);
+        uLongf size = info.raw_size;
+        int res = uncompress((Bytef *) raw_.data(), &size,
+                             (const Bytef *) compressed_.data(), info.size);
+        VERIFY_MSG(res == Z_OK && size == info.raw_size, "Failed to decompress block of binary reads");
+
+        buf_.set(raw_.data(), raw_.size());
+        block_.clear();
+        block_left_ = info.read_count;
+    }
+
+public:
+    /**
+     * Opens the file for reading the blocks [block_from, block_to).
+     * By default all the blocks are read.
+     */
+    explicit BlockReader(const std::string &fname,
+                         size_t block_from = 0, size_t block_to = -1ull)
+            : is_(fname, std::ios_base::binary | std::ios_base::in),
+              block_from_(block_from), block_to_(block_to), block_(&buf_) {
+        VERIFY_MSG(is_.good(), "Cannot open binary reads file " << fname);
+        ReadIndex();
+
+        block_to_ = std::min(block_to_, index_.size());
+        block_from_ = std::min(block_from_, block_to_);
+        total_ = 0;
+        for (size_t i = block_from_; i < block_to_; ++i)
+            total_ += index_[i].read_count;
+
+        reset();
+    }
+
+    bool is_open() const {
+        return is_.is_open();
+    }
+
+    // Stat of the whole file
+    const ReadStreamStat &stat() const {
+        return stat_;
+    }
+
+    size_t block_count() const {
+        return index_.size();
+    }
+
+    bool eof() const {
+        return current_ == total_;
+    }
+
+    // Returns the stream positioned at the record of the next read
+    std::istream &next() {
+        VERIFY(current_ < total_);
+        while (block_left_ == 0)
+            ReadBlock(next_block_++);
+
+        block_left_ -= 1;
+        current_ += 1;
+        return block_;
+    }
+
+    void reset() {
+        is_.clear();
+        next_block_ = block_from_;
+        block_left_ = 0;
+        current_ = 0;
+    }
+
+    void close() {
+        current_ = total_;
+        is_.close();
+    }
+};
+
+}
+
+}
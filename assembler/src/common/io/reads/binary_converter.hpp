@@ -14,8 +14,13 @@
 #pragma once
 
 #include <fstream>
+#include <memory>
+#include <sched.h>
 
 #include "utils/verify.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "mpmc_bounded.hpp"
+#include "binary_blocks.hpp"
 #include "ireader.hpp"
 #include "single_read.hpp"
 #include "paired_read.hpp"
@@ -54,61 +59,109 @@ public:
 };
 
 class BinaryWriter {
+    // Buffer of each output stream, so that files are written by large blocks
+    static const size_t FILE_BUFFER_SIZE = 1 << 22;
+
     const std::string file_name_prefix_;
     size_t file_num_;
     std::vector<std::ofstream*> file_ds_;
+    std::vector<std::unique_ptr<char[]>> file_bufs_;
     size_t buf_size_;
 
+    template<class Read>
+    using Batch = std::pair<size_t, std::vector<Read>>;
+
     template<class Writer, class Read>
-    void FlushBuffer(const std::vector<Read>& buffer, const Writer& read_writer, std::ostream& file) {
+    void FlushBuffer(const std::vector<Read>& buffer, const Writer& read_writer, binary::BlockWriter& file,
+                     ReadStreamStat &stat) {
         for (const Read &r : buffer) {
-            read_writer.Write(file, r);
+            stat.increase(r);
+            file.Write(read_writer, r);
         }
     }
 
+    static size_t QueueSize(size_t size) {
+        // Round up to the power of two
+        size_t res = 2;
+        while (res < size)
+            res <<= 1;
+        return res;
+    }
+
+    // Reads are distributed among the files round-robin. The stream is read
+    // by the calling thread, while the reads are packed and written by the
+    // worker threads, every file is owned by a single worker.
     template<class Writer, class Read>
     ReadStreamStat ToBinary(const Writer &writer, io::ReadStream<Read> &stream, size_t buf_size) {
-        size_t buffer_reads = buf_size / (sizeof (Read) * 4);
-        size_t reads_to_flush = buffer_reads * file_num_;
+        size_t buffer_reads = std::max(buf_size / (sizeof (Read) * 4), size_t(1));
+        size_t nworkers = (omp_in_parallel() ? 1 : std::min(file_num_, size_t(omp_get_max_threads())));
+        // Keep the total amount of buffered reads the same: one batch is
+        // being filled and up to three ones are queued for each file
+        size_t batch_reads = (nworkers > 1 ? std::max(buffer_reads / 4, size_t(1)) : buffer_reads);
 
-        std::vector<std::vector<Read>> buf(file_num_, std::vector<Read>(buffer_reads) );
         std::vector<ReadStreamStat> read_stats(file_num_);
-        std::vector<size_t> current_buf_sizes(file_num_, 0);
-        size_t read_count = 0;
-
+        std::vector<std::unique_ptr<binary::BlockWriter>> block_writers;
         for (size_t i = 0; i < file_num_; ++i) {
             file_ds_[i]->seekp(0);
             read_stats[i].write(*file_ds_[i]);
+            block_writers.emplace_back(new binary::BlockWriter(*file_ds_[i]));
         }
 
-        size_t buf_index;
-        while (!stream.eof()) {
-            buf_index = read_count % file_num_;
-
-            Read& r = buf[buf_index][current_buf_sizes[buf_index]];
-            stream >> r;
-            read_stats[buf_index].increase(r);
-
-            ++current_buf_sizes[buf_index];
-            VERBOSE_POWER(++read_count, " reads processed");
+        std::vector<std::unique_ptr<mpmc_bounded_queue<Batch<Read>>>> queues;
+        size_t files_per_worker = (file_num_ + nworkers - 1) / nworkers;
+        for (size_t i = 0; nworkers > 1 && i < nworkers; ++i)
+            queues.emplace_back(new mpmc_bounded_queue<Batch<Read>>(QueueSize(3 * files_per_worker)));
 
-            if (read_count % reads_to_flush == 0) {
-                for (size_t i = 0; i < file_num_; ++i) {
-                    for (const Read &read : buf[i]) {
-                        writer.Write(*file_ds_[i], read);
+        size_t read_count = 0;
+#       pragma omp parallel num_threads(nworkers > 1 ? nworkers + 1 : 1)
+        {
+            // The runtime could give less threads than requested (nested
+            // regions, thread limit, dynamic adjustment), so only the queues
+            // having a worker are used. Without workers the reads are
+            // flushed by the master thread.
+            size_t active = std::min(size_t(omp_get_num_threads() - 1), queues.size());
+
+#           pragma omp master
+            {
+                std::vector<std::vector<Read>> buf(file_num_);
+                for (auto &b : buf)
+                    b.reserve(batch_reads);
+
+                while (!stream.eof()) {
+                    size_t buf_index = read_count % file_num_;
+                    auto &b = buf[buf_index];
+
+                    b.emplace_back();
+                    stream >> b.back();
+                    VERBOSE_POWER(++read_count, " reads processed");
+
+                    if (b.size() == batch_reads) {
+                        Dispatch(writer, queues, active, Batch<Read>(buf_index, std::move(b)), block_writers, read_stats);
+                        b.clear();
+                        b.reserve(batch_reads);
                     }
-                    current_buf_sizes[i] = 0;
                 }
+
+                for (size_t i = 0; i < file_num_; ++i)
+                    Dispatch(writer, queues, active, Batch<Read>(i, std::move(buf[i])), block_writers, read_stats);
+
+                for (auto &queue : queues)
+                    queue->close();
+            }
+
+            // Workers are the threads besides the master one
+            size_t tid = omp_get_thread_num();
+            if (tid > 0 && tid <= active) {
+                auto &queue = *queues[tid - 1];
+                Batch<Read> batch;
+                while (queue.wait_dequeue(batch))
+                    FlushBuffer(batch.second, writer, *block_writers[batch.first], read_stats[batch.first]);
             }
         }
 
         ReadStreamStat result;
         for (size_t i = 0; i < file_num_; ++i) {
-            buf[i].resize(current_buf_sizes[i]);
-            for (const Read &r : buf[i]) {
-                writer.Write(*file_ds_[i], r);
-            }
-
+            block_writers[i]->Finish();
             file_ds_[i]->seekp(0);
             read_stats[i].write(*file_ds_[i]);
             result.merge(read_stats[i]);
@@ -118,6 +171,23 @@ class BinaryWriter {
         return result;
     }
 
+    template<class Writer, class Read>
+    void Dispatch(const Writer &writer,
+                  std::vector<std::unique_ptr<mpmc_bounded_queue<Batch<Read>>>> &queues,
+                  size_t active,
+                  Batch<Read> &&batch,
+                  std::vector<std::unique_ptr<binary::BlockWriter>> &block_writers,
+                  std::vector<ReadStreamStat> &read_stats) {
+        if (active == 0) {
+            FlushBuffer(batch.second, writer, *block_writers[batch.first], read_stats[batch.first]);
+            return;
+        }
+
+        auto &queue = *queues[batch.first % active];
+        while (!queue.enqueue(std::move(batch)))
+            sched_yield();
+    }
+
 public:
 
     BinaryWriter(const std::string& file_name_prefix, size_t file_num,
@@ -128,7 +198,11 @@ public:
 
         for (size_t i = 0; i < file_num_; ++i) {
             std::string fname = file_name_prefix_ + "_" + std::to_string(i) + ".seq";
-            file_ds_.push_back(new std::ofstream(fname, std::ios_base::binary));
+            file_bufs_.emplace_back(new char[FILE_BUFFER_SIZE]);
+            file_ds_.push_back(new std::ofstream());
+            // Buffer should be set before the file is opened
+            file_ds_[i]->rdbuf()->pubsetbuf(file_bufs_[i].get(), FILE_BUFFER_SIZE);
+            file_ds_[i]->open(fname, std::ios_base::binary);
         }
     }
 
@@ -13,55 +13,50 @@
 #include "ireader.hpp"
 #include "single_read.hpp"
 #include "paired_read.hpp"
+#include "binary_blocks.hpp"
 
 namespace io {
 
-class BinaryFileSingleStream: public ReadStream<SingleReadSeq> {
-    std::ifstream stream_;
-    ReadStreamStat read_stat_;
-    size_t current_;
+inline std::string BinaryFileName(const std::string& file_name_prefix, size_t file_num) {
+    return file_name_prefix + "_" + std::to_string(file_num) + ".seq";
+}
 
-    void Init() {
-        stream_.clear();
-        stream_.seekg(0);
-        VERIFY(stream_.good());
-        read_stat_.read(stream_);
-        current_ = 0;
-    }
+/**
+ * Returns the number of blocks in the binary file. Streams over disjoint
+ * block ranges of the same file could be read in parallel.
+ */
+inline size_t BinaryFileBlockCount(const std::string& file_name_prefix, size_t file_num) {
+    return binary::BlockReader(BinaryFileName(file_name_prefix, file_num)).block_count();
+}
 
-public:
+class BinaryFileSingleStream: public ReadStream<SingleReadSeq> {
+    binary::BlockReader reader_;
 
-    BinaryFileSingleStream(const std::string& file_name_prefix, size_t file_num) {
-        std::string fname;
-        fname = file_name_prefix + "_" + std::to_string(file_num) + ".seq";
-        stream_.open(fname.c_str(), std::ios_base::binary | std::ios_base::in);
+public:
 
-        Init();
-    }
+    BinaryFileSingleStream(const std::string& file_name_prefix, size_t file_num,
+                           size_t block_from = 0, size_t block_to = -1ull)
+            : reader_(BinaryFileName(file_name_prefix, file_num), block_from, block_to) {}
 
     bool is_open() override {
-        return stream_.is_open();
+        return reader_.is_open();
     }
 
     bool eof() override {
-        return current_ == read_stat_.read_count;
+        return reader_.eof();
     }
 
     BinaryFileSingleStream& operator>>(SingleReadSeq& read) override {
-        read.BinRead(stream_);
-        VERIFY(current_ < read_stat_.read_count);
-
-        ++current_;
+        read.BinRead(reader_.next());
         return *this;
     }
 
     void close() override {
-        current_ = 0;
-        stream_.close();
+        reader_.close();
     }
 
     void reset() override {
-        Init();
+        reader_.reset();
     }
 
 };
@@ -127,53 +122,35 @@ public:
 };
 
 class BinaryFilePairedStream: public ReadStream<PairedReadSeq> {
-    std::ifstream stream_;
+    binary::BlockReader reader_;
     size_t insert_size_;
-    ReadStreamStat read_stat_;
-    size_t current_;
-
-    void Init() {
-        stream_.clear();
-        stream_.seekg(0);
-        VERIFY(stream_.good());
-        read_stat_.read(stream_);
-        current_ = 0;
-    }
 
 public:
 
-    BinaryFilePairedStream(const std::string& file_name_prefix, size_t file_num, size_t insert_szie): stream_(), insert_size_ (insert_szie) {
-        std::string fname;
-        fname = file_name_prefix + "_" + std::to_string(file_num) + ".seq";
-        stream_.open(fname.c_str(), std::ios_base::binary | std::ios_base::in);
-
-        Init();
-    }
+    BinaryFilePairedStream(const std::string& file_name_prefix, size_t file_num, size_t insert_size,
+                           size_t block_from = 0, size_t block_to = -1ull)
+            : reader_(BinaryFileName(file_name_prefix, file_num), block_from, block_to),
+              insert_size_(insert_size) {}
 
     bool is_open() override {
-        return stream_.is_open();
+        return reader_.is_open();
     }
 
     bool eof() override {
-        return current_ >= read_stat_.read_count;
+        return reader_.eof();
     }
 
     BinaryFilePairedStream& operator>>(PairedReadSeq& read) override {
-        read.BinRead(stream_, insert_size_);
-        VERIFY(current_ < read_stat_.read_count);
-
-        ++current_;
+        read.BinRead(reader_.next(), insert_size_);
         return *this;
     }
 
     void close() override {
-        current_ = 0;
-        stream_.close();
+        reader_.close();
     }
 
-
     void reset() override {
-        Init();
+        reader_.reset();
     }
 
 };
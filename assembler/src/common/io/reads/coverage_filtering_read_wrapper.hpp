@@ -7,7 +7,11 @@
 #pragma once
 
 #include <memory>
+#include <algorithm>
 #include "io/reads/ireader.hpp"
+#include "io/reads/delegating_reader_wrapper.hpp"
+#include "io/reads/read_stream_vector.hpp"
+#include "io/reads/paired_read.hpp"
 
 #include "adt/cqf.hpp"
 #include "adt/cyclichash.hpp"
@@ -94,12 +98,178 @@ public:
 
 };
 
+// Checks the median k-mer multiplicity of a batch of sequences at once: the
+// k-mers of all the sequences are looked up in the order of their CQF
+// quotients, so the filter is walked sequentially.
+// Only the number of k-mers below the threshold is kept per sequence: the
+// median is at least the threshold iff no more than a half of the k-mers are
+// below it.
+template<class Hasher>
+class MedianMltBatch {
+    typedef std::pair<uint64_t, uint32_t> HashedKmer;
+
+    class KmerCollector {
+        MedianMltBatch &batch_;
+    public:
+        KmerCollector(MedianMltBatch &batch)
+                : batch_(batch) {}
+
+        void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
+            batch_.kmers_.emplace_back(hash & batch_.kmer_mlt_index_.range_mask(),
+                                       uint32_t(batch_.kmer_cnt_.size() - 1));
+            batch_.kmer_cnt_.back() += 1;
+        }
+    };
+
+    const unsigned k_;
+    const Hasher hasher_;
+    const utils::CQFKmerFilter &kmer_mlt_index_;
+    const unsigned thr_;
+    std::vector<HashedKmer> kmers_, tmp_;
+    std::vector<uint32_t> kmer_cnt_, low_cnt_;
+
+public:
+    MedianMltBatch(unsigned k, const Hasher &hasher,
+                   const utils::CQFKmerFilter &kmer_mlt_index,
+                   unsigned threshold) :
+            k_(k), hasher_(hasher),
+            kmer_mlt_index_(kmer_mlt_index), thr_(threshold) {}
+
+    size_t kmers() const {
+        return kmers_.size();
+    }
+
+    void Add(const Sequence &s) {
+        kmer_cnt_.push_back(0);
+        if (s.size() < k_)
+            return;
+
+        KmerCollector collector(*this);
+        utils::KmerSequenceProcessor<Hasher, KmerCollector> processor(hasher_, collector);
+        processor.ProcessSequence(s, k_);
+    }
+
+    void Check() {
+        low_cnt_.assign(kmer_cnt_.size(), 0);
+        utils::SortByQuotient(kmers_, tmp_, kmer_mlt_index_.hash_bits(),
+                              [](const HashedKmer &kmer) { return kmer.first; });
+        uint64_t last = 0;
+        bool low = false;
+        for (size_t i = 0; i < kmers_.size(); ++i) {
+            // The adjacent repeats are looked up once
+            if (!i || kmers_[i].first != last) {
+                last = kmers_[i].first;
+                low = kmer_mlt_index_.lookup(last) < thr_;
+            }
+            low_cnt_[kmers_[i].second] += low;
+        }
+    }
+
+    // Whether the median multiplicity of the i-th added sequence is at least
+    // the threshold, sequences shorter than k have zero median
+    bool Passed(size_t i) const {
+        if (!kmer_cnt_[i])
+            return thr_ == 0;
+        return low_cnt_[i] <= kmer_cnt_[i] / 2;
+    }
+
+    void clear() {
+        kmers_.clear();
+        kmer_cnt_.clear();
+        low_cnt_.clear();
+    }
+};
+
+template<class ReadType>
+struct CoverageFilteredSequences {
+    static const unsigned count = 1;
+
+    static Sequence get(const ReadType &r, unsigned) {
+        return r.sequence();
+    }
+};
+
+template<class SingleReadType>
+struct CoverageFilteredSequences<UniversalPairedRead<SingleReadType>> {
+    static const unsigned count = 2;
+
+    static Sequence get(const UniversalPairedRead<SingleReadType> &r, unsigned i) {
+        return i ? r.second().sequence() : r.first().sequence();
+    }
+};
+
+// Passes the reads (pairs) with the median k-mer multiplicity of the read (of
+// either of the mates) at least the threshold, same as CoverageFilter does.
+// The reads are read ahead in blocks, which are checked by MedianMltBatch.
+template<class ReadType, class Hasher>
+class CoverageFilteringReaderWrapper : public DelegatingWrapper<ReadType> {
+    typedef DelegatingWrapper<ReadType> base;
+    typedef CoverageFilteredSequences<ReadType> Sequences;
+
+    // Number of k-mers checked at once, the larger the block is compared to
+    // the filter, the more sequential the lookups are
+    static const size_t kBlockKmers = 1 << 20;
+
+    MedianMltBatch<Hasher> batch_;
+    std::vector<ReadType> reads_, block_;
+    size_t pos_;
+
+    void FillBlock() {
+        block_.clear();
+        pos_ = 0;
+        while (block_.empty() && !base::eof()) {
+            batch_.clear();
+            reads_.clear();
+            while (!base::eof() && batch_.kmers() < kBlockKmers) {
+                reads_.emplace_back();
+                base::operator>>(reads_.back());
+                for (unsigned i = 0; i < Sequences::count; ++i)
+                    batch_.Add(Sequences::get(reads_.back(), i));
+            }
+
+            batch_.Check();
+            for (size_t r = 0; r < reads_.size(); ++r) {
+                for (unsigned i = 0; i < Sequences::count; ++i) {
+                    if (batch_.Passed(r * Sequences::count + i)) {
+                        block_.push_back(std::move(reads_[r]));
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+public:
+    CoverageFilteringReaderWrapper(typename base::ReadStreamPtrT reader_ptr,
+                                   unsigned k, const Hasher &hasher,
+                                   const utils::CQFKmerFilter &kmer_mlt_index,
+                                   unsigned thr) :
+            base(reader_ptr), batch_(k, hasher, kmer_mlt_index, thr), pos_(0) {
+        FillBlock();
+    }
+
+    bool eof() override {
+        return pos_ == block_.size();
+    }
+
+    CoverageFilteringReaderWrapper& operator>>(ReadType& read) override {
+        read = std::move(block_[pos_++]);
+        if (pos_ == block_.size())
+            FillBlock();
+        return *this;
+    }
+
+    void reset() override {
+        base::reset();
+        FillBlock();
+    }
+};
+
 template<class ReadType, class Hasher>
 inline std::shared_ptr<ReadStream<ReadType>> CovFilteringWrap(std::shared_ptr<ReadStream<ReadType>> reader_ptr,
                                                               unsigned k, const Hasher &hasher,
                                                               const utils::CQFKmerFilter &cqf, unsigned thr) {
-    CoverageFilter<ReadType, Hasher> filter(k, hasher, cqf, thr);
-    return io::FilteringWrap<ReadType>(reader_ptr, [=](const ReadType &r) { return filter(r); });
+    return std::make_shared<CoverageFilteringReaderWrapper<ReadType, Hasher>>(reader_ptr, k, hasher, cqf, thr);
 }
 
 template<class ReadType, class Hasher>
@@ -31,6 +31,8 @@ ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#pragma once
+
 #include <ciso646>
 
 #if __GNUC__ > 4 || (__GNUC__ >= 4 && __GNUC_MINOR__ >= 5) || _LIBCPP_VERSION
@@ -142,14 +144,16 @@ public:
     }
 
     bool wait_dequeue(T &data) {
-        bool res = false;
-        do {
-            res = dequeue(data);
-            if (!res)
-                usleep(1);
-        } while (!res && !is_closed());
-
-        return res;
+        for (; ;) {
+            // The state should be checked before the last attempt, since the
+            // elements could be enqueued right before the queue is closed
+            bool closed = closed_.load(std::memory_order_acquire);
+            if (dequeue(data))
+                return true;
+            if (closed)
+                return false;
+            usleep(1);
+        }
     }
 
 private:
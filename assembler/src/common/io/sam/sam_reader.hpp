@@ -32,6 +32,9 @@ public:
     MappedSamStream& operator >>(SingleSamRead& read);
     MappedSamStream& operator >>(PairedSamRead& read);
     const char* get_contig_name(int i) const;
+    size_t contig_num() const {
+        return is_open_ ? reader_->header->n_targets : 0;
+    }
     void close();
     void reset();
 
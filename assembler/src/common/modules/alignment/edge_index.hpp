@@ -70,6 +70,18 @@ public:
         updater_.DeleteKmers(e);
     }
 
+    void HandleBatchDelete(const std::vector<EdgeId> &edges) override {
+        updater_.DeleteKmers(edges);
+    }
+
+    void HandleBatchAdd(const std::vector<EdgeId> &edges) override {
+        updater_.UpdateKmers(edges);
+    }
+
+    bool AcceptsBatches() const override {
+        return true;
+    }
+
     bool contains(const KMer& kmer) const {
         VERIFY(this->IsAttached());
         return inner_index_.contains(inner_index_.ConstructKWH(kmer));
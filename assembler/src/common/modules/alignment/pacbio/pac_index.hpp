@@ -24,7 +24,11 @@
 
 #include "pacbio_read_structures.hpp"
 
+#include "utils/parallel/openmp_wrapper.h"
+
 #include <algorithm>
+#include <array>
+#include <mutex>
 #include <vector>
 #include <set>
 
@@ -42,6 +46,44 @@ struct OneReadMapping {
             :  main_storage(main_storage_), gaps(gaps_) {}
 };
 
+//Distances between the pairs of vertices split into shards locked independently
+template<class Graph>
+class VertexDistanceCache {
+    typedef typename Graph::VertexId VertexId;
+    typedef std::pair<VertexId, VertexId> VertexPair;
+
+    static const size_t SHARD_COUNT = 256;
+
+    struct Shard {
+        std::mutex mutex;
+        std::map<VertexPair, size_t> distances;
+    };
+
+    std::array<Shard, SHARD_COUNT> shards_;
+
+    Shard &GetShard(const VertexPair &vertex_pair) {
+        std::hash<VertexId> hasher;
+        return shards_[(hasher(vertex_pair.first) * 31 + hasher(vertex_pair.second)) % SHARD_COUNT];
+    }
+
+public:
+    bool find(const VertexPair &vertex_pair, size_t &distance) {
+        Shard &shard = GetShard(vertex_pair);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.distances.find(vertex_pair);
+        if (it == shard.distances.end())
+            return false;
+        distance = it->second;
+        return true;
+    }
+
+    void insert(const VertexPair &vertex_pair, size_t distance) {
+        Shard &shard = GetShard(vertex_pair);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.distances.insert({vertex_pair, distance});
+    }
+};
+
 template<class Graph>
 class PacBioMappingIndex {
 public:
@@ -56,7 +98,9 @@ private:
 
     static const int LONG_ALIGNMENT_OVERLAP = 300;
     static const size_t SHORT_SPURIOUS_LENGTH = 500;
-    mutable std::map<std::pair<VertexId, VertexId>, size_t> distance_cashed_;
+    mutable VertexDistanceCache<Graph> distance_cache_;
+    //Dijkstra of every thread, reused between the runs
+    mutable std::vector<typename omnigraph::DijkstraHelper<Graph>::FlatBoundedDijkstra> dijkstras_;
     size_t read_count_;
     debruijn_graph::config::pacbio_processor pb_config_;
 
@@ -64,12 +108,19 @@ private:
 
 public:
 
+    //Queries are supposed to come from at most nthreads threads
     PacBioMappingIndex(const Graph &g,
-                       debruijn_graph::config::pacbio_processor pb_config, alignment::BWAIndex::AlignmentMode mode)
+                       debruijn_graph::config::pacbio_processor pb_config, alignment::BWAIndex::AlignmentMode mode,
+                       size_t nthreads)
             : g_(g),
               pb_config_(pb_config),
               bwa_mapper_(g, mode, pb_config.bwa_length_cutoff) {
         DEBUG("PB Mapping Index construction started");
+        dijkstras_.reserve(nthreads);
+        for (size_t i = 0; i < nthreads; ++i)
+            dijkstras_.push_back(omnigraph::DijkstraHelper<Graph>::CreateFlatBoundedDijkstra(g_,
+                                                                                            pb_config_.max_path_in_dijkstra,
+                                                                                            pb_config_.max_vertex_in_dijkstra));
         DEBUG("Index constructed");
         read_count_ = 0;
     }
@@ -463,30 +514,20 @@ public:
                        bool update_cache = true) const {
         size_t result = size_t(-1);
         pair<VertexId, VertexId> vertex_pair = make_pair(start_v, end_v);
-        bool not_found;
-        auto distance_it = distance_cashed_.begin();
-        //FIXME should permit multiple readers
-#pragma omp critical(pac_index)
-        {
-            distance_it = distance_cashed_.find(vertex_pair);
-            not_found = (distance_it == distance_cashed_.end());
-        }
-        if (not_found) {
-            omnigraph::DijkstraHelper<debruijn_graph::Graph>::BoundedDijkstra dijkstra(
-                    omnigraph::DijkstraHelper<debruijn_graph::Graph>::CreateBoundedDijkstra(g_,
-                                                                                            pb_config_.max_path_in_dijkstra,
-                                                                                            pb_config_.max_vertex_in_dijkstra));
-            dijkstra.Run(start_v);
-            if (dijkstra.DistanceCounted(end_v)) {
-                result = dijkstra.GetDistance(end_v);
-            }
-            if (update_cache) {
-#pragma omp critical(pac_index)
-                distance_cashed_.insert({vertex_pair, result});
-            }
-        } else {
+        if (distance_cache_.find(vertex_pair, result)) {
             TRACE("taking from cashed");
-            result = distance_it->second;
+            return result;
+        }
+
+        size_t thread = omp_get_thread_num();
+        VERIFY_MSG(thread < dijkstras_.size(), "PacBio index is used by more threads than it was created for");
+        auto &dijkstra = dijkstras_[thread];
+        dijkstra.Run(start_v);
+        if (dijkstra.DistanceCounted(end_v)) {
+            result = dijkstra.GetDistance(end_v);
+        }
+        if (update_cache) {
+            distance_cache_.insert(vertex_pair, result);
         }
 
         return result;
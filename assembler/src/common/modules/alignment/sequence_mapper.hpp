@@ -14,6 +14,7 @@
 
 #include "edge_index.hpp"
 #include "kmer_mapper.hpp"
+#include "utils/perf/hot_counters.hpp"
 
 #include <cstdlib>
 #include "assembly_graph/core/basic_graph_stats.hpp"
@@ -50,6 +51,24 @@ public:
     virtual MappingPath<EdgeId> MapSequence(const Sequence &sequence) const = 0;
 
     virtual MappingPath<EdgeId> MapRead(const io::SingleRead &read) const = 0;
+
+    /**
+     * Maps the batch of reads. The paths are cleared and refilled, so keeping
+     * the same vector between calls (e.g. one per thread) saves allocations.
+     */
+    void MapReads(const std::vector<io::SingleRead> &reads,
+                  std::vector<MappingPath<EdgeId>> &paths) const {
+        paths.resize(reads.size());
+        for (size_t i = 0; i < reads.size(); ++i) {
+            paths[i].clear();
+            AppendReadMapping(reads[i], paths[i]);
+        }
+    }
+
+protected:
+    virtual void AppendReadMapping(const io::SingleRead &read, MappingPath<EdgeId> &path) const {
+        path.join(MapRead(read));
+    }
 };
 
 template<class Graph>
@@ -57,6 +76,38 @@ class AbstractSequenceMapper : public SequenceMapper<Graph> {
 protected:
     const Graph& g_;
 
+    // Read string with Ns replaced by As, so that the whole read could be
+    // packed at once
+    class NMaskedString {
+        const std::string &s_;
+    public:
+        explicit NMaskedString(const std::string &s) : s_(s) {}
+
+        size_t size() const { return s_.size(); }
+
+        char operator[](size_t i) const {
+            return s_[i] == 'N' ? 'A' : s_[i];
+        }
+    };
+
+    // The read is packed only once, N-free segments are mapped as the views
+    // of the packed sequence
+    void AppendReadMapping(const io::SingleRead &read, MappingPath<EdgeId> &result) const override {
+        const std::string &s = read.GetSequenceString();
+        if (s.empty())
+            return;
+
+        Sequence packed = Sequence(NMaskedString(s));
+        size_t l = 0;
+        for (size_t i = 0; i <= s.size(); ++i) {
+            if (i < s.size() && s[i] != 'N')
+                continue;
+            if (i > l)
+                result.join(this->MapSequence(packed.Subseq(l, i)), int(l));
+            l = i + 1;
+        }
+    }
+
 //    const Graph& g() const {
 //        return g_;
 //    }
@@ -67,23 +118,8 @@ public:
     MappingPath<EdgeId> MapRead(const io::SingleRead &read) const override {
 //      VERIFY(read.IsValid());
         DEBUG(read.name() << " is mapping");
-        string s = read.GetSequenceString();
-        size_t l = 0, r = 0;
         MappingPath<EdgeId> result;
-        for(size_t i = 0; i < s.size(); i++) {
-            if (read.GetSequenceString()[i] == 'N') {
-                if (r > l) {
-                    result.join(this->MapSequence(Sequence(s.substr(l, r - l))), int(l));
-                }
-                r = i + 1;
-                l = i + 1;
-            } else {
-                r++;
-            }
-        }
-        if (r > l) {
-            result.join(this->MapSequence(Sequence(s.substr(l, r - l))), int(l));
-        }
+        AppendReadMapping(read, result);
         DEBUG(read.name() << " is mapped");
         DEBUG("Number of edges is " << result.size());
 
@@ -372,6 +408,8 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
       optimization_on_(optimization_on) { }
 
   MappingPath<EdgeId> MapSequence(const Sequence &sequence) const {
+    PERF_SCOPED_TIMER("mapping.map_sequence");
+    PERF_HISTOGRAM("mapping.sequence_length", sequence.size());
     std::vector<EdgeId> passed_edges;
     RangeMappings range_mapping;
 
@@ -389,6 +427,7 @@ class BasicSequenceMapper: public AbstractSequenceMapper<Graph> {
                                range_mapping, try_thread);
     }
 
+    PERF_HISTOGRAM("mapping.path_edges", passed_edges.size());
     return MappingPath<EdgeId>(passed_edges, range_mapping);
   }
 
@@ -15,6 +15,8 @@
 #include "common/utils/memory_limit.hpp"
 
 #include <vector>
+#include <mutex>
+#include <atomic>
 #include <cstdlib>
 
 namespace debruijn_graph {
@@ -39,6 +41,7 @@ public:
 
 class SequenceMapperNotifier {
     static constexpr size_t BUFFER_SIZE = 200000;
+    static constexpr size_t MEMORY_CHECK_PERIOD = 1000;
 public:
     typedef SequenceMapper<conj_graph_pack::graph_t> SequenceMapperT;
 
@@ -52,6 +55,10 @@ public:
         listeners_[lib_index].push_back(listener);
     }
 
+    //Each thread maps the reads of its stream into its own buffers. A full buffer is not merged
+    //under a global lock: the thread keeps mapping and merges the buffer of every listener as soon
+    //as the lock of the listener is free, so the threads do not wait for each other merging into
+    //different listeners. It waits for the lock only if the buffers grow too much meanwhile.
     template<class ReadType>
     void ProcessLibrary(io::ReadStreamList<ReadType>& streams,
                         size_t lib_index, const SequenceMapperT& mapper, size_t threads_count = 0) {
@@ -60,42 +67,49 @@ public:
 
         streams.reset();
         NotifyStartProcessLibrary(lib_index, threads_count);
-        size_t counter = 0, n = 15;
+        std::atomic<size_t> counter(0);
+        size_t n = 15;
         size_t fmem = utils::get_free_memory();
+        std::vector<std::mutex> merge_locks(listeners_[lib_index].size());
 
-        #pragma omp parallel for num_threads(threads_count) shared(counter)
+        #pragma omp parallel for num_threads(threads_count) shared(counter, n, merge_locks)
         for (size_t i = 0; i < streams.size(); ++i) {
             size_t size = 0;
+            bool low_memory = false;
+            std::vector<bool> pending(listeners_[lib_index].size(), false);
+            size_t pending_count = 0;
             ReadType r;
             auto& stream = streams[i];
             while (!stream.eof()) {
-                if (size == BUFFER_SIZE || 
-                    // Stop filling buffer if the amount of available is smaller
-                    // than half of free memory.
-                    (10 * utils::get_free_memory() / 4 < fmem && size > 10000)) {
-                    #pragma omp critical
-                    {
-                        counter += size;
-                        if (counter >> n) {
-                            INFO("Processed " << counter << " reads");
-                            n += 1;
-                        }
-                        size = 0;
-                        NotifyMergeBuffer(lib_index, i);
-                    }
+                // Checking free memory is a system call, so it is done periodically.
+                // Stop filling buffer if the amount of available is smaller
+                // than half of free memory.
+                if (size % MEMORY_CHECK_PERIOD == 0)
+                    low_memory = (10 * utils::get_free_memory() / 4 < fmem);
+
+                if (size == BUFFER_SIZE || (low_memory && size > 10000)) {
+                    ReportProgress(counter += size, n);
+                    size = 0;
+                    //Buffers not merged yet are merged now
+                    MergeBuffers(lib_index, i, merge_locks, pending, true);
+                    std::fill(pending.begin(), pending.end(), true);
+                    pending_count = pending.size();
                 }
+                if (pending_count)
+                    pending_count -= MergeBuffers(lib_index, i, merge_locks, pending,
+                                                  low_memory || size >= BUFFER_SIZE / 2);
+
                 stream >> r;
                 ++size;
                 NotifyProcessRead(r, mapper, lib_index, i);
             }
-            #pragma omp atomic
             counter += size;
         }
 
         for (size_t i = 0; i < threads_count; ++i)
             NotifyMergeBuffer(lib_index, i);
 
-        INFO("Total " << counter << " reads processed");
+        INFO("Total " << counter.load() << " reads processed");
         NotifyStopProcessLibrary(lib_index);
     }
 
@@ -117,6 +131,36 @@ private:
         for (const auto& listener : listeners_[ilib])
             listener->MergeBuffer(ithread);
     }
+
+    //Merges the pending buffers of the thread into the listeners, which are not being merged into
+    //by other threads at the moment, or into all of them if wait is set. Returns the number of merged buffers.
+    size_t MergeBuffers(size_t ilib, size_t ithread, std::vector<std::mutex>& locks,
+                        std::vector<bool>& pending, bool wait) const {
+        size_t merged = 0;
+        for (size_t j = 0; j < pending.size(); ++j) {
+            if (!pending[j])
+                continue;
+            std::unique_lock<std::mutex> lock(locks[j], std::defer_lock);
+            if (wait)
+                lock.lock();
+            else if (!lock.try_lock())
+                continue;
+            listeners_[ilib][j]->MergeBuffer(ithread);
+            pending[j] = false;
+            ++merged;
+        }
+        return merged;
+    }
+
+    void ReportProgress(size_t counter, size_t& n) const {
+        #pragma omp critical(sequence_mapper_progress)
+        {
+            if (counter >> n) {
+                INFO("Processed " << counter << " reads");
+                n += 1;
+            }
+        }
+    }
     const conj_graph_pack& gp_;
 
     std::vector<std::vector<SequenceMapperListener*> > listeners_;  //first vector's size = count libs
@@ -19,7 +19,9 @@
 #include "path_filter.hpp"
 #include "overlap_analysis.hpp"
 #include "assembly_graph/graph_support/scaff_supplementary.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 #include <cmath>
+#include <functional>
 
 namespace path_extend {
 
@@ -691,12 +693,60 @@ protected:
     GraphCoverageMap visited_cycles_coverage_map_;
     PathContainer path_storage_;
     size_t min_cycle_len_;
+    //Speculative mode: cycles visited in base are seen as well,
+    //edges the cycles are looked up at are recorded
+    const InsertSizeLoopDetector *base_;
+    std::set<EdgeId> accessed_;
+
+    bool InVisitedCycle(const GraphCoverageMap& visited_cycles, const BidirectionalPath& path) const {
+        for (auto cycle : *visited_cycles.GetEdgePaths(path.Back())) {
+            DEBUG("checking  cycle ");
+            int pos = path.FindLast(*cycle);
+            if (pos == -1)
+                continue;
+
+            int start_cycle_pos = pos + (int) cycle->Size();
+            bool only_cycles_in_tail = true;
+            int last_cycle_pos = start_cycle_pos;
+            DEBUG("start_cycle pos "<< last_cycle_pos);
+            for (int i = start_cycle_pos; i < (int) path.Size() - (int) cycle->Size(); i += (int) cycle->Size()) {
+                if (!path.CompareFrom(i, *cycle)) {
+                    only_cycles_in_tail = false;
+                    break;
+                } else {
+                    last_cycle_pos = i + (int) cycle->Size();
+                    DEBUG("last cycle pos changed " << last_cycle_pos);
+                }
+            }
+            DEBUG("last_cycle_pos " << last_cycle_pos);
+            only_cycles_in_tail = only_cycles_in_tail && cycle->CompareFrom(0, path.SubPath(last_cycle_pos));
+            if (only_cycles_in_tail) {
+// seems that most of this is useless, checking
+                VERIFY (last_cycle_pos == start_cycle_pos);
+                DEBUG("find cycle " << last_cycle_pos);
+                DEBUG("path");
+                path.PrintDEBUG();
+                DEBUG("last subpath");
+                path.SubPath(last_cycle_pos).PrintDEBUG();
+                DEBUG("cycle");
+                cycle->PrintDEBUG();
+                DEBUG("last_cycle_pos " << last_cycle_pos << " path size " << path.Size());
+                VERIFY(last_cycle_pos <= (int)path.Size());
+                DEBUG("last cycle pos + cycle " << last_cycle_pos + (int)cycle->Size());
+                VERIFY(last_cycle_pos + (int)cycle->Size() >= (int)path.Size());
+
+                return true;
+            }
+        }
+        return false;
+    }
 
 public:
     InsertSizeLoopDetector(const Graph& g, size_t is):
         visited_cycles_coverage_map_(g),
         path_storage_(),
-        min_cycle_len_(is) {
+        min_cycle_len_(is),
+        base_(nullptr) {
     }
 
     ~InsertSizeLoopDetector() {
@@ -765,47 +815,12 @@ public:
     //seems that it is outofdate
     bool InExistingLoop(const BidirectionalPath& path) {
         DEBUG("Checking existing loops");
-        auto visited_cycles = visited_cycles_coverage_map_.GetEdgePaths(path.Back());
-        for (auto cycle : *visited_cycles) {
-            DEBUG("checking  cycle ");
-            int pos = path.FindLast(*cycle);
-            if (pos == -1)
-                continue;
-
-            int start_cycle_pos = pos + (int) cycle->Size();
-            bool only_cycles_in_tail = true;
-            int last_cycle_pos = start_cycle_pos;
-            DEBUG("start_cycle pos "<< last_cycle_pos);
-            for (int i = start_cycle_pos; i < (int) path.Size() - (int) cycle->Size(); i += (int) cycle->Size()) {
-                if (!path.CompareFrom(i, *cycle)) {
-                    only_cycles_in_tail = false;
-                    break;
-                } else {
-                    last_cycle_pos = i + (int) cycle->Size();
-                    DEBUG("last cycle pos changed " << last_cycle_pos);
-                }
-            }
-            DEBUG("last_cycle_pos " << last_cycle_pos);
-            only_cycles_in_tail = only_cycles_in_tail && cycle->CompareFrom(0, path.SubPath(last_cycle_pos));
-            if (only_cycles_in_tail) {
-// seems that most of this is useless, checking
-                VERIFY (last_cycle_pos == start_cycle_pos);
-                DEBUG("find cycle " << last_cycle_pos);
-                DEBUG("path");
-                path.PrintDEBUG();
-                DEBUG("last subpath");
-                path.SubPath(last_cycle_pos).PrintDEBUG();
-                DEBUG("cycle");
-                cycle->PrintDEBUG();
-                DEBUG("last_cycle_pos " << last_cycle_pos << " path size " << path.Size());
-                VERIFY(last_cycle_pos <= (int)path.Size());
-                DEBUG("last cycle pos + cycle " << last_cycle_pos + (int)cycle->Size());
-                VERIFY(last_cycle_pos + (int)cycle->Size() >= (int)path.Size());
-
+        if (base_ != nullptr) {
+            accessed_.insert(path.Back());
+            if (InVisitedCycle(base_->visited_cycles_coverage_map_, path))
                 return true;
-            }
         }
-        return false;
+        return InVisitedCycle(visited_cycles_coverage_map_, path);
     }
 
     void AddCycledEdges(const BidirectionalPath& path, size_t pos) {
@@ -813,13 +828,40 @@ public:
             DEBUG("Wrong position in IS cycle");
             return;
         }
-        BidirectionalPath * p = new BidirectionalPath(path.SubPath(pos));
+        AddCycle(path.SubPath(pos));
+    }
+
+    void AddCycle(const BidirectionalPath& cycle) {
+        BidirectionalPath * p = new BidirectionalPath(cycle);
         BidirectionalPath * cp = new BidirectionalPath(p->Conjugate());
         visited_cycles_coverage_map_.Subscribe(p);
         visited_cycles_coverage_map_.Subscribe(cp);
+        path_storage_.AddPair(p, cp);
         DEBUG("add cycle");
         p->PrintDEBUG();
     }
+
+    //Forgets own cycles and starts speculating over base, which
+    //should not be changed until the cycles are added back to it
+    void Speculate(const InsertSizeLoopDetector& base) {
+        for (auto iter = path_storage_.begin(); iter != path_storage_.end(); ++iter) {
+            visited_cycles_coverage_map_.RemovePath(iter.get());
+            visited_cycles_coverage_map_.RemovePath(iter.getConjugate());
+        }
+        path_storage_.DeleteAllPaths();
+        base_ = &base;
+        accessed_.clear();
+    }
+
+    //Cycles visited since Speculate
+    const PathContainer& cycles() const {
+        return path_storage_;
+    }
+
+    //Edges the cycles were looked up at since Speculate
+    const std::set<EdgeId>& accessed() const {
+        return accessed_;
+    }
 };
 
 class PathExtender {
@@ -831,6 +873,15 @@ public:
 
     virtual bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage = nullptr) = 0;
 
+    //Speculative growth (see CompositeExtender): the state shared between the seeds
+    //is looked up in base extender of the same type as well, own state is dropped
+    virtual void Speculate(const PathExtender& /*base*/) { }
+
+    //Adds the cycles visited and the edges the shared state was looked up at since Speculate
+    virtual void CollectSpeculation(PathContainer& /*cycles*/, std::set<EdgeId>& /*accessed*/) const { }
+
+    virtual void AddCycles(const PathContainer& /*cycles*/) { }
+
 protected:
     const Graph &g_;
     DECL_LOGGER("PathExtender")
@@ -838,91 +889,257 @@ protected:
 
 class CompositeExtender {
 public:
+    typedef vector<shared_ptr<PathExtender>> Extenders;
+    //Makes the same extenders as the given ones, but using another coverage map and used edge storage
+    typedef std::function<Extenders(const GraphCoverageMap&, UsedUniqueStorage&)> ExtendersFactory;
 
+    //When the factory is given, seeds are grown speculatively in parallel,
+    //the result is the same as the one of sequential growth
     CompositeExtender(const Graph &g, GraphCoverageMap& cov_map,
                       UsedUniqueStorage &unique,
-                      const vector<shared_ptr<PathExtender>> &pes)
+                      const vector<shared_ptr<PathExtender>> &pes,
+                      ExtendersFactory factory = nullptr)
             : g_(g),
               cover_map_(cov_map),
               used_storage_(unique),
-              extenders_(pes) {}
+              extenders_(pes),
+              factory_(std::move(factory)) {}
 
     void GrowAll(PathContainer& paths, PathContainer& result) {
         result.clear();
-        GrowAllPaths(paths, result);
+        if (factory_)
+            GrowAllPathsSpeculatively(paths, result);
+        else
+            GrowAllPaths(paths, result);
         result.FilterEmptyPaths();
     }
 
     void GrowPath(BidirectionalPath& path, PathContainer* paths_storage) {
-        while (MakeGrowStep(path, paths_storage)) { }
+        GrowPath(path, paths_storage, extenders_);
     }
 
 
 private:
+    //Extenders of a thread growing the seeds speculatively
+    struct SpeculationContext {
+        GraphCoverageMap cover_map;
+        UsedUniqueStorage used_storage;
+        Extenders extenders;
+
+        SpeculationContext(const Graph &g, const ScaffoldingUniqueEdgeStorage &unique)
+                : cover_map(g), used_storage(unique) {}
+    };
+
+    //Seed grown against the state at the beginning of its batch
+    struct Speculation {
+        bool grown;
+        //Grown path first, then the paths added by the extenders
+        PathContainer paths;
+        std::set<EdgeId> used;
+        //Cycles visited by every extender
+        vector<PathContainer> cycles;
+        //Edges the shared state was looked up at
+        std::set<EdgeId> accessed;
+    };
+
     const Graph &g_;
     GraphCoverageMap &cover_map_;
     UsedUniqueStorage &used_storage_;
-    vector<shared_ptr<PathExtender>> extenders_;
+    Extenders extenders_;
+    ExtendersFactory factory_;
 
-    bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage) {
+    bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage, const Extenders& extenders) const {
         DEBUG("make grow step composite extender");
 
         size_t current = 0;
-        while (current < extenders_.size()) {
-            DEBUG("step " << current << " of total " << extenders_.size());
-            if (extenders_[current]->MakeGrowStep(path, paths_storage)) {
+        while (current < extenders.size()) {
+            DEBUG("step " << current << " of total " << extenders.size());
+            if (extenders[current]->MakeGrowStep(path, paths_storage)) {
                 return true;
             }
            ++current;
         }
         return false;
     }
-    
+
+    void GrowPath(BidirectionalPath& path, PathContainer* paths_storage, const Extenders& extenders) const {
+        while (MakeGrowStep(path, paths_storage, extenders)) { }
+    }
+
+    void ReportProgress(size_t i, size_t total) const {
+        VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << total << " (" << i * 100 / total << "%)");
+        if (total > 10 && i % (total / 10 + 1) == 0) {
+            INFO("Processed " << i << " paths from " << total << " (" << i * 100 / total << "%)");
+        }
+    }
+
+    bool IsSeedToGrow(const BidirectionalPath& seed, UsedUniqueStorage& used_storage) const {
+        //In 2015 modes do not use a seed already used in paths.
+        //FIXME what is the logic here?
+        if (used_storage.UniqueCheckEnabled()) {
+            bool was_used = false;
+            for (size_t ind =0; ind < seed.Size(); ind++) {
+                EdgeId eid = seed.At(ind);
+                if (used_storage.CheckUsedAndUnique(eid)) {
+                    DEBUG("Used edge " << g_.int_id(eid));
+                    was_used = true;
+                    break;
+                } else {
+                    used_storage.insert(eid);
+                }
+            }
+            if (was_used) {
+                DEBUG("skipping already used seed");
+                return false;
+            }
+        }
+
+        return !cover_map_.IsCovered(seed);
+    }
+
+    void GrowSeed(const BidirectionalPath& seed, const BidirectionalPath& conj_seed,
+                  GraphCoverageMap& cover_map, const Extenders& extenders, PathContainer& result) const {
+        BidirectionalPath * path = new BidirectionalPath(seed);
+        BidirectionalPath * conjugatePath = new BidirectionalPath(conj_seed);
+        SubscribeCoverageMap(path, cover_map);
+        SubscribeCoverageMap(conjugatePath, cover_map);
+        result.AddPair(path, conjugatePath);
+        size_t count_trying = 0;
+        size_t current_path_len = 0;
+        do {
+            current_path_len = path->Length();
+            count_trying++;
+            GrowPath(*path, &result, extenders);
+            GrowPath(*conjugatePath, &result, extenders);
+        } while (count_trying < 10 && (path->Length() != current_path_len));
+        DEBUG("result path " << path->GetId());
+        path->PrintDEBUG();
+    }
+
     void GrowAllPaths(PathContainer& paths, PathContainer& result) {
         for (size_t i = 0; i < paths.size(); ++i) {
-            VERBOSE_POWER_T2(i, 100, "Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
-            if (paths.size() > 10 && i % (paths.size() / 10 + 1) == 0) {
-                INFO("Processed " << i << " paths from " << paths.size() << " (" << i * 100 / paths.size() << "%)");
+            ReportProgress(i, paths.size());
+            if (IsSeedToGrow(*paths.Get(i), used_storage_)) {
+                AddPath(result, *paths.Get(i), cover_map_);
+                GrowSeed(*paths.Get(i), *paths.GetConjugate(i), cover_map_, extenders_, result);
             }
-            //In 2015 modes do not use a seed already used in paths.
-            //FIXME what is the logic here?
-            if (used_storage_.UniqueCheckEnabled()) {
-                bool was_used = false;
-                for (size_t ind =0; ind < paths.Get(i)->Size(); ind++) {
-                    EdgeId eid = paths.Get(i)->At(ind);
-                    if (used_storage_.IsUsedAndUnique(eid)) {
-                        DEBUG("Used edge " << g_.int_id(eid));
-                        was_used = true;
-                        break;
-                    } else {
-                        used_storage_.insert(eid);
-                    }
-                }
-                if (was_used) {
-                    DEBUG("skipping already used seed");
-                    continue;
-                }
+        }
+    }
+
+    //Grows the seed with the extenders of the context, the shared state is only looked up
+    void Speculate(SpeculationContext& context, const PathContainer& paths, size_t i,
+                   Speculation& speculation) const {
+        speculation.paths.DeleteAllPaths();
+        speculation.cycles.clear();
+        speculation.cycles.resize(extenders_.size());
+
+        context.used_storage.Speculate(used_storage_);
+        for (size_t k = 0; k < extenders_.size(); ++k)
+            context.extenders[k]->Speculate(*extenders_[k]);
+
+        const BidirectionalPath& seed = *paths.Get(i);
+        speculation.grown = IsSeedToGrow(seed, context.used_storage);
+        if (speculation.grown) {
+            GrowSeed(seed, *paths.GetConjugate(i), context.cover_map, context.extenders, speculation.paths);
+            context.cover_map.RemovePath(speculation.paths.Get(0));
+            context.cover_map.RemovePath(speculation.paths.GetConjugate(0));
+        }
+
+        speculation.used = context.used_storage.used();
+        speculation.accessed = context.used_storage.accessed();
+        for (size_t k = 0; k < extenders_.size(); ++k)
+            context.extenders[k]->CollectSpeculation(speculation.cycles[k], speculation.accessed);
+        //Coverage of the seed is checked
+        for (size_t j = 0; j < seed.Size(); ++j)
+            speculation.accessed.insert(seed.At(j));
+    }
+
+    static void InsertEdges(const BidirectionalPath& path, std::set<EdgeId>& edges) {
+        for (size_t j = 0; j < path.Size(); ++j)
+            edges.insert(path.At(j));
+    }
+
+    //Applies the speculation to the shared state, the edges the state is changed at are added to changed
+    void Commit(const PathContainer& paths, size_t i, Speculation& speculation,
+                PathContainer& result, std::set<EdgeId>& changed) {
+        used_storage_.Merge(speculation.used);
+        changed.insert(speculation.used.begin(), speculation.used.end());
+
+        for (size_t k = 0; k < extenders_.size(); ++k) {
+            extenders_[k]->AddCycles(speculation.cycles[k]);
+            for (auto iter = speculation.cycles[k].begin(); iter != speculation.cycles[k].end(); ++iter) {
+                InsertEdges(*iter.get(), changed);
+                InsertEdges(*iter.getConjugate(), changed);
             }
+        }
 
-            if (!cover_map_.IsCovered(*paths.Get(i))) {
-                AddPath(result, *paths.Get(i), cover_map_);
-                BidirectionalPath * path = new BidirectionalPath(*paths.Get(i));
-                BidirectionalPath * conjugatePath = new BidirectionalPath(*paths.GetConjugate(i));
-                SubscribeCoverageMap(path, cover_map_);
-                SubscribeCoverageMap(conjugatePath, cover_map_);
+        if (speculation.grown) {
+            AddPath(result, *paths.Get(i), cover_map_);
+            InsertEdges(*paths.Get(i), changed);
+            InsertEdges(*paths.GetConjugate(i), changed);
+            //Paths are copied in the seed order to keep their ids ordered as in sequential growth
+            for (size_t j = 0; j < speculation.paths.size(); ++j) {
+                BidirectionalPath * path = new BidirectionalPath(*speculation.paths.Get(j));
+                BidirectionalPath * conjugatePath = new BidirectionalPath(*speculation.paths.GetConjugate(j));
+                //Paths added by the extenders are not in the coverage map
+                if (j == 0) {
+                    SubscribeCoverageMap(path, cover_map_);
+                    SubscribeCoverageMap(conjugatePath, cover_map_);
+                    InsertEdges(*path, changed);
+                    InsertEdges(*conjugatePath, changed);
+                }
                 result.AddPair(path, conjugatePath);
-                size_t count_trying = 0;
-                size_t current_path_len = 0;
-                do {
-                    current_path_len = path->Length();
-                    count_trying++;
-                    GrowPath(*path, &result);
-                    GrowPath(*conjugatePath, &result);
-                } while (count_trying < 10 && (path->Length() != current_path_len));
-                DEBUG("result path " << path->GetId());
-                path->PrintDEBUG();
             }
         }
+
+        speculation.paths.DeleteAllPaths();
+        speculation.cycles.clear();
+    }
+
+    static bool Intersects(const std::set<EdgeId>& edges, const std::set<EdgeId>& other) {
+        for (EdgeId e : edges) {
+            if (other.count(e))
+                return true;
+        }
+        return false;
+    }
+
+    //Seeds of a batch are grown in parallel against the state at the beginning of the batch.
+    //Speculations are committed in the seed order, the ones that looked up the state at the
+    //edges changed by the previous seeds of the batch are grown again against the actual state.
+    //So the result does not depend on the number of threads and is the same as for GrowAllPaths.
+    void GrowAllPathsSpeculatively(PathContainer& paths, PathContainer& result) {
+        size_t nthreads = omp_get_max_threads();
+        vector<std::unique_ptr<SpeculationContext>> contexts;
+        for (size_t t = 0; t < nthreads; ++t) {
+            contexts.emplace_back(new SpeculationContext(g_, used_storage_.unique_edge_storage()));
+            contexts.back()->extenders = factory_(contexts.back()->cover_map, contexts.back()->used_storage);
+            VERIFY(contexts.back()->extenders.size() == extenders_.size());
+        }
+
+        const size_t batch_size = 16 * nthreads;
+        vector<Speculation> speculations(batch_size);
+        size_t regrown = 0;
+        for (size_t start = 0; start < paths.size(); start += batch_size) {
+            size_t end = std::min(start + batch_size, paths.size());
+
+#           pragma omp parallel for schedule(dynamic)
+            for (size_t i = start; i < end; ++i) {
+                Speculate(*contexts[omp_get_thread_num()], paths, i, speculations[i - start]);
+            }
+
+            std::set<EdgeId> changed;
+            for (size_t i = start; i < end; ++i) {
+                ReportProgress(i, paths.size());
+                Speculation& speculation = speculations[i - start];
+                if (Intersects(speculation.accessed, changed)) {
+                    Speculate(*contexts.front(), paths, i, speculation);
+                    ++regrown;
+                }
+                Commit(paths, i, speculation, result, changed);
+            }
+        }
+        INFO("Seeds grown in parallel, " << regrown << " of " << paths.size() << " were grown again due to conflicts");
     }
 
 };
@@ -1045,6 +1262,25 @@ public:
         return result;
     }
 
+    void Speculate(const PathExtender& base) override {
+        auto detecting_base = dynamic_cast<const LoopDetectingPathExtender*>(&base);
+        VERIFY(detecting_base != nullptr);
+        is_detector_.Speculate(detecting_base->is_detector_);
+    }
+
+    void CollectSpeculation(PathContainer& cycles, std::set<EdgeId>& accessed) const override {
+        for (auto iter = is_detector_.cycles().begin(); iter != is_detector_.cycles().end(); ++iter) {
+            cycles.AddPair(new BidirectionalPath(*iter.get()), new BidirectionalPath(*iter.getConjugate()));
+        }
+        accessed.insert(is_detector_.accessed().begin(), is_detector_.accessed().end());
+    }
+
+    void AddCycles(const PathContainer& cycles) override {
+        for (auto iter = cycles.begin(); iter != cycles.end(); ++iter) {
+            is_detector_.AddCycle(*iter.get());
+        }
+    }
+
 private:
     bool ResolveShortLoop(BidirectionalPath& p) {
         if (use_short_loop_cov_resolver_) {
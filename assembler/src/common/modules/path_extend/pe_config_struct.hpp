@@ -171,6 +171,8 @@ struct pe_config {
 
         std::map<std::string, PathFiltrationT> path_filtration;
 
+        bool speculative_growth;
+
         bool use_coordinated_coverage;
 
         struct CoordinatedCoverageT {
@@ -117,6 +117,13 @@ public:
         ProcessPath(path, true);
     }
 
+    //Drops all the edges of the path, it should not be changed afterwards
+    void RemovePath(BidirectionalPath * path) {
+        for (size_t i = 0; i < path->Size(); ++i) {
+            EdgeRemoved(path->At(i), path);
+        }
+    }
+
     //Inherited from PathListener
     void FrontEdgeAdded(EdgeId e, BidirectionalPath * path, const Gap&) override {
         EdgeAdded(e, path);
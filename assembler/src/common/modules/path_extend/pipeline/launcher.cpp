@@ -303,7 +303,7 @@ void PathExtendLauncher::AddScaffUniqueStorage(size_t uniqe_edge_len) {
     additional_edge_analyzer.FillUniqueEdgeStorage(unique_data_.unique_storages_.back());
 }
 
-Extenders PathExtendLauncher::ConstructMPExtenders(const ExtendersGenerator &generator) {
+void PathExtendLauncher::FillMPUniqueEdgeStorages() {
     const pe_config::ParamSetT &pset = params_.pset;
 
     size_t cur_length = unique_data_.min_unique_length_ - pset.scaffolding2015.unique_length_step;
@@ -318,8 +318,6 @@ Extenders PathExtendLauncher::ConstructMPExtenders(const ExtendersGenerator &gen
         INFO("Will add final extenders for length " << lower_bound);
         AddScaffUniqueStorage(lower_bound);
     }
-
-    return generator.MakeMPExtenders();
 }
 
 void PathExtendLauncher::FillPathContainer(size_t lib_index, size_t size_threshold) {
@@ -381,28 +379,18 @@ void  PathExtendLauncher::FillPBUniqueEdgeStorages() {
     INFO(unique_data_.unique_pb_storage_.size() << " unique edges");
 }
 
-Extenders PathExtendLauncher::ConstructPBExtenders(const ExtendersGenerator &generator) {
-    FillPBUniqueEdgeStorages();
-    return generator.MakePBScaffoldingExtenders();
-}
-
-
 Extenders PathExtendLauncher::ConstructExtenders(const GraphCoverageMap &cover_map,
                                                  UsedUniqueStorage &used_unique_storage) {
     INFO("Creating main extenders, unique edge length = " << unique_data_.min_unique_length_);
     if (support_.SingleReadsMapped() || support_.HasLongReads())
         FillLongReadsCoverageMaps();
 
-    ExtendersGenerator generator(dataset_info_, params_, gp_, cover_map,
-                                 unique_data_, used_unique_storage, support_);
-    Extenders extenders = generator.MakeBasicExtenders();
-
     //long reads scaffolding extenders.
     if (support_.HasLongReads()) {
         if (params_.pset.sm == sm_old) {
             INFO("Will not use new long read scaffolding algorithm in this mode");
         } else {
-            utils::push_back_all(extenders, ConstructPBExtenders(generator));
+            FillPBUniqueEdgeStorages();
         }
     }
 
@@ -410,14 +398,30 @@ Extenders PathExtendLauncher::ConstructExtenders(const GraphCoverageMap &cover_m
         if (params_.pset.sm == sm_old) {
             INFO("Will not use mate-pairs is this mode");
         } else {
-            utils::push_back_all(extenders, ConstructMPExtenders(generator));
+            FillMPUniqueEdgeStorages();
         }
     }
 
+    Extenders extenders = MakeExtenders(cover_map, used_unique_storage);
+    INFO("Total number of extenders is " << extenders.size());
+    return extenders;
+}
+
+Extenders PathExtendLauncher::MakeExtenders(const GraphCoverageMap &cover_map,
+                                            UsedUniqueStorage &used_unique_storage) const {
+    ExtendersGenerator generator(dataset_info_, params_, gp_, cover_map,
+                                 unique_data_, used_unique_storage, support_);
+    Extenders extenders = generator.MakeBasicExtenders();
+
+    if (support_.HasLongReads() && params_.pset.sm != sm_old)
+        utils::push_back_all(extenders, generator.MakePBScaffoldingExtenders());
+
+    if (support_.HasMPReads() && params_.pset.sm != sm_old)
+        utils::push_back_all(extenders, generator.MakeMPExtenders());
+
     if (params_.pset.use_coordinated_coverage)
         utils::push_back_all(extenders, generator.MakeCoverageExtenders());
 
-    INFO("Total number of extenders is " << extenders.size());
     return extenders;
 }
 
@@ -495,9 +499,15 @@ void PathExtendLauncher::Launch() {
     GraphCoverageMap cover_map(gp_.g);
     UsedUniqueStorage used_unique_storage(unique_data_.main_unique_storage_);
     Extenders extenders = ConstructExtenders(cover_map, used_unique_storage);
+    //Seeds are grown in parallel by the extenders made for every thread when enabled
+    CompositeExtender::ExtendersFactory factory;
+    if (params_.pset.speculative_growth && omp_get_max_threads() > 1)
+        factory = [this](const GraphCoverageMap &thread_cover_map, UsedUniqueStorage &thread_used_storage) {
+            return MakeExtenders(thread_cover_map, thread_used_storage);
+        };
     CompositeExtender composite_extender(gp_.g, cover_map,
                                          used_unique_storage,
-                                         extenders);
+                                         extenders, factory);
 
     auto paths = resolver.ExtendSeeds(seeds, composite_extender);
     DebugOutputPaths(paths, "raw_paths");
@@ -69,11 +69,12 @@ class PathExtendLauncher {
 
     Extenders ConstructExtenders(const GraphCoverageMap &cover_map, UsedUniqueStorage &used_unique_storage);
 
-    Extenders ConstructMPExtenders(const ExtendersGenerator &generator);
+    //Only makes the extenders, the data they use should be already filled by ConstructExtenders
+    Extenders MakeExtenders(const GraphCoverageMap &cover_map, UsedUniqueStorage &used_unique_storage) const;
 
-    void AddScaffUniqueStorage(size_t uniqe_edge_len);
+    void FillMPUniqueEdgeStorages();
 
-    Extenders ConstructPBExtenders(const ExtendersGenerator &generator);
+    void AddScaffUniqueStorage(size_t uniqe_edge_len);
 
     void FilterPaths();
 
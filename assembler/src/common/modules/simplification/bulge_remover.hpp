@@ -22,6 +22,7 @@
 #include "assembly_graph/components/graph_component.hpp"
 #include "sequence/sequence_tools.hpp"
 #include "utils/standard_base.hpp"
+#include "utils/perf/hot_counters.hpp"
 #include <cmath>
 #include <stack>
 #include "math/xmath.h"
@@ -353,8 +354,10 @@ protected:
             return false;
         }
 
+        PERF_COUNT("bulge_remover.candidates", 1);
         vector<EdgeId> alternative = alternatives_analyzer_(e);
         if (!alternative.empty()) {
+            PERF_COUNT("bulge_remover.glued", 1);
             gluer_(e, alternative);
             return true;
         }
@@ -531,6 +534,7 @@ private:
 
     std::vector<std::vector<BulgeInfo>> FindBulges(const std::vector<EdgeId>& edge_buffer) const {
         DEBUG("Looking for bulges in parallel");
+        PERF_SCOPED_TIMER("bulge_remover.find_bulges");
         utils::perf_counter perf;
         std::vector<std::vector<BulgeInfo>> bulge_buffers(omp_get_max_threads());
         const size_t n = edge_buffer.size();
@@ -600,6 +604,7 @@ private:
     }
 
     size_t BasicProcessBulges(SmartEdgeSet& edges) {
+        ModificationBatch<Graph> batch(this->g());
         size_t triggered = 0;
         //usual br strategy
         for (; !edges.IsEnd(); ++edges) {
@@ -616,6 +621,8 @@ private:
 
     size_t ProcessBulges(const std::vector<BulgeInfo>& independent_bulges, SmartEdgeSet& interacting_edges) {
         DEBUG("Processing bulges");
+        PERF_SCOPED_TIMER("bulge_remover.process_bulges");
+        ModificationBatch<Graph> batch(this->g());
         utils::perf_counter perf;
 
         size_t triggered = 0;
@@ -697,6 +704,7 @@ public:
             DEBUG("Edge buffer filled");
 
             DEBUG("Edge buffer size " << edge_buffer.size());
+            PERF_HISTOGRAM("bulge_remover.buffer_size", edge_buffer.size());
             size_t inner_triggered = 0;
             //FIXME magic constant
             if (edge_buffer.size() < SMALL_BUFFER_THR) {
@@ -11,6 +11,7 @@
 #include "assembly_graph/graph_support/basic_edge_conditions.hpp"
 #include "assembly_graph/graph_support/graph_processing_algorithm.hpp"
 #include "sequence/sequence.hpp"
+#include "utils/perf/hot_counters.hpp"
 
 #include <set>
 
@@ -92,6 +93,7 @@ public:
      * @return true if edge judged to be tip and false otherwise.
      */
     bool Check(EdgeId e) const override {
+        PERF_COUNT("tip_clipper.checks", 1);
         return (IsTip(this->g().EdgeEnd(e)) || IsTip(this->g().EdgeStart(e)))
                 && (this->g().OutgoingEdgeCount(this->g().EdgeStart(e))
                         + this->g().IncomingEdgeCount(this->g().EdgeEnd(e)) > 2);
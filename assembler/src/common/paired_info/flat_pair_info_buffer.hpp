@@ -0,0 +1,257 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "paired_info.hpp"
+#include "utils/logger/logger.hpp"
+#include "adt/iterator_range.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+namespace omnigraph {
+
+namespace de {
+
+/**
+ * @brief Write-only buffer of the paired info.
+ *
+ * Points are appended as flat (e1, e2, point) records into per-thread
+ * chunked vectors, sharded by the first edge of the pair. So adding a
+ * point requires neither locking nor separate histogram allocation.
+ * When a thread buffers too many records, it reduces its own shards
+ * and merges them into the index given to FlushTo, so the memory is
+ * bounded by the limit rather than by the total number of points. The
+ * rest is merged by FillIndex: shards are sorted and reduced in
+ * parallel, after that the ready histograms are moved to the index.
+ */
+template<typename G, typename Traits>
+class FlatPairedBuffer {
+  public:
+    typedef G Graph;
+    typedef typename Graph::EdgeId EdgeId;
+    typedef std::pair<EdgeId, EdgeId> EdgePair;
+    typedef typename Traits::Expanded Point;
+    typedef typename Traits::Gapped InnerPoint;
+
+  private:
+    static const size_t SHARD_COUNT = 256;
+    // Per-thread counters are a cache line apart
+    static const size_t COUNTER_STRIDE = 64 / sizeof(size_t);
+
+    struct Record {
+        EdgeId e1, e2;
+        InnerPoint p;
+
+        bool operator<(const Record &that) const {
+            if (e1 != that.e1)
+                return e1 < that.e1;
+            if (e2 != that.e2)
+                return e2 < that.e2;
+            return p < that.p;
+        }
+    };
+
+    // Records are stored in chunks, so a growing shard is never copied.
+    // Chunks grow from small to large, so that the sparse shards of
+    // every thread do not occupy much memory.
+    class Shard {
+        static const size_t MIN_CHUNK = 1 << 4;
+        static const size_t MAX_CHUNK = 1 << 12;
+
+        std::vector<std::vector<Record>> chunks_;
+        size_t size_ = 0;
+
+      public:
+        void push_back(const Record &r) {
+            if (chunks_.empty() || chunks_.back().size() == chunks_.back().capacity()) {
+                chunks_.emplace_back();
+                chunks_.back().reserve(std::min(std::max(size_, MIN_CHUNK), MAX_CHUNK));
+            }
+            chunks_.back().push_back(r);
+            size_ += 1;
+        }
+
+        size_t size() const { return size_; }
+
+        // Moves the records to the end of the vector and frees the chunks
+        void MoveTo(std::vector<Record> &res) {
+            for (auto &chunk : chunks_) {
+                res.insert(res.end(), chunk.begin(), chunk.end());
+                std::vector<Record>().swap(chunk);
+            }
+            std::vector<std::vector<Record>>().swap(chunks_);
+            size_ = 0;
+        }
+    };
+
+    // Reduced shard: consecutive histograms of the edge pairs
+    struct Hists {
+        std::vector<std::pair<EdgePair, size_t>> starts;
+        std::vector<InnerPoint> points;
+    };
+
+  public:
+    FlatPairedBuffer(const Graph &g, size_t nthreads = 1)
+            : graph_(g) {
+        clear(nthreads);
+    }
+
+    const Graph &graph() const { return graph_; }
+
+    /**
+     * @brief Drops all the points and prepares the buffer to be filled
+     *        by the given number of threads. A thread buffering more than
+     *        max_thread_bytes of records flushes them (see FlushTo).
+     */
+    void clear(size_t nthreads, size_t max_thread_bytes = std::numeric_limits<size_t>::max()) {
+        buffers_.clear();
+        buffers_.resize(nthreads, std::vector<Shard>(SHARD_COUNT));
+        thread_records_.assign(nthreads * COUNTER_STRIDE, 0);
+        max_thread_records_ = std::max(max_thread_bytes / sizeof(Record), size_t(1));
+    }
+
+    void clear() {
+        clear(buffers_.size(), max_thread_records_ * sizeof(Record));
+    }
+
+    /**
+     * @brief Sets the index the points of a thread are merged into when
+     *        the thread exceeds its limit. Until it is set the points are
+     *        only buffered.
+     */
+    template<class Index>
+    void FlushTo(Index &index) {
+        flush_ = [&index](const Hists &hists) { MergeHists(hists, index); };
+    }
+
+    /**
+     * @brief Adds a point between two edges. Concurrent calls should come
+     *        with distinct thread indices.
+     */
+    void Add(size_t thread, EdgeId e1, EdgeId e2, Point p) {
+        InnerPoint sp = Traits::Shrink(p, graph_.length(e1));
+        // Gapped point is the same for the conjugate pair, and the index
+        // keeps only one histogram for them, so only the minimal pair is stored
+        EdgePair ep(e1, e2), conj(graph_.conjugate(e2), graph_.conjugate(e1));
+        if (conj < ep)
+            ep = conj;
+
+        buffers_[thread][std::hash<EdgeId>()(ep.first) % SHARD_COUNT].push_back({ ep.first, ep.second, sp });
+        if (++thread_records_[thread * COUNTER_STRIDE] >= max_thread_records_ && flush_)
+            FlushThread(thread);
+    }
+
+    /**
+     * @brief Returns the number of the points buffered (not merged yet).
+     */
+    size_t size() const {
+        size_t res = 0;
+        for (const auto &shards : buffers_)
+            for (const auto &shard : shards)
+                res += shard.size();
+        return res;
+    }
+
+    /**
+     * @brief Merges all the points into the index and clears the buffer.
+     */
+    template<class Index>
+    void FillIndex(Index &index) {
+        std::vector<Hists> hists(SHARD_COUNT);
+
+#       pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < SHARD_COUNT; ++i)
+            Reduce(CollectShard(i), hists[i]);
+
+        for (auto &h : hists) {
+            MergeHists(h, index);
+            Hists().starts.swap(h.starts);
+            Hists().points.swap(h.points);
+        }
+
+        clear();
+    }
+
+  private:
+    template<class Index>
+    static void MergeHists(const Hists &h, Index &index) {
+        for (size_t j = 0; j < h.starts.size(); ++j) {
+            size_t end = (j + 1 < h.starts.size() ? h.starts[j + 1].second : h.points.size());
+            const EdgePair &ep = h.starts[j].first;
+            index.MergeHist(ep.first, ep.second,
+                            adt::make_range(h.points.begin() + h.starts[j].second,
+                                            h.points.begin() + end));
+        }
+    }
+
+    // Reduces the shards of the thread one by one, so only a single shard
+    // is copied at a time. Other threads keep adding their points meanwhile.
+    void FlushThread(size_t thread) {
+        DEBUG("Thread " << thread << " flushes " << thread_records_[thread * COUNTER_STRIDE] << " points");
+        for (auto &shard : buffers_[thread]) {
+            std::vector<Record> records;
+            records.reserve(shard.size());
+            shard.MoveTo(records);
+            Hists hists;
+            Reduce(std::move(records), hists);
+
+            std::lock_guard<std::mutex> lock(flush_mutex_);
+            flush_(hists);
+        }
+        thread_records_[thread * COUNTER_STRIDE] = 0;
+    }
+
+    std::vector<Record> CollectShard(size_t idx) {
+        size_t size = 0;
+        for (const auto &shards : buffers_)
+            size += shards[idx].size();
+
+        std::vector<Record> res;
+        res.reserve(size);
+        for (auto &shards : buffers_)
+            shards[idx].MoveTo(res);
+
+        return res;
+    }
+
+    static void Reduce(std::vector<Record> shard, Hists &hists) {
+        std::sort(shard.begin(), shard.end());
+
+        for (size_t i = 0; i < shard.size(); ++i) {
+            const Record &r = shard[i];
+            if (i == 0 || r.e1 != shard[i - 1].e1 || r.e2 != shard[i - 1].e2) {
+                hists.starts.emplace_back(EdgePair(r.e1, r.e2), hists.points.size());
+                hists.points.push_back(r.p);
+            } else if (r.p == hists.points.back()) {
+                hists.points.back() += r.p;
+            } else {
+                hists.points.push_back(r.p);
+            }
+        }
+    }
+
+    const Graph &graph_;
+    std::vector<std::vector<Shard>> buffers_;
+    std::vector<size_t> thread_records_;
+    size_t max_thread_records_;
+    std::function<void(const Hists &)> flush_;
+    std::mutex flush_mutex_;
+
+    DECL_LOGGER("FlatPairedBuffer");
+};
+
+template<class Graph>
+using FlatPairedInfoBuffer = FlatPairedBuffer<Graph, RawPointTraits>;
+
+} // namespace de
+
+} // namespace omnigraph
@@ -9,6 +9,8 @@
 #define PAIR_INFO_FILLER_HPP_
 
 #include "paired_info/concurrent_pair_info_buffer.hpp"
+#include "paired_info/flat_pair_info_buffer.hpp"
+#include "utils/memory_limit.hpp"
 #include "modules/alignment/sequence_mapper_notifier.hpp"
 
 namespace debruijn_graph {
@@ -25,42 +27,57 @@ public:
 
     LatePairedIndexFiller(const Graph &graph, WeightF weight_f,
                           unsigned round_distance,
-                          omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index)
+                          omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index,
+                          bool flat_buffer = false)
             : weight_f_(std::move(weight_f)),
               paired_index_(paired_index),
               buffer_pi_(graph),
+              flat_buffer_pi_(graph),
+              flat_buffer_(flat_buffer),
               round_distance_(round_distance) {}
 
-    void StartProcessLibrary(size_t) override {
+    void StartProcessLibrary(size_t threads_count) override {
         DEBUG("Start processing: start");
-        buffer_pi_.clear();
+        if (flat_buffer_) {
+            // The points are merged into the index as soon as the buffered
+            // ones take a quarter of the free memory
+            paired_index_.clear();
+            flat_buffer_pi_.clear(threads_count, utils::get_free_memory() / (4 * threads_count));
+            flat_buffer_pi_.FlushTo(paired_index_);
+        } else {
+            buffer_pi_.clear();
+        }
         DEBUG("Start processing: end");
     }
 
     void StopProcessLibrary() override {
-        // paired_index_.Merge(buffer_pi_);
-        paired_index_.MoveAssign(buffer_pi_);
-        buffer_pi_.clear();
+        if (flat_buffer_) {
+            flat_buffer_pi_.FillIndex(paired_index_);
+        } else {
+            paired_index_.MoveAssign(buffer_pi_);
+            buffer_pi_.clear();
+        }
     }
     
-    void ProcessPairedRead(size_t,
+    void ProcessPairedRead(size_t thread_index,
                            const io::PairedRead& r,
                            const MappingPath<EdgeId>& read1,
                            const MappingPath<EdgeId>& read2) override {
-        ProcessPairedRead(read1, read2, r.distance());
+        ProcessPairedRead(thread_index, read1, read2, r.distance());
     }
 
-    void ProcessPairedRead(size_t,
+    void ProcessPairedRead(size_t thread_index,
                            const io::PairedReadSeq& r,
                            const MappingPath<EdgeId>& read1,
                            const MappingPath<EdgeId>& read2) override {
-        ProcessPairedRead(read1, read2, r.distance());
+        ProcessPairedRead(thread_index, read1, read2, r.distance());
     }
 
     virtual ~LatePairedIndexFiller() {}
 
 private:
-    void ProcessPairedRead(const MappingPath<EdgeId>& path1,
+    void ProcessPairedRead(size_t thread_index,
+                           const MappingPath<EdgeId>& path1,
                            const MappingPath<EdgeId>& path2, size_t read_distance) {
         for (size_t i = 0; i < path1.size(); ++i) {
             std::pair<EdgeId, MappingRange> mapping_edge_1 = path1[i];
@@ -84,8 +101,11 @@ private:
                     if (round_distance_ > 1)
                         edge_distance = int(std::round(edge_distance / double(round_distance_))) * round_distance_;
 
-                    buffer_pi_.Add(mapping_edge_1.first, mapping_edge_2.first,
-                                   omnigraph::de::RawPoint(edge_distance, weight));
+                    omnigraph::de::RawPoint p(edge_distance, weight);
+                    if (flat_buffer_)
+                        flat_buffer_pi_.Add(thread_index, mapping_edge_1.first, mapping_edge_2.first, p);
+                    else
+                        buffer_pi_.Add(mapping_edge_1.first, mapping_edge_2.first, p);
 
                 }
             }
@@ -96,6 +116,8 @@ private:
     WeightF weight_f_;
     omnigraph::de::UnclusteredPairedInfoIndexT<Graph>& paired_index_;
     omnigraph::de::ConcurrentPairedInfoBuffer<Graph> buffer_pi_;
+    omnigraph::de::FlatPairedInfoBuffer<Graph> flat_buffer_pi_;
+    bool flat_buffer_;
     unsigned round_distance_;
 
     DECL_LOGGER("LatePairedIndexFiller");
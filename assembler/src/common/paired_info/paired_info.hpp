@@ -24,13 +24,13 @@ class PairedIndex : public PairedBuffer<G, Traits, Container> {
     typedef PairedIndex<G, Traits, Container> self;
     typedef PairedBuffer<G, Traits, Container> base;
 
-    typedef typename base::InnerHistogram InnerHistogram;
     typedef typename base::InnerHistPtr InnerHistPtr;
-    typedef typename base::InnerPoint InnerPoint;
 
     using typename base::EdgePair;
 
 public:
+    typedef typename base::InnerHistogram InnerHistogram;
+    typedef typename base::InnerPoint InnerPoint;
     using typename base::Graph;
     using typename base::EdgeId;
     typedef typename base::InnerMap InnerMap;
@@ -315,6 +315,15 @@ public:
         VERIFY(this->size() >= index_to_add.size());
     }
 
+    /**
+     * @brief Adds the whole histogram of inner (gapped) points between two edges,
+     *        and its conjugate.
+     */
+    template<class OtherHist>
+    void MergeHist(EdgeId e1, EdgeId e2, const OtherHist &h) {
+        base::Merge(e1, e2, h);
+    }
+
     template<class Buffer>
     typename std::enable_if<std::is_convertible<typename Buffer::InnerMap, InnerMap>::value,
         void>::type MoveAssign(Buffer& from) {
@@ -492,6 +501,14 @@ public:
         return HistProxy(GetImpl(e1, e2), this->CalcOffset(e1));
     }
 
+    /**
+     * @brief Returns the underlying histogram of inner (gapped) points between two edges.
+     *        Used for serialization, when no point conversion is needed.
+     */
+    const InnerHistogram& GetRaw(EdgeId e1, EdgeId e2) const {
+        return GetImpl(e1, e2);
+    }
+
     /**
      * @brief Operator alias of Get(e1, e2).
      */
@@ -14,6 +14,7 @@
 
 #include "io/reads/file_reader.hpp"
 
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -210,6 +211,7 @@ void load(debruijn_config::construction& con,
     load(con.keep_perfect_loops, pt, "keep_perfect_loops", complete);
     load(con.read_buffer_size, pt, "read_buffer_size", complete);
     load(con.read_cov_threshold, pt, "read_cov_threshold", complete);
+    load(con.super_kmer_splitting, pt, "super_kmer_splitting", false);
 
     con.read_buffer_size *= 1024 * 1024;
     load(con.early_tc, pt, "early_tip_clipper", complete);
@@ -385,6 +387,7 @@ void load(debruijn_config::distance_estimator& de,
   load(de.raw_filter_threshold, pt, "raw_filter_threshold", complete);
   load(de.rounding_coeff, pt, "rounding_coeff", complete);
   load(de.rounding_thr, pt, "rounding_threshold", complete);
+  load(de.flat_paired_buffer, pt, "flat_paired_buffer", false);
 }
 
 void load(debruijn_config::smoothing_distance_estimator& ade,
@@ -701,6 +704,18 @@ void load_cfg(debruijn_config &cfg, boost::property_tree::ptree const &pt,
         cfg.mode = ModeByName<pipeline_type>(mode_str, PipelineTypeNames());
     }
 
+    //optional, e.g. "21 33 55"
+    for (auto entry : { std::make_pair("iterative_K", &cfg.iterative_K),
+                        std::make_pair("iterative_K_150", &cfg.iterative_K_150),
+                        std::make_pair("iterative_K_250", &cfg.iterative_K_250) }) {
+        if (auto value = pt.get_optional<std::string>(entry.first)) {
+            entry.second->clear();
+            std::istringstream ks(*value);
+            for (size_t k; ks >> k; )
+                entry.second->push_back(k);
+        }
+    }
+
     //FIXME
     load(cfg.tsa, pt, "tsa", complete);
 
@@ -741,7 +756,7 @@ void load_cfg(debruijn_config &cfg, boost::property_tree::ptree const &pt,
     load(cfg.use_scaffolder, pt, "use_scaffolder", complete);
     load(cfg.avoid_rc_connections, pt, "avoid_rc_connections", complete);
 
-    bool save_gp;
+    bool save_gp = false;
     load(save_gp, pt, "save_gp", complete);
     load(cfg.info_printers, pt, "info_printers", complete);
 
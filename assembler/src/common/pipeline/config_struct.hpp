@@ -344,11 +344,13 @@ struct debruijn_config {
         bool keep_perfect_loops;
         unsigned read_cov_threshold;
         size_t read_buffer_size;
+        bool super_kmer_splitting;
         construction() :
                 con_mode(construction_mode::extention),
                 keep_perfect_loops(true),
                 read_cov_threshold(0),
-                read_buffer_size(0) {}
+                read_buffer_size(0),
+                super_kmer_splitting(false) {}
     };
 
     simplification simp;
@@ -362,6 +364,10 @@ struct debruijn_config {
         unsigned raw_filter_threshold;
         double rounding_thr;
         double rounding_coeff;
+        // Fill the raw paired index via FlatPairedBuffer instead of ConcurrentPairedBuffer
+        bool flat_paired_buffer;
+        distance_estimator() :
+                flat_paired_buffer(false) {}
     };
 
     struct smoothing_distance_estimator {
@@ -511,6 +517,11 @@ struct debruijn_config {
     std::string single_read_prefix;
 
     size_t K;
+    // K values of the iterations run in one process, the last one is the main iteration
+    std::vector<size_t> iterative_K;
+    // K values used instead once the reads turn out to be at least 150 or 250 bp
+    // long, set for the default K values only
+    std::vector<size_t> iterative_K_150, iterative_K_250;
 
     bool main_iteration;
 
@@ -14,18 +14,21 @@
 #include "assembly_graph/components/graph_component.hpp"
 
 #include "paired_info/paired_info.hpp"
+#include "adt/iterator_range.hpp"
 
 #include "assembly_graph/core/graph.hpp"
 #include "assembly_graph/graph_support/detail_coverage.hpp"
 #include "modules/alignment/long_read_storage.hpp"
 
 #include "assembly_graph/core/order_and_law.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 
 #include <cmath>
 #include <set>
 #include <map>
 #include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <cstdio>
 
 namespace debruijn_graph {
@@ -78,6 +81,8 @@ bool LoadKmerMapper(const string& file_name,
 template<class EdgeIndex>
 void SaveEdgeIndex(const std::string& file_name,
                    const EdgeIndex& index) {
+    // The index might be mapped from the existing file, so do not overwrite it in-place
+    fs::remove_if_exists(file_name + ".kmidx");
     std::ofstream file;
     file.open((file_name + ".kmidx").c_str(),
               std::ios_base::binary | std::ios_base::out);
@@ -153,6 +158,168 @@ inline void DeserializePoint(FILE* file, size_t& e1, size_t& e2, Point &p) {
     VERIFY(read_count == 5);
 }
 
+/*
+ * Binary checkpoint format. All the files start with the magic, so they are
+ * distinguished from the text ones on load:
+ *
+ *   .grp  max id, vertex and edge records (fixed width, one per conjugate pair)
+ *   .sqn  chunks of length-prefixed 2-bit packed edge sequences
+ *   .cvr  edge ids and raw coverages (fixed width arrays)
+ *   .prd  chunks of sorted paired info runs (e1, e2, gapped points)
+ *
+ * Chunked files hold the end offsets of the chunks after the header, so the
+ * chunks are serialized and parsed in parallel by edge ranges.
+ */
+namespace binary {
+
+static const uint64_t CHECKPOINT_MAGIC = 0x544E504B43504453ull; // "SDPCKPNT"
+
+template<class T>
+void Write(std::ostream &os, const T &v) {
+    os.write((const char *) &v, sizeof(T));
+}
+
+template<class T>
+void Read(std::istream &is, T &v) {
+    is.read((char *) &v, sizeof(T));
+}
+
+template<class T>
+void WriteVector(std::ostream &os, const std::vector<T> &v) {
+    Write(os, uint64_t(v.size()));
+    os.write((const char *) v.data(), v.size() * sizeof(T));
+}
+
+template<class T>
+void ReadVector(std::istream &is, std::vector<T> &v) {
+    uint64_t size = 0;
+    Read(is, size);
+    v.resize(size);
+    is.read((char *) v.data(), size * sizeof(T));
+}
+
+// Points are stored with the types of the index, without any rounding
+inline void WritePoint(std::ostream &os, const RawGapPoint &p) {
+    Write(os, p.d);
+    Write(os, p.weight);
+}
+
+inline void WritePoint(std::ostream &os, const GapPoint &p) {
+    Write(os, p.d);
+    Write(os, p.weight);
+    Write(os, p.var);
+}
+
+inline void ReadPoint(std::istream &is, RawGapPoint &p) {
+    Read(is, p.d);
+    Read(is, p.weight);
+}
+
+inline void ReadPoint(std::istream &is, GapPoint &p) {
+    Read(is, p.d);
+    Read(is, p.weight);
+    Read(is, p.var);
+}
+
+inline bool IsBinary(const std::string &file_name) {
+    std::ifstream in(file_name, std::ios_base::binary | std::ios_base::in);
+    uint64_t magic = 0;
+    Read(in, magic);
+    return in.good() && magic == CHECKPOINT_MAGIC;
+}
+
+inline std::ofstream OpenForWrite(const std::string &file_name) {
+    std::ofstream out(file_name, std::ios_base::binary | std::ios_base::out);
+    VERIFY_MSG(out.good(), "Couldn't open file " << file_name << " on write");
+    Write(out, CHECKPOINT_MAGIC);
+    return out;
+}
+
+inline std::ifstream OpenForRead(const std::string &file_name) {
+    std::ifstream in(file_name, std::ios_base::binary | std::ios_base::in);
+    VERIFY_MSG(in.good(), "Couldn't find file " << file_name);
+    uint64_t magic = 0;
+    Read(in, magic);
+    VERIFY_MSG(in.good() && magic == CHECKPOINT_MAGIC, "Corrupted checkpoint file " << file_name);
+    return in;
+}
+
+// Several chunks per thread to balance the ranges of different weight
+inline size_t ChunkCount(size_t size) {
+    return std::max<size_t>(1, std::min<size_t>(size, 16 * omp_get_max_threads()));
+}
+
+inline std::pair<size_t, size_t> ChunkRange(size_t chunk, size_t chunk_count, size_t size) {
+    return { chunk * size / chunk_count, (chunk + 1) * size / chunk_count };
+}
+
+/**
+ * Serializes the chunks in parallel by f(chunk, os) and writes them one
+ * after another
+ */
+template<class F>
+void WriteChunks(const std::string &file_name, size_t chunk_count, F f) {
+    std::vector<std::string> chunks(chunk_count);
+#   pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < chunk_count; ++i) {
+        std::ostringstream os;
+        f(i, os);
+        chunks[i] = os.str();
+    }
+
+    std::ofstream out = OpenForWrite(file_name);
+    Write(out, uint64_t(chunk_count));
+    uint64_t end = 0;
+    for (const auto &chunk : chunks) {
+        end += chunk.size();
+        Write(out, end);
+    }
+    for (auto &chunk : chunks) {
+        out.write(chunk.data(), chunk.size());
+        std::string().swap(chunk);
+    }
+    VERIFY_MSG(out.good(), "Failed to write " << file_name);
+}
+
+/**
+ * Reads the index of the chunked file, then the chunks are parsed in
+ * parallel by f(chunk, is), every chunk through its own stream
+ */
+class ChunkReader {
+    std::string file_name_;
+    uint64_t start_;
+    std::vector<uint64_t> ends_;
+
+public:
+    explicit ChunkReader(const std::string &file_name)
+            : file_name_(file_name) {
+        std::ifstream in = OpenForRead(file_name);
+        uint64_t chunk_count = 0;
+        binary::Read(in, chunk_count);
+        ends_.resize(chunk_count);
+        in.read((char *) ends_.data(), chunk_count * sizeof(uint64_t));
+        VERIFY_MSG(in.good(), "Corrupted checkpoint file " << file_name);
+        start_ = in.tellg();
+    }
+
+    size_t size() const {
+        return ends_.size();
+    }
+
+    template<class F>
+    void Read(F f) const {
+#       pragma omp parallel for schedule(dynamic)
+        for (size_t i = 0; i < ends_.size(); ++i) {
+            std::ifstream is(file_name_, std::ios_base::binary | std::ios_base::in);
+            is.seekg(start_ + (i ? ends_[i - 1] : 0));
+            f(i, is);
+            VERIFY_MSG(is.good() && uint64_t(is.tellg()) == start_ + ends_[i],
+                       "Corrupted checkpoint file " << file_name_);
+        }
+    }
+};
+
+}
 
 template<class Graph>
 class DataPrinter {
@@ -184,13 +351,123 @@ class DataPrinter {
         }
     }
 
+    // One edge (vertex) of every conjugate pair, in the order of the component
+    template<class It>
+    static std::vector<typename std::iterator_traits<It>::value_type> Half(const Graph& g, It begin, It end) {
+        std::vector<typename std::iterator_traits<It>::value_type> res;
+        for (auto it = begin; it != end; ++it)
+            if (it->int_id() <= g.conjugate(*it).int_id())
+                res.push_back(*it);
+        return res;
+    }
+
+    std::vector<EdgeId> HalfEdges() const {
+        return Half(component_.g(), component_.e_begin(), component_.e_end());
+    }
+
+    void SaveBinaryGraph(const string& file_name) const {
+        const Graph& g = component_.g();
+        std::vector<uint64_t> vertices, edges;
+        for (VertexId v : Half(g, component_.v_begin(), component_.v_end()))
+            vertices.insert(vertices.end(), { v.int_id(), g.conjugate(v).int_id() });
+        for (EdgeId e : HalfEdges())
+            edges.insert(edges.end(), { e.int_id(), g.EdgeStart(e).int_id(),
+                                        g.EdgeEnd(e).int_id(), g.conjugate(e).int_id() });
+
+        std::ofstream out = binary::OpenForWrite(file_name + ".grp");
+        binary::Write(out, uint64_t(g.GetGraphIdDistributor().GetMax()));
+        binary::WriteVector(out, vertices);
+        binary::WriteVector(out, edges);
+        VERIFY_MSG(out.good(), "Failed to write " << file_name << ".grp");
+    }
+
+    void SaveBinaryEdgeSequences(const string& file_name) const {
+        std::vector<EdgeId> edges = HalfEdges();
+        size_t chunks = binary::ChunkCount(edges.size());
+        binary::WriteChunks(file_name + ".sqn", chunks, [&](size_t chunk, std::ostream& os) {
+            auto range = binary::ChunkRange(chunk, chunks, edges.size());
+            binary::Write(os, uint64_t(range.first));
+            binary::Write(os, uint64_t(range.second));
+            for (size_t i = range.first; i < range.second; ++i)
+                component_.g().EdgeNucls(edges[i]).BinWrite(os);
+        });
+    }
+
+    void SaveBinaryCoverage(const string& file_name) const {
+        std::vector<EdgeId> edges(component_.e_begin(), component_.e_end());
+        std::vector<uint64_t> ids(edges.size());
+        std::vector<uint32_t> coverage(edges.size());
+#       pragma omp parallel for
+        for (size_t i = 0; i < edges.size(); ++i) {
+            ids[i] = edges[i].int_id();
+            coverage[i] = component_.g().coverage_index().RawCoverage(edges[i]);
+        }
+
+        std::ofstream out = binary::OpenForWrite(file_name + ".cvr");
+        binary::WriteVector(out, ids);
+        binary::WriteVector(out, coverage);
+        VERIFY_MSG(out.good(), "Failed to write " << file_name << ".cvr");
+    }
+
+    template<class Index>
+    void SaveBinaryPaired(const string& file_name,
+                          Index const& paired_index) const {
+        std::vector<EdgeId> edges(component_.e_begin(), component_.e_end());
+        std::sort(edges.begin(), edges.end(), [](EdgeId e1, EdgeId e2) { return e1.int_id() < e2.int_id(); });
+        size_t chunks = binary::ChunkCount(edges.size());
+        binary::WriteChunks(file_name + ".prd", chunks, [&](size_t chunk, std::ostream& os) {
+            auto range = binary::ChunkRange(chunk, chunks, edges.size());
+            std::ostringstream runs;
+            uint64_t run_count = 0;
+            for (size_t i = range.first; i < range.second; ++i) {
+                EdgeId e1 = edges[i];
+                // Only the stored halves are saved, conjugate ones are restored on load
+                for (auto entry : paired_index.GetHalf(e1)) {
+                    EdgeId e2 = entry.first;
+                    if (!component_.contains(e2))
+                        continue;
+                    const auto& hist = paired_index.GetRaw(e1, e2);
+                    binary::Write(runs, uint64_t(e1.int_id()));
+                    binary::Write(runs, uint64_t(e2.int_id()));
+                    binary::Write(runs, uint64_t(hist.size()));
+                    for (const auto& point : hist)
+                        binary::WritePoint(runs, point);
+                    run_count += 1;
+                }
+            }
+            binary::Write(os, run_count);
+            const std::string& data = runs.str();
+            os.write(data.data(), data.size());
+        });
+    }
+
   public:
+    /**
+     * Sets the format of the saves: binary checkpoint or human-readable
+     * text (default), which is kept for debugging and external tools
+     */
+    void set_binary(bool binary) {
+        binary_ = binary;
+    }
+
+    bool binary() const {
+        return binary_;
+    }
 
     void SaveGraph(const string& file_name) const {
+        // The id bound is kept in text for both formats, tools read it as is
         FILE* gid_file = fopen((file_name + ".gid").c_str(), "w");
+        VERIFY_MSG(gid_file != NULL,
+                   "Couldn't open file " << (file_name + ".gid") << " on write");
         size_t max_id = this->component().g().GetGraphIdDistributor().GetMax();
         fprintf(gid_file, "%zu\n", max_id);
         fclose(gid_file);
+
+        if (binary_) {
+            SaveBinaryGraph(file_name);
+            return;
+        }
+
         FILE* file = fopen((file_name + ".grp").c_str(), "w");
         DEBUG("Graph saving to " << file_name << " started");
         VERIFY_MSG(file != NULL,
@@ -213,6 +490,11 @@ class DataPrinter {
     }
 
     void SaveEdgeSequences(const string& file_name) const {
+        if (binary_) {
+            SaveBinaryEdgeSequences(file_name);
+            return;
+        }
+
         ofstream out(file_name + ".sqn");
         //todo switch to general function after its switching to fasta
         DEBUG("Saving sequences, " << file_name <<" created");
@@ -224,6 +506,11 @@ class DataPrinter {
     }
 
     void SaveCoverage(const string& file_name) const {
+        if (binary_) {
+            SaveBinaryCoverage(file_name);
+            return;
+        }
+
         ofstream out(file_name + ".cvr");
         DEBUG("Saving coverage, " << file_name <<" created");
         SaveEdgeAssociatedInfo(component_.g().coverage_index(), out);
@@ -238,6 +525,11 @@ class DataPrinter {
     template<class Index>
     void SavePaired(const string& file_name,
                     Index const& paired_index) const {
+        if (binary_) {
+            SaveBinaryPaired(file_name, paired_index);
+            return;
+        }
+
         FILE* file = fopen((file_name + ".prd").c_str(), "w");
         DEBUG("Saving paired info, " << file_name <<" created");
         VERIFY(file != NULL);
@@ -296,6 +588,7 @@ class DataPrinter {
     }
 
     const GraphComponent<Graph> component_;
+    bool binary_;
 
     virtual std::string ToPrint(VertexId v) const = 0;
     virtual std::string ToPrint(EdgeId e) const = 0;
@@ -308,7 +601,7 @@ class DataPrinter {
 //    }
 
     DataPrinter(GraphComponent<Graph>&& component) :
-            component_(std::move(component)) {
+            component_(std::move(component)), binary_(false) {
     }
 
     const GraphComponent<Graph>& component() const {
@@ -410,6 +703,10 @@ class DataScanner {
 
     void LoadCoverage(const string& file_name) {
         INFO("Reading coverage from " << file_name);
+        if (binary::IsBinary(file_name + ".cvr")) {
+            LoadBinaryCoverage(file_name);
+            return;
+        }
         ifstream in(file_name + ".cvr");
         LoadEdgeAssociatedInfo(g_.coverage_index(), in);
     }
@@ -430,6 +727,10 @@ class DataScanner {
                     Index& paired_index,
                     bool force_exists = true) {
         typedef typename Graph::EdgeId EdgeId;
+        if (binary::IsBinary(file_name + ".prd")) {
+            LoadBinaryPaired(file_name, paired_index);
+            return;
+        }
         FILE* file = fopen((file_name + ".prd").c_str(), "r");
         INFO((file_name + ".prd"));
         if (force_exists) {
@@ -509,6 +810,81 @@ class DataScanner {
     }
 
   private:
+    void LoadBinaryCoverage(const string& file_name) {
+        std::ifstream in = binary::OpenForRead(file_name + ".cvr");
+        std::vector<uint64_t> ids;
+        std::vector<uint32_t> coverage;
+        binary::ReadVector(in, ids);
+        binary::ReadVector(in, coverage);
+        VERIFY_MSG(in.good() && ids.size() == coverage.size(),
+                   "Corrupted checkpoint file " << file_name << ".cvr");
+
+        std::vector<EdgeId> edges(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            auto it = edge_id_map_.find(ids[i]);
+            VERIFY(it != edge_id_map_.end());
+            edges[i] = it->second;
+        }
+
+#       pragma omp parallel for
+        for (size_t i = 0; i < edges.size(); ++i)
+            g_.coverage_index().SetRawCoverage(edges[i], coverage[i]);
+    }
+
+    template<typename Index>
+    void LoadBinaryPaired(const string& file_name, Index& paired_index) {
+        typedef typename Index::InnerPoint InnerPoint;
+        struct Runs {
+            std::vector<std::tuple<EdgeId, EdgeId, size_t>> starts;
+            std::vector<InnerPoint> points;
+        };
+
+        INFO("Reading paired info from " << file_name << " started");
+        binary::ChunkReader reader(file_name + ".prd");
+        std::vector<Runs> chunks(reader.size());
+        reader.Read([&](size_t chunk, std::istream& is) {
+            Runs& runs = chunks[chunk];
+            uint64_t run_count = 0;
+            binary::Read(is, run_count);
+            for (uint64_t i = 0; i < run_count; ++i) {
+                uint64_t first_real_id, second_real_id, size;
+                binary::Read(is, first_real_id);
+                binary::Read(is, second_real_id);
+                binary::Read(is, size);
+
+                auto e1 = edge_id_map_.find(first_real_id), e2 = edge_id_map_.find(second_real_id);
+                VERIFY(e1 != edge_id_map_.end());
+                bool skip = (e2 == edge_id_map_.end());
+                if (!skip)
+                    runs.starts.emplace_back(e1->second, e2->second, runs.points.size());
+
+                // Self-conjugate pairs are stored with doubled weights, and
+                // merge would double them once again
+                bool selfconj = !skip && e1->second == g_.conjugate(e2->second);
+                for (uint64_t j = 0; j < size; ++j) {
+                    InnerPoint point;
+                    binary::ReadPoint(is, point);
+                    if (skip)
+                        continue;
+                    if (selfconj)
+                        point.weight = point.weight / 2;
+                    runs.points.push_back(point);
+                }
+            }
+        });
+
+        for (auto& runs : chunks) {
+            for (size_t i = 0; i < runs.starts.size(); ++i) {
+                size_t start = std::get<2>(runs.starts[i]);
+                size_t end = (i + 1 < runs.starts.size() ? std::get<2>(runs.starts[i + 1]) : runs.points.size());
+                paired_index.MergeHist(std::get<0>(runs.starts[i]), std::get<1>(runs.starts[i]),
+                                       adt::make_range(runs.points.begin() + start, runs.points.begin() + end));
+            }
+            Runs().points.swap(runs.points);
+        }
+        DEBUG("PII SIZE " << paired_index.size());
+    }
+
     Graph& g_;
     //  int edge_count_;
     map<size_t, EdgeId> edge_id_map_;
@@ -566,9 +942,59 @@ private:
         }
     }
 
+    void LoadBinaryGraph(const string& file_name) {
+        INFO("Reading conjugate de bruijn graph from " << file_name << " started");
+        uint64_t max_id = 0;
+        std::vector<uint64_t> vertices, edges;
+        {
+            std::ifstream in = binary::OpenForRead(file_name + ".grp");
+            binary::Read(in, max_id);
+            binary::ReadVector(in, vertices);
+            binary::ReadVector(in, edges);
+            VERIFY_MSG(in.good(), "Corrupted checkpoint file " << file_name << ".grp");
+        }
+
+        // Sequences are unpacked in parallel, the graph itself is built sequentially
+        size_t edge_count = edges.size() / 4;
+        std::vector<Sequence> sequences(edge_count);
+        binary::ChunkReader reader(file_name + ".sqn");
+        reader.Read([&](size_t, std::istream& is) {
+            uint64_t from = 0, to = 0;
+            binary::Read(is, from);
+            binary::Read(is, to);
+            VERIFY(from <= to && to <= edge_count);
+            for (size_t i = from; i < to; ++i)
+                sequences[i].BinRead(is);
+        });
+
+        auto id_storage = this->g().GetGraphIdDistributor().Reserve(max_id, /*force_zero_shift*/true);
+        for (size_t i = 0; i < vertices.size(); i += 2) {
+            size_t ids[2] = {vertices[i], vertices[i + 1]};
+            auto id_distributor = id_storage.GetSegmentIdDistributor(ids, ids + 2);
+            VertexId vid = this->g().AddVertex(typename Graph::VertexData(), id_distributor);
+            this->vertex_id_map()[ids[0]] = vid;
+            this->vertex_id_map()[ids[1]] = this->g().conjugate(vid);
+        }
+
+        for (size_t i = 0; i < edge_count; ++i) {
+            const uint64_t *record = &edges[4 * i];
+            size_t ids[2] = {record[0], record[3]};
+            auto id_distributor = id_storage.GetSegmentIdDistributor(ids, ids + 2);
+            EdgeId eid = this->g().AddEdge(this->vertex_id_map()[record[1]], this->vertex_id_map()[record[2]],
+                                           sequences[i], id_distributor);
+            this->edge_id_map()[ids[0]] = eid;
+            this->edge_id_map()[ids[1]] = this->g().conjugate(eid);
+        }
+    }
+
   public:
     /*virtual*/
     void LoadGraph(const string& file_name) {
+        if (binary::IsBinary(file_name + ".grp")) {
+            LoadBinaryGraph(file_name);
+            return;
+        }
+
         auto id_storage = this->g().GetGraphIdDistributor().Reserve(GetMaxId(file_name + ".gid"), 
                 /*force_zero_shift*/true);
         INFO("Trying to read conjugate de bruijn graph from " << file_name << ".grp");
@@ -785,9 +1211,14 @@ void PrintSingleLongReads(const string& file_name, const LongReadContainer<Graph
     }
 }
 
+/**
+ * Saves the whole graph pack. Binary checkpoint is written by default, the
+ * text format is supposed to be used for debugging.
+ */
 template<class graph_pack>
-void PrintAll(const string& file_name, const graph_pack& gp) {
+void PrintAll(const string& file_name, const graph_pack& gp, bool binary = true) {
     ConjugateDataPrinter<typename graph_pack::graph_t> printer(gp.g, gp.g.begin(), gp.g.end());
+    printer.set_binary(binary);
     PrintGraphPack(file_name, printer, gp);
     PrintUnclusteredIndices(file_name, printer, gp.paired_indices);
     PrintClusteredIndices(file_name, printer, gp.clustered_indices);
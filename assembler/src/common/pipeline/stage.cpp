@@ -98,16 +98,17 @@ void CompositeStageBase::run(debruijn_graph::conj_graph_pack& gp,
     for (auto et = phases_.end(); start_phase != et; ++start_phase) {
         PhaseBase *phase = start_phase->get();
 
+        std::string composite_id(id());
+        composite_id += ":";
+        composite_id += phase->id();
+
         INFO("PROCEDURE == " << phase->name());
+        auto usage = parent_->profiler().start();
         phase->run(gp, started_from);
+        parent_->profiler().finish(composite_id, phase->name(), true, usage);
 
-        if (parent_->saves_policy().make_saves_) {
-            std::string composite_id(id());
-            composite_id += ":";
-            composite_id += phase->id();
-
+        if (parent_->saves_policy().make_saves_)
             phase->save(gp, parent_->saves_policy().save_to_, composite_id.c_str());
-        }
     }
 
     fini(gp);
@@ -130,7 +131,9 @@ void StageManager::run(debruijn_graph::conj_graph_pack& g,
         AssemblyStage *stage = start_stage->get();
 
         INFO("STAGE == " << stage->name());
+        auto usage = profiler_.start();
         stage->run(g, start_from);
+        profiler_.finish(stage->id(), stage->name(), false, usage);
         if (saves_policy_.make_saves_)
             stage->save(g, saves_policy_.save_to_);
     }
@@ -9,6 +9,7 @@
 #define __STAGE_HPP__
 
 #include "pipeline/graph_pack.hpp"
+#include "pipeline/stage_profiler.hpp"
 
 #include <vector>
 #include <memory>
@@ -39,7 +40,7 @@ private:
     const char *id_;
 
 protected:
-    const StageManager *parent_;
+    StageManager *parent_;
 
     friend class StageManager;
 };
@@ -187,9 +188,19 @@ public:
         return saves_policy_;
     }
 
+    // Stages and phases record themselves while running
+    StageProfiler &profiler() {
+        return profiler_;
+    }
+
+    const StageProfiler &profiler() const {
+        return profiler_;
+    }
+
 private:
     std::vector<std::unique_ptr<AssemblyStage> > stages_;
     SavesPolicy saves_policy_;
+    StageProfiler profiler_;
 
     DECL_LOGGER("StageManager");
 };
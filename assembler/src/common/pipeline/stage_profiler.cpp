@@ -0,0 +1,131 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "pipeline/stage_profiler.hpp"
+
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/logger/logger.hpp"
+
+#include <cppformat/format.h>
+
+#include <fstream>
+
+namespace spades {
+
+double StageProfiler::Record::thread_utilization() const {
+    double wall = wall_time();
+    if (wall <= 0 || threads == 0)
+        return 0;
+    return cpu_time() / (wall * (double) threads);
+}
+
+static const char *kind_name(utils::perf::counter_kind kind) {
+    switch (kind) {
+        case utils::perf::counter_kind::histogram:
+            return "histogram";
+        case utils::perf::counter_kind::timer:
+            return "timer";
+        default:
+            return "count";
+    }
+}
+
+// Both are ordered by name, the counters without events are skipped
+static std::vector<utils::perf::counter_value> counters_delta(const std::vector<utils::perf::counter_value> &start,
+                                                              std::vector<utils::perf::counter_value> finish) {
+    std::vector<utils::perf::counter_value> res;
+    auto it = start.begin();
+    for (auto &value : finish) {
+        while (it != start.end() && it->name < value.name)
+            ++it;
+        if (it != start.end() && it->name == value.name) {
+            value.count -= it->count;
+            value.total -= it->total;
+            for (size_t i = 0; i < it->buckets.size(); ++i)
+                value.buckets[i] -= it->buckets[i];
+        }
+        if (value.count)
+            res.push_back(std::move(value));
+    }
+    return res;
+}
+
+void StageProfiler::finish(const std::string &id, const char *name, bool phase,
+                           const Snapshot &start) {
+    records_.push_back({ id, name, phase, (size_t) omp_get_max_threads(),
+                         start.usage, utils::get_resource_usage(),
+                         counters_delta(start.counters, utils::perf::collect()) });
+    for (const auto &value : records_.back().counters)
+        INFO("Counter " << value.name << " (" << kind_name(value.kind) << "): "
+             << value.count << " events, total " << value.total);
+    if (!report_.empty())
+        WriteReport(report_);
+}
+
+static std::string json_string(const std::string &s) {
+    std::string res = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            res += '\\';
+        res += c;
+    }
+    return res + "\"";
+}
+
+static long long delta(size_t start, size_t finish) {
+    return (long long) finish - (long long) start;
+}
+
+void StageProfiler::WriteReport(const std::string &filename) const {
+    std::ofstream os(filename);
+    if (!os) {
+        WARN("Cannot write stage profile to " << filename);
+        return;
+    }
+
+    os << "{\n  \"stages\": [";
+    for (size_t i = 0; i < records_.size(); ++i) {
+        const Record &r = records_[i];
+        os << (i ? ",\n" : "\n")
+           << fmt::format("    {{\"id\": {}, \"name\": {}, \"type\": \"{}\", \"threads\": {}, "
+                          "\"wall_time\": {:.3f}, \"cpu_time\": {:.3f}, \"thread_utilization\": {:.3f}, ",
+                          json_string(r.id), json_string(r.name), r.phase ? "phase" : "stage", r.threads,
+                          r.wall_time(), r.cpu_time(), r.thread_utilization())
+           << fmt::format("\"max_rss\": {}, \"max_rss_delta\": {}, "
+                          "\"heap_allocated\": {}, \"heap_allocated_delta\": {}, "
+                          "\"heap_active\": {}, \"heap_active_delta\": {}, ",
+                          r.finish.max_rss, delta(r.start.max_rss, r.finish.max_rss),
+                          r.finish.heap_allocated, delta(r.start.heap_allocated, r.finish.heap_allocated),
+                          r.finish.heap_active, delta(r.start.heap_active, r.finish.heap_active))
+           << fmt::format("\"read_chars\": {}, \"write_chars\": {}, "
+                          "\"storage_read\": {}, \"storage_write\": {}",
+                          delta(r.start.read_chars, r.finish.read_chars),
+                          delta(r.start.write_chars, r.finish.write_chars),
+                          delta(r.start.storage_read, r.finish.storage_read),
+                          delta(r.start.storage_write, r.finish.storage_write));
+        if (!r.counters.empty()) {
+            os << ", \"counters\": {";
+            for (size_t j = 0; j < r.counters.size(); ++j) {
+                const auto &value = r.counters[j];
+                os << (j ? ", " : "")
+                   << fmt::format("{}: {{\"kind\": \"{}\", \"count\": {}, \"total\": {}",
+                                  json_string(value.name), kind_name(value.kind), value.count, value.total);
+                if (!value.buckets.empty()) {
+                    os << ", \"buckets\": [";
+                    for (size_t b = 0; b < value.buckets.size(); ++b)
+                        os << (b ? ", " : "") << value.buckets[b];
+                    os << "]";
+                }
+                os << "}";
+            }
+            os << "}";
+        }
+        os << "}";
+    }
+    os << "\n  ]\n}\n";
+}
+
+}
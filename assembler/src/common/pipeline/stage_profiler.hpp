@@ -0,0 +1,62 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "utils/perf/resource_usage.hpp"
+#include "utils/perf/hot_counters.hpp"
+
+#include <string>
+#include <vector>
+
+namespace spades {
+
+// Collects the resources used by every stage and phase run. When the report
+// file is set, it is rewritten in JSON after every record, so the report of
+// an interrupted run contains all the stages finished. The hot path counters
+// (utils/perf/hot_counters.hpp) are aggregated for every record as well.
+class StageProfiler {
+public:
+    struct Snapshot {
+        utils::resource_usage usage;
+        std::vector<utils::perf::counter_value> counters;
+    };
+
+    struct Record {
+        std::string id;
+        std::string name;
+        bool phase;
+        size_t threads;
+        utils::resource_usage start;
+        utils::resource_usage finish;
+        // Counter events during the run
+        std::vector<utils::perf::counter_value> counters;
+
+        double wall_time() const { return finish.wall_time - start.wall_time; }
+        double cpu_time() const { return finish.cpu_time - start.cpu_time; }
+        // Share of the available threads busy during the run
+        double thread_utilization() const;
+    };
+
+    void set_report(const std::string &filename) { report_ = filename; }
+
+    Snapshot start() const {
+        return { utils::get_resource_usage(), utils::perf::collect() };
+    }
+
+    void finish(const std::string &id, const char *name, bool phase,
+                const Snapshot &start);
+
+    const std::vector<Record> &records() const { return records_; }
+
+    void WriteReport(const std::string &filename) const;
+
+private:
+    std::vector<Record> records_;
+    std::string report_;
+};
+
+}
@@ -0,0 +1,114 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "seq_hamming.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+# define HAMMING_X86_KERNELS
+# include <immintrin.h>
+#endif
+
+namespace hamming {
+
+static void distances_scalar(const uint64_t *center, const uint64_t *seqs,
+                             size_t words, size_t n, unsigned *res) {
+    for (size_t i = 0; i < n; ++i, seqs += words)
+        res[i] = distance(center, seqs, words);
+}
+
+#ifdef HAMMING_X86_KERNELS
+
+__attribute__((target("popcnt")))
+static void distances_popcnt(const uint64_t *center, const uint64_t *seqs,
+                             size_t words, size_t n, unsigned *res) {
+    for (size_t i = 0; i < n; ++i, seqs += words) {
+        unsigned dist = 0;
+        for (size_t j = 0; j < words; ++j)
+            dist += (unsigned) __builtin_popcountll(mismatches(center[j], seqs[j]));
+        res[i] = dist;
+    }
+}
+
+// Four single-word sequences per step, the bytes are counted by the nibble
+// lookup table and summed up per word
+__attribute__((target("avx2,popcnt")))
+static void distances_avx2(const uint64_t *center, const uint64_t *seqs,
+                           size_t words, size_t n, unsigned *res) {
+    if (words != 1) {
+        distances_popcnt(center, seqs, words, n, res);
+        return;
+    }
+
+    const __m256i c = _mm256_set1_epi64x((long long) center[0]);
+    const __m256i low_bits = _mm256_set1_epi64x(0x5555555555555555LL);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lanes = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *) (seqs + i)), c);
+        x = _mm256_and_si256(_mm256_or_si256(x, _mm256_srli_epi64(x, 1)), low_bits);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(x, low_nibble)),
+                                      _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi64(x, 4), low_nibble)));
+        cnt = _mm256_sad_epu8(cnt, _mm256_setzero_si256());
+        cnt = _mm256_permutevar8x32_epi32(cnt, lanes);
+        _mm_storeu_si128((__m128i *) (res + i), _mm256_castsi256_si128(cnt));
+    }
+
+    for (; i < n; ++i)
+        res[i] = (unsigned) __builtin_popcountll(mismatches(center[0], seqs[i]));
+}
+
+#endif
+
+static kernel detect_kernel() {
+#ifdef HAMMING_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt")) {
+        if (__builtin_cpu_supports("avx2"))
+            return kernel::avx2;
+        return kernel::popcnt;
+    }
+#endif
+    return kernel::scalar;
+}
+
+kernel best_kernel() {
+    static const kernel k = detect_kernel();
+    return k;
+}
+
+const char *kernel_name(kernel k) {
+    switch (k) {
+        case kernel::scalar:
+            return "scalar";
+        case kernel::popcnt:
+            return "popcnt";
+        case kernel::avx2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+void distances(kernel k, const uint64_t *center, const uint64_t *seqs,
+               size_t words, size_t n, unsigned *res) {
+    switch (k) {
+#ifdef HAMMING_X86_KERNELS
+        case kernel::avx2:
+            distances_avx2(center, seqs, words, n, res);
+            return;
+        case kernel::popcnt:
+            distances_popcnt(center, seqs, words, n, res);
+            return;
+#endif
+        default:
+            distances_scalar(center, seqs, words, n, res);
+    }
+}
+
+}
@@ -0,0 +1,82 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "seq.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Hamming distance between 2-bit packed sequences computed on whole words:
+ * the nucleotides differ iff either bit of the XOR of their codes is set, so
+ * the distance is the popcount of the folded XOR.
+ *
+ * Batch comparison of one sequence against many is dispatched at runtime to
+ * the best kernel the CPU supports (AVX2, POPCNT or plain SWAR popcount).
+ */
+namespace hamming {
+
+enum class kernel {
+    scalar, popcnt, avx2
+};
+
+template<typename T>
+inline T mismatches(T x, T y) {
+    T d = x ^ y;
+    return (d | (d >> 1)) & (T(-1) / 3);
+}
+
+inline unsigned popcount(uint64_t x) {
+#ifdef __POPCNT__
+    return (unsigned) __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (unsigned) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+template<typename T>
+inline unsigned distance(const T *x, const T *y, size_t words) {
+    unsigned res = 0;
+    for (size_t i = 0; i < words; ++i)
+        res += popcount(mismatches(x[i], y[i]));
+    return res;
+}
+
+// Exact distance, the unused bits of the last word are zero in Seq
+template<size_t size_, typename T>
+inline unsigned distance(const Seq<size_, T> &x, const Seq<size_, T> &y) {
+    return distance(x.data(), y.data(), Seq<size_, T>::DataSize);
+}
+
+// Kernel selected by the CPU features, detected once
+kernel best_kernel();
+
+const char *kernel_name(kernel k);
+
+// Distances between the center of the given number of words and n sequences of
+// the same number of words laid out contiguously
+void distances(kernel k, const uint64_t *center, const uint64_t *seqs,
+               size_t words, size_t n, unsigned *res);
+
+inline void distances(const uint64_t *center, const uint64_t *seqs,
+                      size_t words, size_t n, unsigned *res) {
+    distances(best_kernel(), center, seqs, words, n, res);
+}
+
+template<size_t size_>
+inline void distances(const Seq<size_, uint64_t> &center, const Seq<size_, uint64_t> *seqs,
+                      size_t n, unsigned *res) {
+    typedef Seq<size_, uint64_t> SeqT;
+    static_assert(sizeof(SeqT) == SeqT::TotalBytes, "Seq is expected to be a plain array of words");
+    distances(center.data(), reinterpret_cast<const uint64_t *>(seqs), SeqT::DataSize, n, res);
+}
+
+}
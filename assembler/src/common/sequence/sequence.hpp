@@ -18,7 +18,11 @@
 #include <llvm/ADT/IntrusiveRefCntPtr.h>
 #include <llvm/Support/TrailingObjects.h>
 
+class SequenceArena;
+
 class Sequence {
+    friend class SequenceArena;
+
     // Type to store Seq in Sequences
     typedef seq_element_type ST;
     // Number of bits in ST
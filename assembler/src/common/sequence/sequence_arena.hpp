@@ -0,0 +1,169 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "sequence.hpp"
+#include "nucl.hpp"
+
+#include <mutex>
+#include <vector>
+
+/**
+ * @class SequenceArena
+ * @section DESCRIPTION
+ *
+ * Append-only storage of 2-bit packed nucleotides. Sequences are stored one
+ * after another in large shared blocks and returned as Sequence views into
+ * these blocks, so no per-sequence heap buffer is allocated. Reverse
+ * complements and subsequences of the stored sequences are views into the
+ * same blocks as well. Block memory is released when the last view into it
+ * is gone.
+ *
+ * Every sequence starts from the word boundary, so different threads never
+ * write into the same word and could append concurrently.
+ */
+class SequenceArena {
+    typedef Sequence::ST ST;
+    static const size_t STN = Sequence::STN;
+
+    // Packs nucleotides into the words of a block one after another
+    class Writer {
+        ST *out_;
+        ST data_;
+        unsigned cnt_;
+
+    public:
+        explicit Writer(ST *out)
+                : out_(out), data_(0), cnt_(0) {}
+
+        void append(char c) {
+            data_ |= ST(is_dignucl(c) ? c : dignucl(c)) << cnt_;
+            cnt_ += 2;
+            if (cnt_ == Sequence::STBits) {
+                *out_++ = data_;
+                data_ = 0;
+                cnt_ = 0;
+            }
+        }
+
+        template<class S>
+        void append(const S &s, size_t from = 0) {
+            for (size_t i = from, e = s.size(); i < e; ++i)
+                append(s[i]);
+        }
+
+        void flush() {
+            if (cnt_)
+                *out_++ = data_;
+            data_ = 0;
+            cnt_ = 0;
+        }
+    };
+
+public:
+    explicit SequenceArena(size_t block_size = 1 << 20)
+            : block_size_(block_size), pos_(0) {}
+
+    SequenceArena(const SequenceArena &) = delete;
+    SequenceArena &operator=(const SequenceArena &) = delete;
+
+    /**
+     * Stores the copy of the sequence (Sequence, SequenceBuilder, Seq, etc.)
+     * in the arena
+     */
+    template<class S>
+    Sequence Append(const S &s) {
+        size_t from;
+        Sequence block = Reserve(s.size(), from);
+
+        Writer writer(block.data_->data() + (from >> Sequence::STNBits));
+        writer.append(s);
+        writer.flush();
+
+        return Sequence(block, from, s.size(), false);
+    }
+
+    /**
+     * Same as MergeOverlappingSequences, but if the sequences are already
+     * adjacent views of the same buffer (e.g. the parts of previously split
+     * edge), the range is reused and nothing is copied. Otherwise the result
+     * gets a dedicated buffer, not the arena space: merges go on during the
+     * whole simplification, and the merged sequences would pin arena blocks
+     * which are never compacted.
+     */
+    static Sequence Merge(const std::vector<Sequence> &ss, size_t overlap, bool safe_merging = true) {
+        if (ss.empty())
+            return Sequence();
+
+        if (safe_merging) {
+            for (size_t i = 1; i < ss.size(); ++i)
+                VERIFY(ss[i - 1].Subseq(ss[i - 1].size() - overlap) == ss[i].Subseq(0, overlap));
+        }
+
+        size_t size = overlap;
+        for (const Sequence &s : ss)
+            size += s.size() - overlap;
+
+        if (Adjacent(ss, overlap)) {
+            const Sequence &first = ss.front(), &last = ss.back();
+            return Sequence(first, first.rtl_ ? last.from_ : first.from_, size, first.rtl_);
+        }
+
+        Sequence res(size, 0);
+        Writer writer(res.data_->data());
+        writer.append(ss.front().Subseq(0, overlap));
+        for (const Sequence &s : ss)
+            writer.append(s, overlap);
+        writer.flush();
+
+        return res;
+    }
+
+private:
+    size_t block_size_;
+    std::mutex lock_;
+    Sequence block_;
+    size_t pos_;
+
+    // Reserves word-aligned range for size nucleotides, returns the
+    // sequence holding the corresponding buffer
+    Sequence Reserve(size_t size, size_t &from) {
+        // Large sequences get dedicated buffers, so the blocks are not wasted
+        if (size * 4 > block_size_) {
+            from = 0;
+            return Sequence(size, 0);
+        }
+
+        size_t aligned = Sequence::DataSize(size) * STN;
+        std::lock_guard<std::mutex> guard(lock_);
+        if (block_.size() == 0 || pos_ + aligned > block_.size()) {
+            block_ = Sequence(block_size_, 0);
+            pos_ = 0;
+        }
+
+        from = pos_;
+        pos_ += aligned;
+        return block_;
+    }
+
+    static bool Adjacent(const std::vector<Sequence> &ss, size_t overlap) {
+        if (ss.size() < 2)
+            return false;
+
+        for (size_t i = 1; i < ss.size(); ++i) {
+            const Sequence &prev = ss[i - 1], &cur = ss[i];
+            if (cur.data_ != prev.data_ || cur.rtl_ != prev.rtl_)
+                return false;
+            if (!cur.rtl_ && cur.from_ + overlap != prev.from_ + prev.size_)
+                return false;
+            if (cur.rtl_ && prev.from_ + overlap != cur.from_ + cur.size_)
+                return false;
+        }
+
+        return true;
+    }
+};
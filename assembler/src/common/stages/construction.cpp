@@ -14,6 +14,7 @@
 #include "assembly_graph/stats/picture_dump.hpp"
 
 #include "utils/filesystem/temporary.hpp"
+#include "utils/kmer_mph/super_kmer_splitter.hpp"
 
 #include "pipeline/graph_pack.hpp"
 #include "construction.hpp"
@@ -40,7 +41,7 @@ struct ConstructionStorage {
     utils::DeBruijnExtensionIndex<> ext_index;
 
     std::unique_ptr<qf::cqf> cqf;
-    std::unique_ptr<utils::KMerDiskCounter<RtSeq>> counter;
+    std::unique_ptr<utils::KMerCounter<RtSeq>> counter;
     std::unique_ptr<CoverageMap> coverage_map;
     config::debruijn_config::construction params;
     io::ReadStreamList<io::SingleReadSeq> read_streams;
@@ -68,7 +69,12 @@ void Construction::init(debruijn_graph::conj_graph_pack &gp, const char *) {
 
     // Has to be separate stream for not counting it in coverage
     io::ReadStreamList<io::SingleRead> trusted_contigs;
-    if (cfg::get().use_additional_contigs) {
+    if (cfg::get().use_additional_contigs && !additional_contigs_.empty()) {
+        DEBUG(additional_contigs_.size() << " contigs from previous K will be used from memory");
+        trusted_contigs.push_back(io::RCWrap<io::SingleRead>(
+                std::make_shared<io::VectorReadStream<io::SingleRead>>(additional_contigs_)));
+        std::vector<io::SingleRead>().swap(additional_contigs_);
+    } else if (cfg::get().use_additional_contigs) {
         DEBUG("Contigs from previous K will be used: " << cfg::get().additional_contigs);
         trusted_contigs.push_back(io::EasyStream(cfg::get().additional_contigs, true));
     }
@@ -189,12 +195,23 @@ public:
         VERIFY_MSG(read_streams.size(), "No input streams specified");
 
         unsigned nthreads = (unsigned)read_streams.size();
+        if (storage().params.super_kmer_splitting) {
+            utils::DeBruijnReadSuperKMerSplitter<io::SingleReadSeq,
+                                                 utils::StoringTypeFilter<storing_type>>
+                    splitter(storage().workdir, index.k() + 1, 0,
+                             read_streams, (contigs_stream == 0) ? 0 : &(*contigs_stream),
+                             buffer_size);
+            storage().counter.reset(new utils::KMerDiskCounter<RtSeq>(storage().workdir, splitter));
+            storage().counter->CountAll(nthreads, nthreads, /* merge */false);
+            return;
+        }
+
         utils::DeBruijnReadKMerSplitter<io::SingleReadSeq,
                                         utils::StoringTypeFilter<storing_type>>
                 splitter(storage().workdir, index.k() + 1, 0,
                          read_streams, (contigs_stream == 0) ? 0 : &(*contigs_stream),
                          buffer_size);
-        storage().counter.reset(new utils::KMerDiskCounter<RtSeq>(storage().workdir, splitter));
+        storage().counter.reset(new utils::KMerInMemoryCounter<RtSeq>(storage().workdir, splitter));
         storage().counter->CountAll(nthreads, nthreads, /* merge */false);
     }
 
@@ -541,8 +558,9 @@ public:
 
 };
 
-Construction::Construction()
-        : spades::CompositeStageDeferred<ConstructionStorage>("de Bruijn graph construction", "construction") {
+Construction::Construction(std::vector<io::SingleRead> additional_contigs)
+        : spades::CompositeStageDeferred<ConstructionStorage>("de Bruijn graph construction", "construction"),
+          additional_contigs_(std::move(additional_contigs)) {
     if (cfg::get().con.read_cov_threshold)
         add<CoverageFilter>();
 
@@ -8,6 +8,9 @@
 #pragma once
 
 #include "pipeline/stage.hpp"
+#include "io/reads/single_read.hpp"
+
+#include <vector>
 
 namespace debruijn_graph {
 
@@ -15,11 +18,15 @@ struct ConstructionStorage;
 
 class Construction : public spades::CompositeStageDeferred<ConstructionStorage> {
 public:
-    Construction();
+    // Contigs from previous K are taken from memory instead of the file if given
+    Construction(std::vector<io::SingleRead> additional_contigs = {});
     ~Construction();
 
     void init(debruijn_graph::conj_graph_pack &gp, const char *) override;
     void fini(debruijn_graph::conj_graph_pack &gp) override;
+
+private:
+    std::vector<io::SingleRead> additional_contigs_;
 };
 
 }
@@ -39,15 +39,13 @@ public:
     }
 
 
-    template<class Index>
-    void FillExtensionsFromIndex(const std::string &KPlusOneMersFilename,
-                                 Index &index) const {
+    template<class KMerStorage, class Index>
+    void FillExtensionsFromKPOMers(const KMerStorage &kpomers,
+                                   Index &index) const {
         unsigned KPlusOne = index.k() + 1;
 
-        typename Index::kmer_iterator it(KPlusOneMersFilename,
-                                         RtSeq::GetDataSize(KPlusOne));
-        for (; it.good(); ++it) {
-            RtSeq kpomer(KPlusOne, *it);
+        for (size_t i = 0; i < kpomers.size(); ++i) {
+            RtSeq kpomer(KPlusOne, &kpomers[i]);
 
             char pnucl = kpomer[0], nnucl = kpomer[KPlusOne - 1];
             TRACE("processing k+1-mer " << kpomer);
@@ -71,7 +69,7 @@ public:
         DeBruijnReadKMerSplitter<typename Streams::ReadT, KmerFilter >
                 splitter(workdir, index.k() + 1, 0xDEADBEEF, streams,
                          contigs_stream, read_buffer_size);
-        KMerDiskCounter<RtSeq> counter(workdir, splitter);
+        KMerInMemoryCounter<RtSeq> counter(workdir, splitter);
         counter.CountAll(nthreads, nthreads, /* merge */ false);
 
         BuildExtensionIndexFromKPOMers(workdir, index, counter,
@@ -84,22 +82,32 @@ public:
                                         Index &index, Counter &counter,
                                         unsigned nthreads, size_t read_buffer_size = 0) const {
         VERIFY(counter.k() == index.k() + 1);
+        using KmerFilter = StoringTypeFilter<typename Index::storing_type>;
+        bool add_rc = Index::storing_type::IsInvertable();
 
         // Now, count unique k-mers from k+1-mers
-        DeBruijnKMerKMerSplitter<StoringTypeFilter<typename Index::storing_type> >
-                splitter(workdir, index.k(),
-                         index.k() + 1, Index::storing_type::IsInvertable(), read_buffer_size);
-        for (unsigned i = 0; i < counter.num_buckets(); ++i)
-            splitter.AddKMers(counter.GetMergedKMersFname(i));
-        KMerDiskCounter<RtSeq> counter2(workdir, splitter);
-
-        BuildIndex(index, counter2, 16, nthreads);
+        size_t needed = DeBruijnKMerKMerCounter<KmerFilter>::memory_needed(counter, add_rc);
+        if (needed < utils::get_free_memory() / 4) {
+            DeBruijnKMerKMerCounter<KmerFilter> counter2(workdir, index.k(), counter, add_rc);
+            BuildIndex(index, counter2, 16, nthreads);
+        } else {
+            INFO("Not enough memory to derive k-mers from k+1-mers in memory, approx. "
+                 << needed / 1024 / 1024 << " MB needed. Splitting k+1-mers.");
+            DeBruijnKMerKMerSplitter<KmerFilter>
+                    splitter(workdir, index.k(),
+                             index.k() + 1, add_rc, read_buffer_size);
+            for (unsigned i = 0; i < counter.num_buckets(); ++i)
+                splitter.AddKMers(counter.GetBucket(i, /* unlink */ false));
+            KMerInMemoryCounter<RtSeq> counter2(workdir, splitter);
+
+            BuildIndex(index, counter2, 16, nthreads);
+        }
 
         // Build the kmer extensions
         INFO("Building k-mer extensions from k+1-mers");
 #       pragma omp parallel for num_threads(nthreads)
-        for (unsigned i = 0; i < nthreads; ++i)
-            FillExtensionsFromIndex(counter.GetMergedKMersFname(i), index);
+        for (unsigned i = 0; i < counter.num_buckets(); ++i)
+            FillExtensionsFromKPOMers(*counter.GetBucket(i, /* unlink */ false), index);
         INFO("Building k-mer extensions from k+1-mers finished.");
     }
 
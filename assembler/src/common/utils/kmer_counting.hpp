@@ -6,6 +6,10 @@
 #include "ph_map/storing_traits.hpp"
 #include "common/utils/parallel/openmp_wrapper.h"
 
+#include <algorithm>
+#include <array>
+#include <vector>
+
 namespace utils {
 
 typedef qf::cqf CQFKmerFilter;
@@ -40,6 +44,37 @@ public:
 
 };
 
+// Orders the records by the highest bits of their CQF hashes, i.e. by the
+// quotients, so the filter is walked sequentially when the records are
+// processed in this order. Sorting by the highest bits only is enough for that
+// and takes just two passes of LSD radix sort. The sort is stable.
+template<class T, class HashF>
+void SortByQuotient(std::vector<T> &records, std::vector<T> &tmp,
+                    unsigned hash_bits, HashF hash) {
+    static constexpr unsigned kDigitBits = 11;
+    static constexpr size_t kBuckets = size_t(1) << kDigitBits;
+    unsigned shift = hash_bits > 2 * kDigitBits ? hash_bits - 2 * kDigitBits : 0;
+
+    tmp.resize(records.size());
+    for (unsigned pass = 0; pass < 2; ++pass, shift += kDigitBits) {
+        std::array<size_t, kBuckets> offsets;
+        offsets.fill(0);
+        for (const auto &r : records)
+            offsets[(hash(r) >> shift) & (kBuckets - 1)] += 1;
+
+        size_t sum = 0;
+        for (auto &offset : offsets) {
+            size_t cnt = offset;
+            offset = sum;
+            sum += cnt;
+        }
+
+        for (const auto &r : records)
+            tmp[offsets[(hash(r) >> shift) & (kBuckets - 1)]++] = r;
+        records.swap(tmp);
+    }
+}
+
 class HllProcessor {
     hll::hll<> &hll_;
 public:
@@ -79,33 +114,63 @@ size_t FillFromStream(ReadStream &stream, const SeqHasher &hasher,
     return reads;
 }
 
+// The k-mer hashes are buffered and inserted in the order of their CQF
+// quotients, so the filter is walked sequentially, and the adjacent occurrences
+// of the same k-mer are inserted at once. Flush() should be called to insert
+// the rest.
 class CQFProcessor {
+    // The larger the buffer is compared to the filter, the more sequential
+    // the inserts are
+    static const size_t kBufferSize = 1 << 20;
+
     CQFKmerFilter &cqf_;
     CQFKmerFilter &local_cqf_;
     const unsigned thr_;
-public:
-    CQFProcessor(CQFKmerFilter &cqf,
-                 CQFKmerFilter &local_cqf,
-                 unsigned thr) :
-            cqf_(cqf), local_cqf_(local_cqf), thr_(thr) {
-    }
+    std::vector<uint64_t> hashes_, tmp_;
 
-    void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
+    void Insert(uint64_t hash, size_t count) {
         // First try and insert in the main QF. If lock can't be
         // acquired in the first attempt then insert the item in the
         // local QF.
-        if (cqf_.lookup(hash, /* lock */ true) >= thr_)
+        size_t mlt = cqf_.lookup(hash, /* lock */ true);
+        if (mlt >= thr_)
             return;
 
-        if (!cqf_.add(hash, /* count */ 1,
+        // No need to count beyond the threshold
+        count = std::min<size_t>(count, thr_ - mlt);
+        if (!cqf_.add(hash, count,
                 /* lock */ true, /* spin */ false)) {
-            local_cqf_.add(hash, /* count */ 1,
+            local_cqf_.add(hash, count,
                     /* lock */ false, /* spin */ false);
             if (local_cqf_.insertions() > local_cqf_.slots() / 2)
                 cqf_.merge(local_cqf_);
         }
     }
 
+public:
+    CQFProcessor(CQFKmerFilter &cqf,
+                 CQFKmerFilter &local_cqf,
+                 unsigned thr) :
+            cqf_(cqf), local_cqf_(local_cqf), thr_(thr) {
+        hashes_.reserve(kBufferSize);
+    }
+
+    void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
+        hashes_.push_back(hash & cqf_.range_mask());
+        if (hashes_.size() == kBufferSize)
+            Flush();
+    }
+
+    void Flush() {
+        SortByQuotient(hashes_, tmp_, cqf_.hash_bits(),
+                       [](uint64_t hash) { return hash; });
+        for (auto it = hashes_.begin(); it != hashes_.end(); ) {
+            auto next = std::find_if(it, hashes_.end(), [=](uint64_t hash) { return hash != *it; });
+            Insert(*it, next - it);
+            it = next;
+        }
+        hashes_.clear();
+    }
 };
 
 template<class ReadStream, class Hasher, class KMerFilter = utils::StoringTypeFilter<utils::SimpleStoring>>
@@ -156,14 +221,19 @@ void FillCoverageHistogram(qf::cqf &cqf, unsigned k, const Hasher &hasher, ReadS
     for (unsigned i = 0; i < stream_num; ++i)
         local_cqfs.emplace_back(1 << 16, cqf.hash_bits());
 
+    std::vector<CQFProcessor> processors;
+    processors.reserve(stream_num);
+    for (unsigned i = 0; i < stream_num; ++i)
+        processors.emplace_back(cqf, local_cqfs[i], thr);
+
     INFO("Counting threshold " << thr);
     streams.reset();
     size_t reads = 0, n = 15;
     while (!streams.eof()) {
         #pragma omp parallel for reduction(+:reads)
         for (unsigned i = 0; i < stream_num; ++i) {
-            CQFProcessor processor(cqf, local_cqfs[i], thr);
-            reads += FillFromStream(streams[i], hasher, processor, k, 1000000, filter);
+            reads += FillFromStream(streams[i], hasher, processors[i], k, 1000000, filter);
+            processors[i].Flush();
         }
 
         if (reads >> n) {
@@ -0,0 +1,108 @@
+#pragma once
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "utils/logger/logger.hpp"
+
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace utils {
+
+// Append-only writer for the raw k-mer bucket. Sorted runs go to the data
+// file, run lengths go to the index file (data file name + ".idx"), the index
+// file is created only if there is at least one sorted run. Each bucket
+// is written by a single thread at a time, so no locking is required.
+// Persistent writers keep both files open until close(), otherwise files are
+// reopened for every run (useful when the limit for open files is too low).
+class KMerBucketWriter {
+public:
+    KMerBucketWriter(const std::string &filename, bool persistent = true)
+            : filename_(filename), persistent_(persistent),
+              data_fd_(-1), idx_fd_(-1), runs_(0), bytes_(0) {}
+
+    KMerBucketWriter(const KMerBucketWriter &) = delete;
+
+    ~KMerBucketWriter() {
+        close();
+    }
+
+    void WriteRun(const void *data, size_t el_data_size, size_t cnt) {
+        if (data_fd_ == -1)
+            data_fd_ = Open(filename_);
+        if (idx_fd_ == -1)
+            idx_fd_ = Open(filename_ + ".idx");
+
+        WriteAll(data_fd_, data, el_data_size * cnt);
+        WriteAll(idx_fd_, &cnt, sizeof(cnt));
+        runs_ += 1;
+        bytes_ += el_data_size * cnt;
+
+        if (!persistent_)
+            close();
+    }
+
+    // Appends raw data without any index entry (for unsorted buckets)
+    void Append(const void *data, size_t amount) {
+        if (data_fd_ == -1)
+            data_fd_ = Open(filename_);
+
+        WriteAll(data_fd_, data, amount);
+        bytes_ += amount;
+
+        if (!persistent_)
+            close();
+    }
+
+    void close() {
+        if (data_fd_ != -1)
+            ::close(data_fd_);
+        if (idx_fd_ != -1)
+            ::close(idx_fd_);
+        data_fd_ = idx_fd_ = -1;
+    }
+
+    const std::string &filename() const { return filename_; }
+    size_t runs() const { return runs_; }
+    size_t bytes() const { return bytes_; }
+
+private:
+    std::string filename_;
+    bool persistent_;
+    int data_fd_, idx_fd_;
+    size_t runs_, bytes_;
+
+    static int Open(const std::string &fname) {
+        int fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_APPEND, (mode_t) 0660);
+        if (fd == -1)
+            FATAL_ERROR("Cannot open temporary file " << fname << " for writing. Reason: " << strerror(errno));
+        return fd;
+    }
+
+    static void WriteAll(int fd, const void *buf, size_t amount) {
+        const char *cbuf = (const char*)buf;
+        while (amount) {
+            ssize_t res = ::write(fd, cbuf, amount);
+            if (res == -1 && errno == EINTR)
+                continue;
+            if (res <= 0)
+                FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+            cbuf += res;
+            amount -= res;
+        }
+    }
+
+    DECL_LOGGER("K-mer Splitting");
+};
+
+}
@@ -12,8 +12,12 @@
 #include <city/city.h>
 
 #include <vector>
+#include <memory>
 #include <cmath>
 
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace utils {
 
 template<class Index>
@@ -29,6 +33,9 @@ public:
   typedef typename traits::KMerRawReference KMerRawReference;
   typedef size_t IdxType;
 
+  // Number of the lookups in flight for the batched seq_idx()
+  static const size_t LookupBatch = 16;
+
 private:
   struct hash_function128 {
     std::pair<uint64_t, uint64_t> operator()(const KMerSeq &k) const{
@@ -41,8 +48,13 @@ private:
   typedef KMerIndex __self;
   typedef boomphf::mphf<hash_function128> KMerDataIndex;
 
+  // Header of the mmap-able index layout. Legacy layout starts with the number
+  // of buckets, which could never match the magic.
+  static const uint64_t MappedMagic = 0x5844494d4b525053ULL; // "SPRKMIDX"
+  static const uint64_t MappedVersion = 1;
+
 public:
-  KMerIndex(): index_(NULL), num_buckets_(0), size_(0) {}
+  KMerIndex(): index_(NULL), num_buckets_(0), bucket_starts_ptr_(NULL), size_(0) {}
 
   KMerIndex(const KMerIndex&) = delete;
   KMerIndex& operator=(const KMerIndex&) = delete;
@@ -52,11 +64,15 @@ public:
   void clear() {
     num_buckets_ = 0;
     bucket_starts_.clear();
+    bucket_starts_ptr_ = NULL;
 
     delete[] index_;
     index_ = NULL;
+    mapping_.reset();
   }
 
+  bool mapped() const { return (bool)mapping_; }
+
   size_t mem_size() {
     size_t sz = 0;
     for (size_t i = 0; i < num_buckets_; ++i)
@@ -68,6 +84,8 @@ public:
   void count_size() {
       if (index_ == NULL)
           return;
+      if (!bucket_starts_.empty())
+          bucket_starts_ptr_ = bucket_starts_.data();
       size_ = 0;
       for (size_t i = 0; i < num_buckets_; i++)
         size_ += index_[i].size();
@@ -80,35 +98,132 @@ public:
   size_t seq_idx(const KMerSeq &s) const {
     size_t bucket = seq_bucket(s);
 
-    return bucket_starts_[bucket] + index_[bucket].lookup(s);
+    return bucket_starts_ptr_[bucket] + index_[bucket].lookup(s);
   }
 
   size_t raw_seq_idx(const KMerRawReference data) const {
     size_t bucket = raw_seq_bucket(data);
 
-    return bucket_starts_[bucket] + index_[bucket].lookup(data);
+    return bucket_starts_ptr_[bucket] + index_[bucket].lookup(data);
+  }
+
+  // Same as seq_idx() for every k-mer of the batch. The lookups are resolved
+  // interleaved, so the cache misses of the different k-mers overlap.
+  void seq_idx(const KMerSeq *seqs, size_t n, size_t *res) const {
+    typename KMerDataIndex::lookup_state states[LookupBatch];
+    size_t buckets[LookupBatch];
+
+    for (size_t start = 0; start < n; start += LookupBatch) {
+      size_t cnt = (n - start < LookupBatch ? n - start : LookupBatch);
+      for (size_t i = 0; i < cnt; ++i) {
+        buckets[i] = seq_bucket(seqs[start + i]);
+        index_[buckets[i]].lookup_start(seqs[start + i], states[i]);
+      }
+
+      // Every round tests one more level of the lookups still in progress
+      for (bool done = false; !done; ) {
+        done = true;
+        for (size_t i = 0; i < cnt; ++i)
+          done &= index_[buckets[i]].lookup_step(states[i]);
+      }
+
+      for (size_t i = 0; i < cnt; ++i)
+        res[start + i] = bucket_starts_ptr_[buckets[i]] + index_[buckets[i]].lookup_finish(states[i]);
+    }
   }
 
+  // The index is written in the layout which could be mapped into memory and
+  // used in-place: the header is followed by the page-aligned block with the
+  // bucket starts and all the bucket mphfs (all the fields are 64-bit words).
   template<class Writer>
   void serialize(Writer &os) const {
+    uint64_t magic = MappedMagic, version = MappedVersion;
+    os.write((char*)&magic, sizeof(magic));
+    os.write((char*)&version, sizeof(version));
     os.write((char*)&num_buckets_, sizeof(num_buckets_));
+
+    // Block size is not known in advance, it will be patched at the end
+    size_t szpos = os.tellp(), sz = 0;
+    os.write((char*)&sz, sizeof(sz));
+
+    // Make sure data is aligned to the page boundary
+    unsigned PageSize = getpagesize();
+    size_t cpos = os.tellp();
+    size_t pos = (cpos + PageSize - 1 + sizeof(size_t)) / PageSize * PageSize;
+    size_t off = pos - os.tellp();
+    os.write((char*)&off, sizeof(off));
+    os.seekp(pos);
+
+    if (bucket_starts_ptr_) {
+      os.write((char*)&bucket_starts_ptr_[0], (num_buckets_ + 1) * sizeof(bucket_starts_ptr_[0]));
+    } else {
+      size_t start = 0;
+      os.write((char*)&start, sizeof(start));
+    }
     for (size_t i = 0; i < num_buckets_; ++i)
-      index_[i].save(os);
-    os.write((char*)&bucket_starts_[0], (num_buckets_ + 1) * sizeof(bucket_starts_[0]));
+      index_[i].save_mapped(os);
+
+    size_t end = os.tellp();
+    sz = end - pos;
+    os.seekp(szpos);
+    os.write((char*)&sz, sizeof(sz));
+    os.seekp(end);
   }
 
+  // Reads the index. The mmap-able layout is copied into the anonymous
+  // memory, use deserialize(is, FileName) to map the file itself.
   template<class Reader>
   void deserialize(Reader &is) {
+    deserialize(is, "");
+  }
+
+  // Attaches to the index stored in the given file (the reader should be
+  // positioned at the beginning of index data). Index pages are loaded lazily
+  // on first access, nothing is copied.
+  template<class Reader>
+  void deserialize(Reader &is, const std::string &FileName) {
     clear();
 
+    uint64_t magic;
+    is.read((char*)&magic, sizeof(magic));
+    if (magic != MappedMagic) {
+      num_buckets_ = magic;
+      deserialize_legacy(is);
+      return;
+    }
+
+    uint64_t version;
+    is.read((char*)&version, sizeof(version));
+    VERIFY_MSG(version == MappedVersion, "Unsupported k-mer index version " << version);
+
+    size_t sz, off;
     is.read((char*)&num_buckets_, sizeof(num_buckets_));
+    is.read((char*)&sz, sizeof(sz));
+    is.read((char*)&off, sizeof(off));
+    off -= sizeof(off);
+    off += is.tellg();
+
+    if (FileName.size()) {
+      mapping_.reset(new MMappedReader(FileName, /* unlink */ false, -1ULL, off, sz));
+    } else {
+      void *region = mmap(NULL, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (region == MAP_FAILED)
+        FATAL_ERROR("mmap(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+      is.seekg(off);
+      is.read((char*)region, sz);
+      mapping_.reset(new MMappedReader(region, sz, /* owned */ true));
+    }
+    is.seekg(off + sz);
+
+    const uint64_t *data = (const uint64_t*)mapping_->data();
+    bucket_starts_ptr_ = (const size_t*)data;
+    data += num_buckets_ + 1;
 
     index_ = new KMerDataIndex[num_buckets_];
     for (size_t i = 0; i < num_buckets_; ++i)
-      index_[i].load(is);
+      data = index_[i].map(data);
+    VERIFY((const uint8_t*)data == (const uint8_t*)mapping_->data() + sz);
 
-    bucket_starts_.resize(num_buckets_ + 1);
-    is.read((char*)&bucket_starts_[0], (num_buckets_ + 1) * sizeof(bucket_starts_[0]));
     count_size();
   }
 
@@ -117,6 +232,8 @@ public:
     std::swap(num_buckets_, other.num_buckets_);
     std::swap(size_, other.size_);
     std::swap(bucket_starts_, other.bucket_starts_);
+    std::swap(bucket_starts_ptr_, other.bucket_starts_ptr_);
+    std::swap(mapping_, other.mapping_);
   }
 
  private:
@@ -124,7 +241,21 @@ public:
 
   size_t num_buckets_;
   std::vector<size_t> bucket_starts_;
+  // Points either to bucket_starts_ or to the mapped index
+  const size_t *bucket_starts_ptr_;
   size_t size_;
+  std::unique_ptr<MMappedReader> mapping_;
+
+  template<class Reader>
+  void deserialize_legacy(Reader &is) {
+    index_ = new KMerDataIndex[num_buckets_];
+    for (size_t i = 0; i < num_buckets_; ++i)
+      index_[i].load(is);
+
+    bucket_starts_.resize(num_buckets_ + 1);
+    is.read((char*)&bucket_starts_[0], (num_buckets_ + 1) * sizeof(bucket_starts_[0]));
+    count_size();
+  }
 
   size_t seq_bucket(const KMerSeq &s) const {
     return hash_function()(s) % num_buckets_;
@@ -43,6 +43,7 @@
 #include <cmath>
 
 #include "kmer_splitters.hpp"
+#include "kmer_bucket_writer.hpp"
 
 namespace utils {
 
@@ -58,6 +59,7 @@ public:
   KMerCounter()
       : kmers_(0), counted_(false) {}
 
+  virtual unsigned k() const = 0;
   virtual size_t kmer_size() const = 0;
 
   virtual size_t Count(unsigned num_buckets, unsigned num_threads) = 0;
@@ -98,7 +100,7 @@ public:
 
   ~KMerDiskCounter() {}
 
-  unsigned k() const { return k_; }
+  unsigned k() const override { return k_; }
 
   size_t kmer_size() const override {
     return Seq::GetDataSize(k_) * sizeof(typename Seq::DataType);
@@ -110,40 +112,13 @@ public:
   }
 
   size_t Count(unsigned num_buckets, unsigned num_threads) override {
-    this->num_buckets_ = num_buckets;
     unsigned num_files = num_buckets * num_threads;
 
     // Split k-mers into buckets.
     INFO("Splitting kmer instances into " << num_files << " files using " << num_threads << " threads. This might take a while.");
     auto raw_kmers = splitter_.Split(num_files, num_threads);
 
-    INFO("Starting k-mer counting.");
-    size_t kmers = 0;
-#   pragma omp parallel for shared(raw_kmers) num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
-    for (unsigned i = 0; i < raw_kmers.size(); ++i) {
-      kmers += MergeKMers(*raw_kmers[i], GetUniqueKMersFname(i));
-      raw_kmers[i].reset();
-    }
-    INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
-    if (!kmers) {
-      FATAL_ERROR("No kmers were extracted from reads. Check the read lengths and k-mer length settings");
-      exit(-1);
-    }
-
-    INFO("Merging temporary buckets.");
-    for (unsigned i = 0; i < num_buckets; ++i) {
-      std::string ofname = GetMergedKMersFname(i);
-      std::ofstream ofs(ofname.c_str(), std::ios::out | std::ios::binary);
-      for (unsigned j = 0; j < num_threads; ++j) {
-        BucketStorage ins(GetUniqueKMersFname(i + j * num_buckets), Seq::GetDataSize(k_), /* unlink */ true);
-        ofs.write((const char*)ins.data(), ins.data_size());
-      }
-    }
-
-    this->kmers_ = kmers;
-    this->counted_ = true;
-
-    return kmers;
+    return CountRaw(raw_kmers, num_buckets, num_threads);
   }
 
   void MergeBuckets() override {
@@ -175,10 +150,59 @@ public:
     return final_kmers_;
   }
 
-private:
+protected:
   fs::TmpDir work_dir_;
   fs::TmpFile kmer_prefix_;
   fs::TmpFile final_kmers_;
+
+  // Counts the k-mers from the set of raw k-mer files produced by splitter
+  size_t CountRaw(typename KMerSplitter<Seq>::RawKMers &raw_kmers,
+                  unsigned num_buckets, unsigned num_threads) {
+    this->num_buckets_ = num_buckets;
+
+    INFO("Starting k-mer counting.");
+    size_t kmers = 0;
+    if (splitter_.super_kmers()) {
+      // Unique k-mers are appended to the final buckets by every thread
+      for (unsigned i = 0; i < num_buckets * num_threads; ++i) {
+        std::ofstream ofs(GetUniqueKMersFname(i), std::ios::out | std::ios::binary);
+      }
+
+#     pragma omp parallel for shared(raw_kmers) num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
+      for (unsigned i = 0; i < raw_kmers.size(); ++i) {
+        kmers += MergeSuperKMers(*raw_kmers[i], num_buckets);
+        raw_kmers[i].reset();
+      }
+    } else {
+#     pragma omp parallel for shared(raw_kmers) num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
+      for (unsigned i = 0; i < raw_kmers.size(); ++i) {
+        kmers += MergeKMers(*raw_kmers[i], GetUniqueKMersFname(i));
+        raw_kmers[i].reset();
+      }
+    }
+    INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
+    if (!kmers) {
+      FATAL_ERROR("No kmers were extracted from reads. Check the read lengths and k-mer length settings");
+      exit(-1);
+    }
+
+    INFO("Merging temporary buckets.");
+    for (unsigned i = 0; i < num_buckets; ++i) {
+      std::string ofname = GetMergedKMersFname(i);
+      std::ofstream ofs(ofname.c_str(), std::ios::out | std::ios::binary);
+      for (unsigned j = 0; j < num_threads; ++j) {
+        BucketStorage ins(GetUniqueKMersFname(i + j * num_buckets), Seq::GetDataSize(k_), /* unlink */ true);
+        ofs.write((const char*)ins.data(), ins.data_size());
+      }
+    }
+
+    this->kmers_ = kmers;
+    this->counted_ = true;
+
+    return kmers;
+  }
+
+private:
   KMerSplitter<Seq> &splitter_;
   unsigned k_;
 
@@ -186,6 +210,60 @@ private:
     return kmer_prefix_->file() + ".unique." + std::to_string(suffix);
   }
 
+  // Super-k-mers from single raw file are expanded into k-mers which are
+  // deduplicated here. Since every k-mer occurs in a single raw file only,
+  // unique k-mers could be routed directly to the final buckets. If the file
+  // is expanded in several chunks, the chunks are written as sorted runs and
+  // merged the same way as the runs of the sorting splitter.
+  size_t MergeSuperKMers(const std::string &ifname, unsigned num_buckets) {
+    std::string runs_fname = ifname + ".runs";
+    KMerBucketWriter runs(runs_fname);
+    size_t cnt = 0;
+    splitter_.ExpandSuperKMers(ifname, [&](adt::KMerVector<Seq> &kmers, bool last) {
+      libcxx::sort(kmers.begin(), kmers.end(), typename adt::KMerVector<Seq>::less2_fast());
+      auto it = std::unique(kmers.begin(), kmers.end(), typename adt::KMerVector<Seq>::equal_to());
+      if (last && !runs.runs())
+        cnt = RouteUniqueKMers(kmers.begin(), it, num_buckets);
+      else
+        runs.WriteRun(kmers.data(), kmers.el_data_size(), it - kmers.begin());
+    });
+
+    if (runs.runs()) {
+      runs.close();
+      std::string merged_fname = ifname + ".merged";
+      MergeKMers(runs_fname, merged_fname);
+      MMappedRecordArrayReader<typename Seq::DataType> ins(merged_fname, Seq::GetDataSize(k_), /* unlink */ true);
+      cnt = RouteUniqueKMers(ins.begin(), ins.end(), num_buckets);
+    }
+
+    return cnt;
+  }
+
+  template<class It>
+  size_t RouteUniqueKMers(It begin, It end, unsigned num_buckets) {
+    const size_t BUFFER_SIZE = 1 << 16;
+
+    unsigned thread_id = omp_get_thread_num();
+    std::vector<adt::KMerVector<Seq>> buckets(num_buckets, adt::KMerVector<Seq>(k_));
+    auto flush = [&](unsigned i) {
+      KMerBucketWriter(GetUniqueKMersFname(i + thread_id * num_buckets), /* persistent */ false)
+          .Append(buckets[i].data(), buckets[i].size() * buckets[i].el_data_size());
+      buckets[i].clear();
+    };
+
+    size_t cnt = 0;
+    for (auto it = begin; it != end; ++it, ++cnt) {
+      unsigned i = splitter_.GetFileNumForRaw((*it).data(), num_buckets);
+      buckets[i].push_back((*it).data());
+      if (buckets[i].size() >= BUFFER_SIZE)
+        flush(i);
+    }
+    for (unsigned i = 0; i < num_buckets; ++i)
+      flush(i);
+
+    return cnt;
+  }
+
   size_t MergeKMers(const std::string &ifname, const std::string &ofname) {
     MMappedRecordArrayReader<typename Seq::DataType> ins(ifname, Seq::GetDataSize(k_), /* unlink */ true);
 
@@ -273,6 +351,365 @@ private:
   }
 };
 
+// Counter which keeps sorted runs and the resulting buckets in memory, avoiding
+// all the temporary files. Falls back to the disk-based counting if the runs
+// do not fit into the memory budget during splitting.
+template<class Seq, class traits = kmer_index_traits<Seq> >
+class KMerInMemoryCounter : public KMerDiskCounter<Seq, traits> {
+  typedef KMerDiskCounter<Seq, traits> __super;
+  typedef typename traits::RawKMerStorage BucketStorage;
+  typedef typename Seq::DataType DataType;
+
+  struct MemoryBucket {
+    DataType *data;
+    size_t size;
+  };
+
+public:
+  KMerInMemoryCounter(fs::TmpDir work_dir,
+                      KMerSortingSplitter<Seq> &splitter,
+                      size_t memory_budget = 0)
+      : __super(work_dir, splitter), splitter_(splitter),
+        memory_budget_(memory_budget), in_memory_(false) {}
+
+  KMerInMemoryCounter(const std::string &work_dir,
+                      KMerSortingSplitter<Seq> &splitter,
+                      size_t memory_budget = 0)
+      : KMerInMemoryCounter(fs::tmp::make_temp_dir(work_dir, "kmer_counter"), splitter, memory_budget) {}
+
+  ~KMerInMemoryCounter() {
+    ReleaseBuckets();
+  }
+
+  size_t Count(unsigned num_buckets, unsigned num_threads) override {
+    unsigned num_files = num_buckets * num_threads;
+    ReleaseBuckets();
+
+    // Sorted runs, merged buckets and splitting buffers should all fit
+    size_t budget = memory_budget_ ? memory_budget_ : utils::get_free_memory() / 4;
+    splitter_.set_memory_budget(budget);
+
+    INFO("Splitting kmer instances into " << num_files << " buckets using " << num_threads << " threads. This might take a while.");
+    auto raw_kmers = splitter_.Split(num_files, num_threads);
+    in_memory_ = splitter_.in_memory();
+    if (!in_memory_) {
+      INFO("Falling back to disk-based k-mer counting.");
+      return this->CountRaw(raw_kmers, num_buckets, num_threads);
+    }
+    raw_kmers.clear();
+
+    this->num_buckets_ = num_buckets;
+    buckets_.resize(num_buckets, MemoryBucket{nullptr, 0});
+
+    INFO("Starting in-memory k-mer counting.");
+    size_t kmers = 0;
+#   pragma omp parallel for num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
+    for (unsigned i = 0; i < num_buckets; ++i) {
+      std::vector<typename KMerSortingSplitter<Seq>::KMerRuns*> runs;
+      for (unsigned j = 0; j < num_threads; ++j)
+        runs.push_back(&splitter_.runs(i + j * num_buckets));
+      kmers += MergeRuns(runs, buckets_[i]);
+    }
+    splitter_.ReleaseRuns();
+
+    INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
+    if (!kmers) {
+      FATAL_ERROR("No kmers were extracted from reads. Check the read lengths and k-mer length settings");
+      exit(-1);
+    }
+
+    this->kmers_ = kmers;
+    this->counted_ = true;
+
+    return kmers;
+  }
+
+  std::unique_ptr<BucketStorage> GetBucket(size_t idx, bool unlink = true) override {
+    if (!in_memory_)
+      return __super::GetBucket(idx, unlink);
+
+    VERIFY_MSG(this->counted_, "k-mers were not counted yet");
+    MemoryBucket &bucket = buckets_[idx];
+    VERIFY_MSG(bucket.data || !bucket.size, "bucket was already released");
+
+    // "Unlinking" the bucket transfers the ownership over the memory to the caller
+    std::unique_ptr<BucketStorage> res(new BucketStorage(bucket.data, Seq::GetDataSize(this->k()),
+                                                         bucket.size, unlink));
+    if (unlink)
+      bucket = MemoryBucket{nullptr, 0};
+
+    return res;
+  }
+
+  void MergeBuckets() override {
+    if (!in_memory_) {
+      __super::MergeBuckets();
+      return;
+    }
+
+    INFO("Merging final buckets.");
+
+    this->final_kmers_ = this->work_dir_->tmp_file("final_kmers");
+    std::ofstream ofs(*this->final_kmers_, std::ios::out | std::ios::binary);
+    for (unsigned j = 0; j < this->num_buckets_; ++j) {
+      auto bucket = GetBucket(j, /* unlink */ true);
+      ofs.write((const char*)bucket->data(), bucket->data_size());
+    }
+    ofs.close();
+  }
+
+  bool in_memory() const { return in_memory_; }
+
+private:
+  KMerSortingSplitter<Seq> &splitter_;
+  size_t memory_budget_;
+  bool in_memory_;
+  std::vector<MemoryBucket> buckets_;
+
+  void ReleaseBuckets() {
+    for (auto &bucket : buckets_) {
+      if (bucket.data)
+        munmap(bucket.data, bucket.size);
+    }
+    buckets_.clear();
+  }
+
+  size_t MergeRuns(const std::vector<typename KMerSortingSplitter<Seq>::KMerRuns*> &runs,
+                   MemoryBucket &out) {
+    typedef typename KMerSortingSplitter<Seq>::SeqKMerVector::iterator run_iterator;
+    size_t el_sz = Seq::GetDataSize(this->k());
+
+    std::vector<adt::iterator_range<run_iterator>> ranges;
+    size_t total = 0;
+    for (auto *entry : runs) {
+      for (auto &run : *entry) {
+        if (!run.size())
+          continue;
+        ranges.push_back(adt::make_range(run.begin(), run.end()));
+        total += run.size();
+      }
+    }
+
+    out = MemoryBucket{nullptr, 0};
+    if (!total)
+      return 0;
+
+    // Bucket lives in anonymous mapping, so it could be handed out as usual k-mer storage
+    size_t page_size = getpagesize();
+    size_t mapped_size = round_up(total * el_sz * sizeof(DataType), page_size);
+    void *region = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (region == MAP_FAILED)
+      FATAL_ERROR("mmap(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+
+    adt::array_vector<DataType> merged((DataType*)region, total, el_sz);
+    adt::loser_tree<run_iterator, adt::array_less<DataType>> tree(ranges);
+    tree.multi_merge(merged.begin());
+    auto it = std::unique(merged.begin(), merged.end(), adt::array_equal_to<DataType>());
+    size_t cnt = it - merged.begin();
+
+    // Release the memory occupied by runs as early as possible
+    for (auto *entry : runs)
+      entry->clear();
+
+    // Give the unused tail back
+    size_t used_size = round_up(cnt * el_sz * sizeof(DataType), page_size);
+    if (used_size < mapped_size)
+      munmap((uint8_t*)region + used_size, mapped_size - used_size);
+
+    out = MemoryBucket{(DataType*)region, cnt * el_sz * sizeof(DataType)};
+    return cnt;
+  }
+};
+
+// Counter of the k-mers of the k+1-mers counted by another counter. The k-mers
+// are derived from the k+1-mer buckets and routed to their own buckets right in
+// memory, so neither the temporary k-mer files nor the second splitting round
+// are needed. The buckets are the same as the ones DeBruijnKMerKMerSplitter
+// would produce.
+template<class KmerFilter>
+class DeBruijnKMerKMerCounter : public KMerCounter<RtSeq> {
+  typedef KMerCounter<RtSeq> __super;
+  typedef typename __super::RawKMerStorage BucketStorage;
+  typedef typename __super::ResultFile ResultFile;
+  typedef RtSeq::DataType DataType;
+
+  struct MemoryBucket {
+    DataType *data;
+    size_t size;
+  };
+
+public:
+  DeBruijnKMerKMerCounter(fs::TmpDir work_dir, unsigned K,
+                          KMerCounter<RtSeq> &kpomers, bool add_rc,
+                          KmerFilter kmer_filter = KmerFilter())
+      : work_dir_(work_dir), k_(K), kpomers_(kpomers),
+        add_rc_(add_rc), kmer_filter_(kmer_filter) {
+    VERIFY(kpomers_.k() == k_ + 1);
+  }
+
+  ~DeBruijnKMerKMerCounter() {
+    ReleaseBuckets();
+  }
+
+  // Upper bound of the memory needed to count the k-mers
+  static size_t memory_needed(const KMerCounter<RtSeq> &kpomers, bool add_rc) {
+    // Every k+1-mer gives two k-mers per strand, the filter keeps a single
+    // strand of k-mers if both strands are added
+    return 2 * kpomers.kmers() * RtSeq::GetDataSize(kpomers.k() - 1) * sizeof(DataType) * (add_rc ? 2 : 1);
+  }
+
+  unsigned k() const override { return k_; }
+
+  size_t kmer_size() const override {
+    return RtSeq::GetDataSize(k_) * sizeof(DataType);
+  }
+
+  size_t Count(unsigned num_buckets, unsigned num_threads) override {
+    ReleaseBuckets();
+    this->num_buckets_ = num_buckets;
+
+    INFO("Deriving k-mers from " << kpomers_.kmers() << " k+1-mers");
+    std::vector<std::vector<adt::KMerVector<RtSeq>>> cells(num_threads);
+    for (auto &entry : cells)
+      entry.resize(num_buckets, adt::KMerVector<RtSeq>(k_));
+
+#   pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (unsigned i = 0; i < kpomers_.num_buckets(); ++i) {
+      auto bucket = kpomers_.GetBucket(i, /* unlink */ false);
+      auto &out = cells[omp_get_thread_num()];
+      for (size_t j = 0; j < bucket->size(); ++j) {
+        RtSeq kpomer(k_ + 1, &(*bucket)[j]);
+        RouteKMers(kpomer, out);
+        if (add_rc_)
+          RouteKMers(!kpomer, out);
+      }
+    }
+
+    buckets_.resize(num_buckets, MemoryBucket{nullptr, 0});
+    size_t kmers = 0;
+#   pragma omp parallel for num_threads(num_threads) schedule(dynamic) reduction(+:kmers)
+    for (unsigned i = 0; i < num_buckets; ++i) {
+      std::vector<adt::KMerVector<RtSeq>*> parts;
+      for (auto &entry : cells)
+        parts.push_back(&entry[i]);
+      kmers += MergeCells(parts, buckets_[i]);
+    }
+
+    INFO("K-mer counting done. There are " << kmers << " kmers in total. ");
+    this->kmers_ = kmers;
+    this->counted_ = true;
+
+    return kmers;
+  }
+
+  size_t CountAll(unsigned num_buckets, unsigned num_threads, bool merge = true) override {
+    size_t kmers = Count(num_buckets, num_threads);
+    if (merge)
+      MergeBuckets();
+
+    return kmers;
+  }
+
+  std::unique_ptr<BucketStorage> GetBucket(size_t idx, bool unlink = true) override {
+    VERIFY_MSG(this->counted_, "k-mers were not counted yet");
+    MemoryBucket &bucket = buckets_[idx];
+    VERIFY_MSG(bucket.data || !bucket.size, "bucket was already released");
+
+    std::unique_ptr<BucketStorage> res(new BucketStorage(bucket.data, RtSeq::GetDataSize(k_),
+                                                         bucket.size, unlink));
+    if (unlink)
+      bucket = MemoryBucket{nullptr, 0};
+
+    return res;
+  }
+
+  void MergeBuckets() override {
+    INFO("Merging final buckets.");
+
+    final_kmers_ = work_dir_->tmp_file("final_kmers");
+    std::ofstream ofs(*final_kmers_, std::ios::out | std::ios::binary);
+    for (unsigned j = 0; j < this->num_buckets_; ++j) {
+      auto bucket = GetBucket(j, /* unlink */ true);
+      ofs.write((const char*)bucket->data(), bucket->data_size());
+    }
+    ofs.close();
+  }
+
+  ResultFile final_kmers_file() {
+    VERIFY_MSG(this->final_kmers_, "k-mers were not counted yet");
+    return final_kmers_;
+  }
+
+private:
+  fs::TmpDir work_dir_;
+  fs::TmpFile final_kmers_;
+  unsigned k_;
+  KMerCounter<RtSeq> &kpomers_;
+  bool add_rc_;
+  KmerFilter kmer_filter_;
+  std::vector<MemoryBucket> buckets_;
+
+  // Same k-mers and buckets as DeBruijnKMerSplitter::FillBufferFromSequence gives
+  void RouteKMers(const RtSeq &seq, std::vector<adt::KMerVector<RtSeq>> &out) const {
+    RtSeq kmer = seq.start(k_) >> 'A';
+    for (size_t j = k_ - 1; j < seq.size(); ++j) {
+      kmer <<= seq[j];
+      if (!kmer_filter_.filter(kmer))
+        continue;
+
+      out[RtSeq::hash()(kmer) % out.size()].push_back(kmer);
+    }
+  }
+
+  void ReleaseBuckets() {
+    for (auto &bucket : buckets_) {
+      if (bucket.data)
+        munmap(bucket.data, bucket.size);
+    }
+    buckets_.clear();
+  }
+
+  size_t MergeCells(const std::vector<adt::KMerVector<RtSeq>*> &cells, MemoryBucket &out) {
+    size_t el_sz = RtSeq::GetDataSize(k_);
+
+    size_t total = 0;
+    for (auto *cell : cells)
+      total += cell->size();
+
+    out = MemoryBucket{nullptr, 0};
+    if (!total)
+      return 0;
+
+    // Bucket lives in anonymous mapping, so it could be handed out as usual k-mer storage
+    size_t page_size = getpagesize();
+    size_t mapped_size = round_up(total * el_sz * sizeof(DataType), page_size);
+    void *region = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (region == MAP_FAILED)
+      FATAL_ERROR("mmap(2) failed. Reason: " << strerror(errno) << ". Error code: " << errno);
+
+    DataType *pos = (DataType*)region;
+    for (auto *cell : cells) {
+      memcpy(pos, cell->data(), cell->size() * cell->el_data_size());
+      pos += cell->size() * el_sz;
+      cell->clear();
+      cell->shrink_to_fit();
+    }
+
+    adt::array_vector<DataType> merged((DataType*)region, total, el_sz);
+    libcxx::sort(merged.begin(), merged.end(), adt::array_less<DataType>());
+    auto it = std::unique(merged.begin(), merged.end(), adt::array_equal_to<DataType>());
+    size_t cnt = it - merged.begin();
+
+    // Give the unused tail back
+    size_t used_size = round_up(cnt * el_sz * sizeof(DataType), page_size);
+    if (used_size < mapped_size)
+      munmap((uint8_t*)region + used_size, mapped_size - used_size);
+
+    out = MemoryBucket{(DataType*)region, cnt * el_sz * sizeof(DataType)};
+    return cnt;
+  }
+};
+
 template<class Index>
 class KMerIndexBuilder {
   typedef typename Index::KMerSeq Seq;
@@ -7,14 +7,22 @@
 
 #pragma once
 
+#include "kmer_bucket_writer.hpp"
+
 #include "adt/kmer_vector.hpp"
 #include "io/reads/io_helper.hpp"
 #include "utils/filesystem/file_limit.hpp"
 #include "utils/filesystem/temporary.hpp"
 #include "utils/memory_limit.hpp"
+#include "utils/perf/hot_counters.hpp"
 
 #include <libcxx/sort.hpp>
 
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
 namespace utils {
 
 template<class Seq>
@@ -33,12 +41,31 @@ public:
 
     virtual RawKMers Split(size_t num_files, unsigned nthreads) = 0;
 
+    // Splitter might emit super-k-mers (runs of consecutive k-mers) into the raw
+    // files instead of separate k-mers. Such files are expanded back to k-mers
+    // right before counting. Expansion goes by bounded chunks, op is called for
+    // every chunk with the flag set for the last one.
+    virtual bool super_kmers() const { return false; }
+
+    virtual void ExpandSuperKMers(const std::string &/*raw_file*/,
+                                  const std::function<void(adt::KMerVector<Seq>&, bool)> &/*op*/) const {
+        VERIFY_MSG(false, "Splitter does not produce super-k-mers");
+    }
+
     size_t kmer_size() const {
         return Seq::GetDataSize(K_) * sizeof(typename Seq::DataType);
     }
 
     unsigned K() const { return K_; }
 
+    unsigned GetFileNumForSeq(const Seq &s, unsigned total) const {
+        return (unsigned)(hash_(s, seed_) % total);
+    }
+
+    unsigned GetFileNumForRaw(const typename Seq::DataType *data, unsigned total) const {
+        return (unsigned)(hash_function()(data, Seq::GetDataSize(K_), seed_) % total);
+    }
+
 protected:
     fs::TmpDir work_dir_;
     hash_function hash_;
@@ -52,23 +79,67 @@ template<class Seq>
 class KMerSortingSplitter : public KMerSplitter<Seq> {
 public:
     using typename KMerSplitter<Seq>::RawKMers;
+    using SeqKMerVector = adt::KMerVector<Seq>;
+    using KMerRuns = std::vector<SeqKMerVector>;
 
     KMerSortingSplitter(const std::string &work_dir, unsigned K, uint32_t seed = 0)
-            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0) {}
+            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0), num_threads_(0),
+              dump_pending_(false), dump_stop_(false), in_memory_(false), memory_budget_(0), runs_size_(0) {}
 
     KMerSortingSplitter(fs::TmpDir work_dir, unsigned K, uint32_t seed = 0)
-            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0) {}
+            : KMerSplitter<Seq>(work_dir, K, seed), cell_size_(0), num_files_(0), num_threads_(0),
+              dump_pending_(false), dump_stop_(false), in_memory_(false), memory_budget_(0), runs_size_(0) {}
+
+    ~KMerSortingSplitter() {
+        StopDumper();
+    }
+
+    // Keep sorted runs in memory instead of appending them to raw files while
+    // they fit into the budget. Once the budget is exceeded, all the runs
+    // collected so far are spilled to disk and splitting proceeds as usual.
+    void set_memory_budget(size_t budget) {
+        memory_budget_ = budget;
+        in_memory_ = (budget > 0);
+    }
+
+    // True iff the last split fitted into memory budget
+    bool in_memory() const { return in_memory_; }
+
+    KMerRuns &runs(size_t idx) { return runs_[idx]; }
+
+    void ReleaseRuns() {
+        std::vector<KMerRuns>().swap(runs_);
+        runs_size_ = 0;
+    }
 
 protected:
-    using SeqKMerVector = adt::KMerVector<Seq>;
     using KMerBuffer = std::vector<SeqKMerVector>;
 
-    std::vector<KMerBuffer> kmer_buffers_;
+    // Buffers are double-buffered: while one set is being sorted and dumped in
+    // background, the other one is filled by the reading threads.
+    std::vector<KMerBuffer> kmer_buffers_, dump_buffers_;
     size_t cell_size_;
     size_t num_files_;
+    unsigned num_threads_;
+
+    std::vector<std::unique_ptr<KMerBucketWriter>> writers_;
+
+    // The dump thread lives for the whole split, so that its OpenMP team is
+    // created once and not for every dump
+    std::thread dumper_;
+    std::mutex dump_mutex_;
+    std::condition_variable dump_cv_;
+    bool dump_pending_, dump_stop_;
+
+    bool in_memory_;
+    size_t memory_budget_;
+    std::vector<KMerRuns> runs_;
+    size_t runs_size_;
 
     RawKMers PrepareBuffers(size_t num_files, unsigned nthreads, size_t reads_buffer_size) {
+        StopDumper();
         num_files_ = num_files;
+        num_threads_ = nthreads;
 
         // Determine the set of output files
         RawKMers out;
@@ -76,12 +147,16 @@ protected:
         for (unsigned i = 0; i < num_files_; ++i)
             out.emplace_back(tmp_prefix->CreateDep(std::to_string(i)));
 
-        size_t file_limit = num_files_ + 2*nthreads;
+        // Every bucket keeps both data and index files open during the split
+        size_t file_limit = 2*num_files_ + 2*nthreads + 64;
         size_t res = limit_file(file_limit);
-        if (res < file_limit) {
-            WARN("Failed to setup necessary limit for number of open files. The process might crash later on.");
-            WARN("Do 'ulimit -n " << file_limit << "' in the console to overcome the limit");
-        }
+        bool persistent = (res >= file_limit);
+        if (!persistent)
+            WARN("Failed to setup necessary limit for number of open files. Temporary files will be reopened on every write");
+
+        writers_.clear();
+        for (unsigned i = 0; i < num_files_; ++i)
+            writers_.emplace_back(new KMerBucketWriter(out[i]->file(), persistent));
 
         if (reads_buffer_size == 0) {
             reads_buffer_size = 536870912ull;
@@ -89,18 +164,30 @@ protected:
             INFO("Memory available for splitting buffers: " << (double)mem_limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
             reads_buffer_size = std::min(reads_buffer_size, mem_limit);
         }
-        cell_size_ = reads_buffer_size / (num_files_ * this->kmer_size());
+        // Split the memory between two buffer sets
+        cell_size_ = reads_buffer_size / (2 * num_files_ * this->kmer_size());
         // Set sane minimum cell size
         if (cell_size_ < 16384)
             cell_size_ = 16384;
 
         INFO("Using cell size of " << cell_size_);
-        kmer_buffers_.resize(nthreads);
-        for (unsigned i = 0; i < nthreads; ++i) {
-            KMerBuffer &entry = kmer_buffers_[i];
-            entry.resize(num_files_, adt::KMerVector<Seq>(this->K_, (size_t) (1.1 * (double) cell_size_)));
+        for (auto *buffers : { &kmer_buffers_, &dump_buffers_ }) {
+            buffers->resize(nthreads);
+            for (unsigned i = 0; i < nthreads; ++i) {
+                KMerBuffer &entry = (*buffers)[i];
+                entry.resize(num_files_, adt::KMerVector<Seq>(this->K_, (size_t) (1.1 * (double) cell_size_)));
+            }
         }
 
+        ReleaseRuns();
+        if (in_memory_) {
+            INFO("Keeping sorted runs in memory, budget: " << (double)memory_budget_ / 1024.0 / 1024.0 / 1024.0 << " Gb");
+            runs_.resize(num_files_);
+        }
+
+        dump_stop_ = false;
+        dumper_ = std::thread([this] { DumpLoop(); });
+
         return out;
     }
 
@@ -112,65 +199,126 @@ protected:
         return entry[idx].size() > cell_size_;
     }
 
-    void DumpBuffers(const RawKMers &ostreams) {
-        VERIFY(ostreams.size() == num_files_ && kmer_buffers_[0].size() == num_files_);
+    // Dumps run alongside the reading threads, so they get half of the threads
+    unsigned dump_threads() const {
+        return std::max(1u, num_threads_ / 2);
+    }
+
+    void SpillRuns() {
+        INFO("Sorted runs do not fit into memory budget, spilling them to disk");
+#   pragma omp parallel for num_threads(dump_threads())
+        for (unsigned k = 0; k < num_files_; ++k) {
+            // Make sure that the file is created even for an empty bucket
+            if (runs_[k].empty())
+                writers_[k]->WriteRun(nullptr, 0, 0);
+            for (auto &run : runs_[k])
+                writers_[k]->WriteRun(run.data(), run.el_data_size(), run.size());
+        }
+
+        ReleaseRuns();
+        in_memory_ = false;
+    }
 
-#   pragma omp parallel for
+    void SortAndDump(std::vector<KMerBuffer> &buffers) {
+        size_t runs_size = 0;
+#   pragma omp parallel for num_threads(dump_threads()) reduction(+ : runs_size)
         for (unsigned k = 0; k < num_files_; ++k) {
             // Below k is thread id!
 
             size_t sz = 0;
-            for (size_t i = 0; i < kmer_buffers_.size(); ++i)
-                sz += kmer_buffers_[i][k].size();
+            for (size_t i = 0; i < buffers.size(); ++i)
+                sz += buffers[i][k].size();
 
             adt::KMerVector<Seq> SortBuffer(this->K_, sz);
-            for (auto & entry : kmer_buffers_) {
+            for (auto & entry : buffers) {
                 const auto &buffer = entry[k];
                 for (size_t j = 0; j < buffer.size(); ++j)
                     SortBuffer.push_back(buffer[j]);
             }
             libcxx::sort(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::less2_fast());
             auto it = std::unique(SortBuffer.begin(), SortBuffer.end(), typename adt::KMerVector<Seq>::equal_to());
-
-#     pragma omp critical
-            {
-                size_t cnt =  it - SortBuffer.begin();
-
-                // Write k-mers
-                FILE *f = fopen(ostreams[k]->file().c_str(), "ab");
-                if (!f)
-                    FATAL_ERROR("Cannot open temporary file " << ostreams[k]->file() << " for writing");
-                size_t res = fwrite(SortBuffer.data(), SortBuffer.el_data_size(), cnt, f);
-                if (res != cnt)
-                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-                fclose(f);
-
-                // Write index
-                f = fopen((ostreams[k]->file() + ".idx").c_str(), "ab");
-                if (!f)
-                    FATAL_ERROR("Cannot open temporary file " << ostreams[k]->file() << " for writing");
-                res = fwrite(&cnt, sizeof(cnt), 1, f);
-                if (res != 1)
-                    FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
-                fclose(f);
+            size_t cnt =  it - SortBuffer.begin();
+
+            // Each bucket is touched by a single thread, no locking is necessary
+            if (in_memory_) {
+                if (!cnt)
+                    continue;
+
+                SortBuffer.resize(cnt);
+                SortBuffer.shrink_to_fit();
+                runs_size += cnt * SortBuffer.el_data_size();
+                runs_[k].push_back(std::move(SortBuffer));
+                continue;
             }
+
+            writers_[k]->WriteRun(SortBuffer.data(), SortBuffer.el_data_size(), cnt);
         }
 
-        for (auto & entry : kmer_buffers_)
+        for (auto & entry : buffers)
             for (auto & eentry : entry)
                 eentry.clear();
+
+        runs_size_ += runs_size;
+        if (in_memory_ && runs_size_ > memory_budget_)
+            SpillRuns();
     }
 
-    void ClearBuffers() {
-        for (auto & entry : kmer_buffers_)
-            for (auto & eentry : entry) {
-                eentry.clear();
-                eentry.shrink_to_fit();
-            }
+    void DumpLoop() {
+        std::unique_lock<std::mutex> lock(dump_mutex_);
+        while (true) {
+            dump_cv_.wait(lock, [this] { return dump_pending_ || dump_stop_; });
+            if (!dump_pending_)
+                return;
+
+            lock.unlock();
+            SortAndDump(dump_buffers_);
+            lock.lock();
+            dump_pending_ = false;
+            dump_cv_.notify_all();
+        }
     }
 
-    unsigned GetFileNumForSeq(const Seq &s, unsigned total) const {
-        return (unsigned)(this->hash_(s, this->seed_) % total);
+    void WaitForDump() {
+        std::unique_lock<std::mutex> lock(dump_mutex_);
+        dump_cv_.wait(lock, [this] { return !dump_pending_; });
+    }
+
+    void StopDumper() {
+        if (!dumper_.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(dump_mutex_);
+            dump_stop_ = true;
+        }
+        dump_cv_.notify_all();
+        dumper_.join();
+    }
+
+    // Sorting and writing is performed by the dump thread, so reading threads
+    // could refill the buffers in the meantime. Only one dump is in flight at a time.
+    void DumpBuffers(const RawKMers &ostreams) {
+        VERIFY(ostreams.size() == num_files_ && kmer_buffers_[0].size() == num_files_);
+
+        WaitForDump();
+        std::swap(kmer_buffers_, dump_buffers_);
+        {
+            std::lock_guard<std::mutex> lock(dump_mutex_);
+            dump_pending_ = true;
+        }
+        dump_cv_.notify_all();
+    }
+
+    void ClearBuffers() {
+        StopDumper();
+        writers_.clear();
+
+        for (auto *buffers : { &kmer_buffers_, &dump_buffers_ })
+            for (auto & entry : *buffers)
+                for (auto & eentry : entry) {
+                    eentry.clear();
+                    eentry.shrink_to_fit();
+                }
     }
 
 };
@@ -256,17 +404,20 @@ template<class Read, class KmerFilter> template<class ReadStream>
 size_t
 DeBruijnReadKMerSplitter<Read, KmerFilter>::FillBufferFromStream(ReadStream &stream,
                                                                  unsigned thread_id) {
+  PERF_SCOPED_TIMER("kmer_splitter.fill_buffer");
   typename ReadStream::ReadT r;
   size_t reads = 0;
 
   while (!stream.eof()) {
     stream >> r;
     reads += 1;
+    PERF_HISTOGRAM("kmer_splitter.read_length", r.sequence().size());
 
     if (this->FillBufferFromSequence(r.sequence(), thread_id))
       break;
   }
 
+  PERF_COUNT("kmer_splitter.reads", reads);
   return reads;
 }
 
@@ -312,13 +463,13 @@ DeBruijnReadKMerSplitter<Read, KmerFilter>::Split(size_t num_files, unsigned nth
 
 template<class KmerFilter>
 class DeBruijnKMerKMerSplitter : public DeBruijnKMerSplitter<KmerFilter> {
-  typedef MMappedFileRecordArrayIterator<RtSeq::DataType> kmer_iterator;
+  typedef MMappedRecordArrayReader<RtSeq::DataType> KMerStorage;
 
   unsigned K_source_;
-  std::vector<std::string> kmers_;
+  std::vector<std::unique_ptr<KMerStorage>> kmers_;
   bool add_rc_;
 
-  size_t FillBufferFromKMers(kmer_iterator &kmer,
+  size_t FillBufferFromKMers(const KMerStorage &kmers, size_t &pos,
                              unsigned thread_id);
 
  public:
@@ -330,19 +481,25 @@ class DeBruijnKMerKMerSplitter : public DeBruijnKMerSplitter<KmerFilter> {
         K_source_(K_source), add_rc_(add_rc) {}
 
   void AddKMers(const std::string &file) {
-    kmers_.push_back(file);
+    kmers_.emplace_back(new KMerStorage(file, RtSeq::GetDataSize(K_source_), /* unlink */ false));
+  }
+
+  void AddKMers(std::unique_ptr<KMerStorage> kmers) {
+    VERIFY(kmers->elcnt() == RtSeq::GetDataSize(K_source_));
+    kmers_.push_back(std::move(kmers));
   }
 
   RawKMers Split(size_t num_files, unsigned nthreads) override;
 };
 
 template<class KmerFilter>
-inline size_t DeBruijnKMerKMerSplitter<KmerFilter>::FillBufferFromKMers(kmer_iterator &kmer,
+inline size_t DeBruijnKMerKMerSplitter<KmerFilter>::FillBufferFromKMers(const KMerStorage &kmers, size_t &pos,
                                                                         unsigned thread_id) {
   size_t seqs = 0;
-  for (; kmer.good(); ++kmer) {
-    RtSeq nucls(K_source_, *kmer);
+  while (pos < kmers.size()) {
+    RtSeq nucls(K_source_, &kmers[pos]);
     seqs += 1;
+    pos += 1;
 
     bool stop = this->FillBufferFromSequence(nucls, thread_id);
     if (add_rc_)
@@ -363,16 +520,18 @@ DeBruijnKMerKMerSplitter<KmerFilter>::Split(size_t num_files, unsigned nthreads)
   auto out = this->PrepareBuffers(num_files, nthreads, this->read_buffer_size_);
 
   size_t counter = 0, n = 10;
-  std::vector<kmer_iterator> its;
-  its.reserve(nit);
-  for (auto it = kmers_.begin(), et = kmers_.end(); it != et; ++it)
-    its.emplace_back(*it, RtSeq::GetDataSize(K_source_));
+  std::vector<size_t> pos(nit, 0);
+  auto unprocessed = [&]() {
+    for (unsigned i = 0; i < nit; ++i)
+      if (pos[i] < kmers_[i]->size())
+        return true;
+    return false;
+  };
 
-  while (std::any_of(its.begin(), its.end(),
-                     [](const kmer_iterator &it) { return it.good(); })) {
+  while (unprocessed()) {
 #   pragma omp parallel for num_threads(nthreads) reduction(+ : counter)
     for (unsigned i = 0; i < nit; ++i)
-      counter += FillBufferFromKMers(its[i], i);
+      counter += FillBufferFromKMers(*kmers_[i], pos[i], i);
 
     this->DumpBuffers(out);
 
@@ -0,0 +1,305 @@
+//***************************************************************************
+//* Copyright (c) 2018 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include "kmer_splitters.hpp"
+#include "kmer_bucket_writer.hpp"
+
+#include "io/kmers/mmapped_reader.hpp"
+#include "sequence/sequence.hpp"
+#include "sequence/rtseq.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+namespace utils {
+
+// Splits reads into super-k-mers: maximal runs of consecutive k-mers sharing
+// the same minimizer. Super-k-mers are routed to the raw files by minimizer,
+// so all the copies of the same k-mer end up in the same file. Each super-k-mer
+// is stored as 16-bit length (in nucleotides) followed by 2-bit packed
+// nucleotides. K-mers are extracted (and filtered) only during counting.
+template<class KmerFilter>
+class SuperKMerSplitter : public KMerSplitter<RtSeq> {
+    typedef std::vector<uint8_t> SuperKMerBuffer;
+
+    // Limit the length of super-k-mer record, so the length fits into 16 bits
+    static const size_t MAX_SUPER_KMER_KMERS = 1024;
+
+public:
+    using typename KMerSplitter<RtSeq>::RawKMers;
+
+    SuperKMerSplitter(fs::TmpDir work_dir, unsigned K, KmerFilter kmer_filter,
+                      size_t read_buffer_size = 0, uint32_t seed = 0,
+                      unsigned minimizer_size = 15)
+            : KMerSplitter<RtSeq>(work_dir, K, seed), kmer_filter_(kmer_filter),
+              read_buffer_size_(read_buffer_size), m_(std::min(K, minimizer_size)),
+              minimizer_seed_((uint64_t(seed) + 1) * 0x9E3779B97F4A7C15ULL),
+              cell_size_(0), expand_kmers_(0), num_files_(0) {
+        VERIFY(m_ > 0 && m_ <= 32);
+    }
+
+    bool super_kmers() const override { return true; }
+
+    // Chunks are limited by the same per-thread memory as the splitting buffers
+    void ExpandSuperKMers(const std::string &raw_file,
+                          const std::function<void(adt::KMerVector<RtSeq>&, bool)> &op) const override {
+        MMappedReader ins(raw_file, /* unlink */ true, -1ULL);
+
+        const uint8_t *data = (const uint8_t*)ins.data();
+        const uint8_t *end = data + ins.size();
+        adt::KMerVector<RtSeq> kmers(this->K_);
+        RtSeq kmer(this->K_);
+        while (data < end) {
+            uint16_t len;
+            memcpy(&len, data, sizeof(len));
+            data += sizeof(len);
+
+            for (size_t i = 0; i < len; ++i) {
+                kmer <<= (char)((data[i / 4] >> (2 * (i % 4))) & 3);
+                if (i + 1 < this->K_ || !kmer_filter_.filter(kmer))
+                    continue;
+
+                kmers.push_back(kmer);
+                if (kmers.size() >= expand_kmers_) {
+                    op(kmers, false);
+                    kmers.clear();
+                }
+            }
+            data += (len + 3) / 4;
+        }
+
+        op(kmers, true);
+    }
+
+protected:
+    KmerFilter kmer_filter_;
+    size_t read_buffer_size_;
+
+    RawKMers PrepareBuffers(size_t num_files, unsigned nthreads) {
+        num_files_ = num_files;
+
+        RawKMers out;
+        auto tmp_prefix = this->work_dir_->tmp_file("super_kmers_raw");
+        for (unsigned i = 0; i < num_files_; ++i)
+            out.emplace_back(tmp_prefix->CreateDep(std::to_string(i)));
+
+        size_t file_limit = num_files_ + 2*nthreads + 64;
+        size_t res = limit_file(file_limit);
+        bool persistent = (res >= file_limit);
+        if (!persistent)
+            WARN("Failed to setup necessary limit for number of open files. Temporary files will be reopened on every write");
+
+        writers_.clear();
+        for (unsigned i = 0; i < num_files_; ++i)
+            writers_.emplace_back(new KMerBucketWriter(out[i]->file(), persistent));
+
+        size_t reads_buffer_size = read_buffer_size_;
+        if (reads_buffer_size == 0) {
+            reads_buffer_size = 536870912ull;
+            size_t mem_limit =  (size_t)((double)(utils::get_free_memory()) / (nthreads * 3));
+            INFO("Memory available for splitting buffers: " << (double)mem_limit / 1024.0 / 1024.0 / 1024.0 << " Gb");
+            reads_buffer_size = std::min(reads_buffer_size, mem_limit);
+        }
+        cell_size_ = std::max(reads_buffer_size / num_files_, size_t(16384));
+        expand_kmers_ = std::max(reads_buffer_size / this->kmer_size(), size_t(1));
+        INFO("Using cell size of " << cell_size_ << " bytes, minimizer size " << m_);
+
+        buffers_.resize(nthreads);
+        for (auto &entry : buffers_) {
+            entry.resize(num_files_);
+            for (auto &buffer : entry)
+                buffer.reserve(cell_size_ + cell_size_ / 8);
+        }
+        minimizers_.resize(nthreads);
+
+        return out;
+    }
+
+    void DumpBuffers() {
+#       pragma omp parallel for
+        for (unsigned k = 0; k < num_files_; ++k) {
+            // Each file is written by a single thread only
+            for (auto &entry : buffers_) {
+                writers_[k]->Append(entry[k].data(), entry[k].size());
+                entry[k].clear();
+            }
+        }
+    }
+
+    void ClearBuffers() {
+        // Make sure all the files exist, even empty ones
+        for (auto &writer : writers_)
+            writer->Append(nullptr, 0);
+        writers_.clear();
+
+        std::vector<std::vector<SuperKMerBuffer>>().swap(buffers_);
+        std::vector<std::vector<uint64_t>>().swap(minimizers_);
+    }
+
+    // Minimizers are compared via invertible hash of m-mer, so ordering is
+    // total and bucket assignment depends only on k-mer itself. The m-mer is
+    // scrambled by the seed first, otherwise the all-A m-mer would hash to zero
+    // and always win, piling the low-complexity super-k-mers into one file.
+    uint64_t MinimizerKey(uint64_t mmer) const {
+        mmer ^= minimizer_seed_;
+        mmer ^= mmer >> 33;
+        mmer *= 0xff51afd7ed558ccdULL;
+        mmer ^= mmer >> 33;
+        mmer *= 0xc4ceb9fe1a85ec53ULL;
+        mmer ^= mmer >> 33;
+        return mmer;
+    }
+
+    template<class S>
+    bool FillBufferFromSequence(const S &seq, unsigned thread_id) {
+        size_t K = this->K_;
+        if (seq.size() < K)
+            return false;
+
+        // Compute the keys of all the m-mers first
+        std::vector<uint64_t> &keys = minimizers_[thread_id];
+        keys.resize(seq.size() - m_ + 1);
+        uint64_t mask = (m_ == 32 ? -1ULL : (1ULL << (2 * m_)) - 1), mmer = 0;
+        for (size_t i = 0; i < seq.size(); ++i) {
+            mmer = ((mmer << 2) | (uint64_t)seq[i]) & mask;
+            if (i + 1 >= m_)
+                keys[i + 1 - m_] = MinimizerKey(mmer);
+        }
+
+        // Slide the window of (K - m + 1) m-mers over the keys
+        size_t w = K - m_ + 1, nkmers = seq.size() - K + 1;
+        size_t min_pos = 0, start = 0;
+        for (size_t i = 1; i < w; ++i)
+            if (keys[i] < keys[min_pos])
+                min_pos = i;
+
+        bool stop = false;
+        uint64_t cur_key = keys[min_pos];
+        for (size_t j = 1; j < nkmers; ++j) {
+            if (min_pos < j) {
+                min_pos = j;
+                for (size_t i = j + 1; i < j + w; ++i)
+                    if (keys[i] < keys[min_pos])
+                        min_pos = i;
+            } else if (keys[j + w - 1] < keys[min_pos])
+                min_pos = j + w - 1;
+
+            if (keys[min_pos] == cur_key && j - start < MAX_SUPER_KMER_KMERS)
+                continue;
+
+            stop |= PushSuperKMer(seq, start, j - start, cur_key, thread_id);
+            start = j;
+            cur_key = keys[min_pos];
+        }
+        stop |= PushSuperKMer(seq, start, nkmers - start, cur_key, thread_id);
+
+        return stop;
+    }
+
+private:
+    unsigned m_;
+    uint64_t minimizer_seed_;
+    size_t cell_size_;
+    size_t expand_kmers_;
+    size_t num_files_;
+    std::vector<std::vector<SuperKMerBuffer>> buffers_;
+    std::vector<std::vector<uint64_t>> minimizers_;
+    std::vector<std::unique_ptr<KMerBucketWriter>> writers_;
+
+    template<class S>
+    bool PushSuperKMer(const S &seq, size_t start, size_t kmers,
+                       uint64_t key, unsigned thread_id) {
+        SuperKMerBuffer &buffer = buffers_[thread_id][key % num_files_];
+
+        uint16_t len = (uint16_t)(kmers + this->K_ - 1);
+        size_t pos = buffer.size();
+        buffer.resize(pos + sizeof(len) + (len + 3) / 4, 0);
+        memcpy(&buffer[pos], &len, sizeof(len));
+
+        uint8_t *data = &buffer[pos + sizeof(len)];
+        for (size_t i = 0; i < len; ++i)
+            data[i / 4] |= (uint8_t)(seq[start + i] << (2 * (i % 4)));
+
+        return buffer.size() > cell_size_;
+    }
+};
+
+template<class Read, class KmerFilter>
+class DeBruijnReadSuperKMerSplitter : public SuperKMerSplitter<KmerFilter> {
+    io::ReadStreamList<Read> &streams_;
+    io::SingleStream *contigs_;
+
+    template<class ReadStream>
+    size_t FillBufferFromStream(ReadStream& stream, unsigned thread_id) {
+        typename ReadStream::ReadT r;
+        size_t reads = 0;
+
+        while (!stream.eof()) {
+            stream >> r;
+            reads += 1;
+
+            if (this->FillBufferFromSequence(r.sequence(), thread_id))
+                break;
+        }
+
+        return reads;
+    }
+
+public:
+    using typename SuperKMerSplitter<KmerFilter>::RawKMers;
+
+    DeBruijnReadSuperKMerSplitter(fs::TmpDir work_dir,
+                                  unsigned K, uint32_t seed,
+                                  io::ReadStreamList<Read>& streams,
+                                  io::SingleStream* contigs_stream = 0,
+                                  size_t read_buffer_size = 0,
+                                  KmerFilter filter = KmerFilter())
+            : SuperKMerSplitter<KmerFilter>(work_dir, K, filter, read_buffer_size, seed),
+              streams_(streams), contigs_(contigs_stream) {}
+
+    RawKMers Split(size_t num_files, unsigned nthreads) override {
+        auto out = this->PrepareBuffers(num_files, nthreads);
+
+        size_t counter = 0, n = 15;
+        streams_.reset();
+        while (!streams_.eof()) {
+#           pragma omp parallel for num_threads(nthreads) reduction(+ : counter)
+            for (unsigned i = 0; i < (unsigned)streams_.size(); ++i) {
+                counter += FillBufferFromStream(streams_[i], i);
+            }
+
+            this->DumpBuffers();
+
+            if (counter >> n) {
+                INFO("Processed " << counter << " reads");
+                n += 1;
+            }
+        }
+
+        if (contigs_) {
+            INFO("Adding contigs from previous K");
+            unsigned cnt = 0;
+            contigs_->reset();
+            while (!contigs_->eof()) {
+                FillBufferFromStream(*contigs_, cnt);
+                this->DumpBuffers();
+                if (++cnt >= nthreads)
+                    cnt = 0;
+            }
+        }
+
+        this->ClearBuffers();
+
+        INFO("Used " << counter << " reads");
+
+        return out;
+    }
+};
+
+}
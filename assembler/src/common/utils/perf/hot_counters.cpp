@@ -0,0 +1,124 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "hot_counters.hpp"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace utils {
+namespace perf {
+
+Counter::Counter(const std::string &name, counter_kind kind)
+        : name_(name), kind_(kind), slots_(MAX_THREADS),
+          buckets_(kind == counter_kind::histogram ? MAX_THREADS * BUCKETS : 0) {}
+
+counter_value Counter::collect() const {
+    counter_value res = { name_, kind_, 0, 0, {} };
+    for (const Slot &slot : slots_) {
+        res.count += slot.count.load(std::memory_order_relaxed);
+        res.total += slot.total.load(std::memory_order_relaxed);
+    }
+
+    if (kind_ == counter_kind::timer)
+        res.total = uint64_t((double) res.total * tick_duration());
+
+    if (kind_ == counter_kind::histogram) {
+        res.buckets.resize(BUCKETS, 0);
+        for (size_t i = 0; i < buckets_.size(); ++i)
+            res.buckets[i % BUCKETS] += buckets_[i].load(std::memory_order_relaxed);
+        while (!res.buckets.empty() && res.buckets.back() == 0)
+            res.buckets.pop_back();
+    }
+
+    return res;
+}
+
+void Counter::reset() {
+    for (Slot &slot : slots_) {
+        slot.count.store(0, std::memory_order_relaxed);
+        slot.total.store(0, std::memory_order_relaxed);
+    }
+    for (auto &bucket : buckets_)
+        bucket.store(0, std::memory_order_relaxed);
+}
+
+namespace {
+
+class Registry {
+public:
+    static Registry &get() {
+        static Registry registry;
+        return registry;
+    }
+
+    Counter &counter(const std::string &name, counter_kind kind) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto &entry = counters_[name];
+        if (!entry)
+            entry.reset(new Counter(name, kind));
+        return *entry;
+    }
+
+    std::vector<counter_value> collect() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<counter_value> res;
+        for (const auto &entry : counters_) {
+            counter_value value = entry.second->collect();
+            if (value.count)
+                res.push_back(std::move(value));
+        }
+        return res;
+    }
+
+    void reset() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &entry : counters_)
+            entry.second->reset();
+    }
+
+    double tick_duration() const {
+        auto now = std::chrono::steady_clock::now();
+        uint64_t now_ticks = ticks();
+        double elapsed = (double) std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_).count();
+        if (now_ticks <= start_ticks_ || elapsed <= 0)
+            return 1.;
+        return elapsed / (double) (now_ticks - start_ticks_);
+    }
+
+private:
+    Registry()
+            : start_(std::chrono::steady_clock::now()), start_ticks_(ticks()) {}
+
+    std::mutex mutex_;
+    // Call sites of the same name share the counter
+    std::map<std::string, std::unique_ptr<Counter>> counters_;
+    std::chrono::steady_clock::time_point start_;
+    uint64_t start_ticks_;
+};
+
+}
+
+double tick_duration() {
+    return Registry::get().tick_duration();
+}
+
+Counter &counter(const std::string &name, counter_kind kind) {
+    return Registry::get().counter(name, kind);
+}
+
+std::vector<counter_value> collect() {
+    return Registry::get().collect();
+}
+
+void reset() {
+    Registry::get().reset();
+}
+
+}
+}
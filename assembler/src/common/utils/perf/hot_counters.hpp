@@ -0,0 +1,168 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+/*
+ * Low-overhead counters, histograms and scoped timers for hot loops.
+ *
+ * Every counter is registered once per call site under a literal name and keeps
+ * a cache-line sized slot per thread, so the threads do not contend updating it.
+ * Timers are read from the time stamp counter where available. The values are
+ * aggregated over the threads on collect(), which StageProfiler does after every
+ * stage and phase.
+ *
+ * All the macros compile to nothing unless SPADES_ENABLE_PERF_COUNTERS is set.
+ */
+
+#include "config.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+# include <x86intrin.h>
+#endif
+
+namespace utils {
+namespace perf {
+
+enum class counter_kind {
+    count, histogram, timer
+};
+
+// Aggregated value of a counter
+struct counter_value {
+    std::string name;
+    counter_kind kind;
+    uint64_t count;   // number of events
+    uint64_t total;   // sum of the values, nanoseconds for timers
+    std::vector<uint64_t> buckets;  // histograms: number of values with bit width i
+};
+
+class Counter {
+public:
+    static const size_t MAX_THREADS = 128;
+    static const size_t BUCKETS = 65;
+
+    Counter(const std::string &name, counter_kind kind);
+
+    void add(uint64_t value) {
+        Slot &slot = slots_[thread_slot()];
+        slot.count.fetch_add(1, std::memory_order_relaxed);
+        slot.total.fetch_add(value, std::memory_order_relaxed);
+        if (kind_ == counter_kind::histogram)
+            histogram(slot)[bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    counter_value collect() const;
+    void reset();
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total;
+    };
+
+    // Slots are never shared by the threads until there are more than MAX_THREADS of them
+    static size_t thread_slot() {
+        static std::atomic<size_t> next(0);
+        static thread_local size_t slot = next.fetch_add(1) % MAX_THREADS;
+        return slot;
+    }
+
+    static unsigned bit_width(uint64_t value) {
+        return value ? 64 - __builtin_clzll(value) : 0;
+    }
+
+    std::atomic<uint64_t> *histogram(const Slot &slot) const {
+        return &buckets_[(&slot - slots_.data()) * BUCKETS];
+    }
+
+    std::string name_;
+    counter_kind kind_;
+    std::vector<Slot> slots_;
+    mutable std::vector<std::atomic<uint64_t>> buckets_;
+};
+
+// Time stamp counter ticks, or steady clock nanoseconds where it is not available
+inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Nanoseconds per tick measured since the start of the process
+double tick_duration();
+
+class ScopedTimer {
+public:
+    ScopedTimer(Counter &counter)
+            : counter_(counter), start_(ticks()) {}
+
+    ~ScopedTimer() {
+        counter_.add(ticks() - start_);
+    }
+
+private:
+    Counter &counter_;
+    uint64_t start_;
+};
+
+// Returns the counter registered under the name, registering it on the first call
+Counter &counter(const std::string &name, counter_kind kind = counter_kind::count);
+
+// Aggregated values of all the counters with events, ordered by name
+std::vector<counter_value> collect();
+
+void reset();
+
+}
+}
+
+#ifdef SPADES_ENABLE_PERF_COUNTERS
+
+#define PERF_CONCAT_IMPL(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_IMPL(a, b)
+
+#define PERF_COUNT(name, value)                                                     \
+    do {                                                                            \
+        static ::utils::perf::Counter &__perf_counter = ::utils::perf::counter(name); \
+        __perf_counter.add(value);                                                  \
+    } while (0)
+
+#define PERF_HISTOGRAM(name, value)                                                 \
+    do {                                                                            \
+        static ::utils::perf::Counter &__perf_counter =                             \
+                ::utils::perf::counter(name, ::utils::perf::counter_kind::histogram); \
+        __perf_counter.add(value);                                                  \
+    } while (0)
+
+#define PERF_SCOPED_TIMER(name)                                                     \
+    static ::utils::perf::Counter &PERF_CONCAT(__perf_timer, __LINE__) =            \
+            ::utils::perf::counter(name, ::utils::perf::counter_kind::timer);       \
+    ::utils::perf::ScopedTimer PERF_CONCAT(__perf_scoped_timer, __LINE__)(PERF_CONCAT(__perf_timer, __LINE__))
+
+// The name is computed and looked up on every call, not for hot loops
+#define PERF_DYNAMIC_SCOPED_TIMER(name)                                             \
+    ::utils::perf::ScopedTimer PERF_CONCAT(__perf_scoped_timer, __LINE__)(          \
+            ::utils::perf::counter(name, ::utils::perf::counter_kind::timer))
+
+#else
+
+#define PERF_COUNT(name, value) do {} while (0)
+#define PERF_HISTOGRAM(name, value) do {} while (0)
+#define PERF_SCOPED_TIMER(name) do {} while (0)
+#define PERF_DYNAMIC_SCOPED_TIMER(name) do {} while (0)
+
+#endif
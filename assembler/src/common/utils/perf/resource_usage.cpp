@@ -0,0 +1,74 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#include "resource_usage.hpp"
+#include "utils/memory_limit.hpp"
+
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <fstream>
+#include <string>
+#include <cstdint>
+
+#include "config.hpp"
+
+#ifdef SPADES_USE_JEMALLOC
+# include <jemalloc/jemalloc.h>
+#endif
+
+namespace utils {
+
+static double to_seconds(const timeval &tv) {
+    return (double) tv.tv_sec + (double) tv.tv_usec * 1e-6;
+}
+
+static void read_proc_io(resource_usage &usage) {
+    // Linux only, the counters stay zero elsewhere
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    size_t value;
+    while (io >> key >> value) {
+        if (key == "rchar:")
+            usage.read_chars = value;
+        else if (key == "wchar:")
+            usage.write_chars = value;
+        else if (key == "read_bytes:")
+            usage.storage_read = value;
+        else if (key == "write_bytes:")
+            usage.storage_write = value;
+    }
+}
+
+resource_usage get_resource_usage() {
+    resource_usage usage;
+
+    timeval now;
+    gettimeofday(&now, NULL);
+    usage.wall_time = to_seconds(now);
+
+    rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    usage.cpu_time = to_seconds(ru.ru_utime) + to_seconds(ru.ru_stime);
+    usage.max_rss = get_max_rss();
+
+#ifdef SPADES_USE_JEMALLOC
+    // jemalloc statistics are cached until the epoch is advanced
+    uint64_t epoch = 1;
+    size_t len = sizeof(epoch);
+    je_mallctl("epoch", &epoch, &len, &epoch, len);
+
+    len = sizeof(size_t);
+    je_mallctl("stats.allocated", &usage.heap_allocated, &len, NULL, 0);
+    je_mallctl("stats.active", &usage.heap_active, &len, NULL, 0);
+#endif
+
+    read_proc_io(usage);
+
+    return usage;
+}
+
+}
@@ -0,0 +1,34 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <cstdlib>
+
+namespace utils {
+
+// Snapshot of the process resource counters. Counters not available on the
+// platform (or without jemalloc) are zero.
+struct resource_usage {
+    double wall_time;          // seconds since the epoch
+    double cpu_time;           // user + system time of all threads, seconds
+    size_t max_rss;            // peak RSS, Kb
+    size_t heap_allocated;     // bytes allocated by the application (jemalloc)
+    size_t heap_active;        // bytes in active pages (jemalloc)
+    size_t read_chars;         // bytes read by read(2) and friends
+    size_t write_chars;        // bytes written by write(2) and friends
+    size_t storage_read;       // bytes actually fetched from the storage
+    size_t storage_write;      // bytes actually sent to the storage
+
+    resource_usage()
+            : wall_time(0), cpu_time(0), max_rss(0),
+              heap_allocated(0), heap_active(0),
+              read_chars(0), write_chars(0), storage_read(0), storage_write(0) {}
+};
+
+resource_usage get_resource_usage();
+
+}
@@ -36,6 +36,15 @@ public:
     SimpleKeyWithHash(Key key, const HashFunction &hash)
             : hash_(hash), key_(key), idx_(0), ready_(false) {}
 
+    // Key with the index already known, e.g. resolved by the batched lookup
+    SimpleKeyWithHash(Key key, const HashFunction &hash, IdxType idx)
+            : hash_(hash), key_(key), idx_(idx), ready_(true) {}
+
+    // The key the index is looked up for
+    static const Key &HashedKey(const Key &key) {
+        return key;
+    }
+
     Key key() const {
         return key_;
     }
@@ -133,6 +142,15 @@ private:
     InvertableKeyWithHash(Key key, const HashFunction &hash)
             : hash_(hash), key_(key), idx_(0), is_minimal_(false), ready_(false) {}
 
+    // Key with the index already known, e.g. resolved by the batched lookup
+    InvertableKeyWithHash(Key key, const HashFunction &hash, IdxType idx)
+            : InvertableKeyWithHash(key, hash, key.IsMinimal(), idx, true) {}
+
+    // The key the index is looked up for
+    static Key HashedKey(const Key &key) {
+        return key.IsMinimal() ? key : !key;
+    }
+
     const Key &key() const {
         return key_;
     }
@@ -72,9 +72,9 @@ public:
     }
 
     template<class Reader>
-    void BinRead(Reader &reader, const std::string &) {
+    void BinRead(Reader &reader, const std::string &FileName) {
         clear();
-        index_ptr_->deserialize(reader);
+        index_ptr_->deserialize(reader, FileName);
     }
 };
 
@@ -97,6 +97,28 @@ public:
         return KeyBase::valid(kwh.idx());
     }
 
+    // Appends the keys with their indices resolved by the batched lookup (see
+    // KMerIndex::seq_idx) and prefetches the values of the valid ones
+    void ConstructKWH(const std::vector<KeyType> &keys, std::vector<KeyWithHash> &res) const {
+        const size_t batch = KMerIndexT::LookupBatch;
+        KeyType hashed[batch];
+        size_t idx[batch];
+
+        res.reserve(res.size() + keys.size());
+        for (size_t start = 0; start < keys.size(); start += batch) {
+            size_t cnt = (keys.size() - start < batch ? keys.size() - start : batch);
+            for (size_t i = 0; i < cnt; ++i)
+                hashed[i] = KeyWithHash::HashedKey(keys[start + i]);
+            index_ptr_->seq_idx(hashed, cnt, idx);
+
+            for (size_t i = 0; i < cnt; ++i) {
+                res.emplace_back(keys[start + i], *index_ptr_, idx[i]);
+                if (KeyBase::valid(idx[i]))
+                    __builtin_prefetch(&ValueBase::operator[](idx[i]));
+            }
+        }
+    }
+
     PerfectHashMap(unsigned k) : KeyBase(k) {}
 
     PerfectHashMap(unsigned k, std::shared_ptr<KMerIndexT> index_ptr)
@@ -118,6 +140,13 @@ public:
         return StoringType::get_value(*this, kwh, inverter);
     }
 
+    // Values of the whole batch, the invalid keys get the default value
+    void get_values(const std::vector<KeyWithHash> &kwhs, std::vector<V> &res) const {
+        res.reserve(res.size() + kwhs.size());
+        for (const auto &kwh : kwhs)
+            res.push_back(KeyBase::valid(kwh.idx()) ? get_value(kwh) : V());
+    }
+
     //Think twice or ask AntonB if you want to use it!
     V &get_raw_value_reference(const KeyWithHash &kwh) {
         return ValueBase::operator[](kwh.idx());
@@ -277,6 +306,17 @@ public:
     KeyStoringMap(KeyStoringMap&& other)
             : base(std::move(other)), kmers_(std::move(other.kmers_)) {}
 
+    // Same as the one of the base, the stored keys of the valid indices are
+    // prefetched for the following valid() calls as well
+    void ConstructKWH(const std::vector<KMer> &keys, std::vector<KeyWithHash> &res) const {
+        size_t start = res.size();
+        base::ConstructKWH(keys, res);
+        for (size_t i = start; i < res.size(); ++i) {
+            if (base::valid(res[i]))
+                __builtin_prefetch(&(*this->kmers_)[res[i].idx()]);
+        }
+    }
+
     KMer true_kmer(KeyWithHash kwh) const {
         VERIFY(this->valid(kwh));
 
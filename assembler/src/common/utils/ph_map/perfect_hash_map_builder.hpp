@@ -126,7 +126,7 @@ size_t BuildIndexFromStream(const std::string &workdir,
     DeBruijnReadKMerSplitter<typename Streams::ReadT,
                              StoringTypeFilter<typename Index::storing_type>>
             splitter(workdir, index.k(), 0, streams, contigs_stream);
-    KMerDiskCounter<RtSeq> counter(workdir, splitter);
+    KMerInMemoryCounter<RtSeq> counter(workdir, splitter);
     BuildIndex(index, counter, 16, streams.size());
     return 0;
 }
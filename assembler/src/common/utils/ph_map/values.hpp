@@ -7,16 +7,23 @@
 
 #pragma once
 
+#include "io/kmers/mmapped_reader.hpp"
+
 #include <vector>
 #include <string>
+#include <memory>
 #include <cstdlib>
 #include <cstdint>
 
+#include <unistd.h>
+
 namespace utils {
 
 template<class V>
 class ValueArray {
     static const size_t InvalidIdx = SIZE_MAX;
+    // Marks the mmap-able layout, legacy layout starts with the size
+    static const uint64_t MappedMagic = 0x3156415250535053ULL; // "SPSPRAV1"
 public:
     typedef size_t IdxType;
     typedef V ValueType;
@@ -24,72 +31,121 @@ public:
 protected:
     typedef std::vector<V> StorageT;
     StorageT data_;
+    // Values are either owned (data_) or mapped from file copy-on-write
+    V *values_;
+    size_t size_;
+    std::unique_ptr<MMappedReader> mapping_;
 
     void resize(size_t size) {
+        mapping_.reset();
         data_.resize(size);
+        values_ = data_.data();
+        size_ = size;
     }
 
 public:
-    typedef typename StorageT::iterator value_iterator;
-    typedef typename StorageT::const_iterator const_value_iterator;
+    typedef V *value_iterator;
+    typedef const V *const_value_iterator;
 
-    ValueArray() {
+    ValueArray()
+            : values_(nullptr), size_(0) {
     }
 
+    ValueArray(ValueArray &&) = default;
+    ValueArray &operator=(ValueArray &&) = default;
+
     ~ValueArray() {
     }
 
     void clear() {
         data_.clear();
         StorageT().swap(data_);
+        mapping_.reset();
+        values_ = nullptr;
+        size_ = 0;
     }
 
     const V &operator[](size_t idx) const {
-        return data_[idx];
+        return values_[idx];
     }
 
     V &operator[](size_t idx) {
-        return data_[idx];
+        return values_[idx];
     }
 
 public:
     size_t size() const {
-        return data_.size();
+        return size_;
+    }
+
+    bool mapped() const {
+        return (bool)mapping_;
     }
 
     value_iterator value_begin() {
-        return data_.begin();
+        return values_;
     }
     const_value_iterator value_begin() const {
-        return data_.begin();
+        return values_;
     }
     const_value_iterator value_cbegin() const {
-        return data_.cbegin();
+        return values_;
     }
     value_iterator value_end() {
-        return data_.end();
+        return values_ + size_;
     }
     const_value_iterator value_end() const {
-        return data_.end();
+        return values_ + size_;
     }
     const_value_iterator value_cend() const {
-        return data_.cend();
+        return values_ + size_;
     }
 
     template<class Writer>
     void BinWrite(Writer &writer) const {
-        size_t sz = data_.size();
+        uint64_t magic = MappedMagic;
+        size_t sz = size_;
+        writer.write((char*) &magic, sizeof(magic));
         writer.write((char*) &sz, sizeof(sz));
-        writer.write((char*) &data_[0], sz * sizeof(data_[0]));
+        // Make sure data is aligned to the page boundary
+        unsigned PageSize = getpagesize();
+        size_t cpos = writer.tellp();
+        size_t pos = (cpos + PageSize - 1 + sizeof(size_t)) / PageSize * PageSize;
+        size_t off = pos - writer.tellp();
+        writer.write((char*) &off, sizeof(off));
+        writer.seekp(pos);
+        writer.write((char*) values_, sz * sizeof(V));
     }
 
+    // Values are mapped from the given file if its name is provided. Pages are
+    // loaded lazily, modifications are private to the process.
     template<class Reader>
-    void BinRead(Reader &reader, const std::string &) {
+    void BinRead(Reader &reader, const std::string &FileName) {
         clear();
-        size_t sz = 0;
+        uint64_t magic = 0;
+        reader.read((char*) &magic, sizeof(magic));
+        if (magic != MappedMagic) {
+            resize(magic);
+            reader.read((char*) values_, size_ * sizeof(V));
+            return;
+        }
+
+        size_t sz = 0, off = 0;
         reader.read((char*) &sz, sizeof(sz));
-        data_.resize(sz);
-        reader.read((char*) &data_[0], sz * sizeof(data_[0]));
+        reader.read((char*) &off, sizeof(off));
+        off -= sizeof(off);
+        off += reader.tellg();
+
+        if (FileName.size() && sz) {
+            mapping_.reset(new MMappedReader(FileName, /* unlink */ false, -1ULL, off, sz * sizeof(V)));
+            values_ = (V*) mapping_->data();
+            size_ = sz;
+        } else {
+            resize(sz);
+            reader.seekg(off);
+            reader.read((char*) values_, sz * sizeof(V));
+        }
+        reader.seekg(off + sz * sizeof(V));
     }
 };
 
@@ -54,6 +54,7 @@ struct MappingTraits<corrector::corrector_config> {
         io.mapRequired("strategy", cfg.strat);
         io.mapOptional("bwa", cfg.bwa, std::string("."));
         io.mapOptional("log_filename", cfg.log_filename, std::string("."));
+        io.mapOptional("streaming", cfg.streaming, true);
     }
 };
 }}
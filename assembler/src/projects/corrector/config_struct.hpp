@@ -26,6 +26,9 @@ struct corrector_config {
     Strategy strat;
     std::string bwa;
     std::string log_filename;
+    // Route reads from the per-library SAM files to in-memory contigs instead
+    // of splitting them into per-contig files
+    bool streaming;
 };
 
 void load(corrector::corrector_config& cfg, const std::string &filename);
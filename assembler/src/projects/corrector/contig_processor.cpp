@@ -39,7 +39,6 @@ void ContigProcessor::ReadContig() {
 }
 
 void ContigProcessor::UpdateOneRead(const SingleSamRead &tmp, MappedSamStream &sm) {
-    unordered_map<size_t, position_description> all_positions;
     if (tmp.contig_id() < 0) {
         return;
     }
@@ -47,6 +46,11 @@ void ContigProcessor::UpdateOneRead(const SingleSamRead &tmp, MappedSamStream &s
     if (contig_name_.compare(cur_s) != 0) {
         return;
     }
+    UpdateOneRead(tmp);
+}
+
+void ContigProcessor::UpdateOneRead(const SingleSamRead &tmp) {
+    unordered_map<size_t, position_description> all_positions;
     CountPositions(tmp, all_positions);
     size_t error_num = 0;
 
@@ -232,12 +236,16 @@ bool ContigProcessor::CountPositions(const SingleSamRead &read, unordered_map<si
 }
 
 
-bool ContigProcessor::CountPositions(const PairedSamRead &read, unordered_map<size_t, position_description> &ps) const {
+bool ContigProcessor::CountPositions(const PairedSamRead &read, unordered_map<size_t, position_description> &ps,
+                                     int contig_id) const {
 
     TRACE("starting pairing");
-    bool t1 = CountPositions(read.Left(), ps );
+    auto on_contig = [contig_id](const SingleSamRead &r) {
+        return contig_id < 0 || r.contig_id() == contig_id;
+    };
+    bool t1 = on_contig(read.Left()) && CountPositions(read.Left(), ps);
     unordered_map<size_t, position_description> tmp;
-    bool t2 = CountPositions(read.Right(), tmp);
+    bool t2 = on_contig(read.Right()) && CountPositions(read.Right(), tmp);
     //overlaps.. multimap? Look on qual?
     if (ps.size() == 0 || tmp.size() == 0) {
         //We do not need paired reads which are not really paired
@@ -250,18 +258,7 @@ bool ContigProcessor::CountPositions(const PairedSamRead &read, unordered_map<si
     return (t1 && t2);
 }
 
-size_t ContigProcessor::ProcessMultipleSamFiles() {
-    error_counts_.resize(kMaxErrorNum);
-    for (const auto &sf : sam_files_) {
-        MappedSamStream sm(sf.first);
-        while (!sm.eof()) {
-            SingleSamRead tmp;
-            sm >> tmp;
-
-            UpdateOneRead(tmp, sm);
-        }
-        sm.close();
-    }
+bool ContigProcessor::FillInterestingPositions() {
     size_t total_coverage = 0;
     for (const auto &pos: charts_)
         total_coverage += pos.TotalMapped();
@@ -275,24 +272,22 @@ size_t ContigProcessor::ProcessMultipleSamFiles() {
         DEBUG ("coverage is relatively uniform, average coverage is " << average_coverage
                << " setting interesting positions heuristics to " << interesting_weight_cutoff);
     }
-    ipp_.FillInterestingPositions(charts_);
-    for (const auto &sf : sam_files_) {
-        MappedSamStream sm(sf.first);
-        while (!sm.eof()) {
-            unordered_map<size_t, position_description> ps;
-            if (sf.second == io::LibraryType::PairedEnd ) {
-                PairedSamRead tmp;
-                sm >> tmp;
-                CountPositions(tmp, ps);
-            } else {
-                SingleSamRead tmp;
-                sm >> tmp;
-                CountPositions(tmp, ps);
-            }
-            ipp_.UpdateInterestingRead(ps);
-        }
-        sm.close();
-    }
+    return ipp_.FillInterestingPositions(charts_);
+}
+
+void ContigProcessor::UpdateInterestingRead(const SingleSamRead &read) {
+    unordered_map<size_t, position_description> ps;
+    CountPositions(read, ps);
+    ipp_.UpdateInterestingRead(ps);
+}
+
+void ContigProcessor::UpdateInterestingRead(const PairedSamRead &read, int contig_id) {
+    unordered_map<size_t, position_description> ps;
+    CountPositions(read, ps, contig_id);
+    ipp_.UpdateInterestingRead(ps);
+}
+
+size_t ContigProcessor::Finalize(io::SingleRead &corrected) {
     ipp_.UpdateInterestingPositions();
     unordered_map<size_t, position_description> interesting_positions = ipp_.get_weights();
     stringstream s_new_contig;
@@ -302,7 +297,6 @@ size_t ContigProcessor::ProcessMultipleSamFiles() {
     }
     vector<string> contig_name_splitted;
     boost::split(contig_name_splitted, contig_name_, boost::is_any_of("_"));
-    io::OFastaReadStream oss(output_contig_file_);
     for(size_t i = 0; i < contig_name_splitted.size(); i++) {
         if (contig_name_splitted[i] == "length" && i + 1 < contig_name_splitted.size()) {
             contig_name_splitted[i + 1] = std::to_string(int(s_new_contig.str().length()));
@@ -313,7 +307,42 @@ size_t ContigProcessor::ProcessMultipleSamFiles() {
     for(size_t i = 1; i < contig_name_splitted.size(); i++) {
         new_header += "_" + contig_name_splitted[i];
     }
-    oss << io::SingleRead(new_header, s_new_contig.str());
+    corrected = io::SingleRead(new_header, s_new_contig.str());
+
+    return total_changes;
+}
+
+size_t ContigProcessor::ProcessMultipleSamFiles() {
+    for (const auto &sf : sam_files_) {
+        MappedSamStream sm(sf.first);
+        while (!sm.eof()) {
+            SingleSamRead tmp;
+            sm >> tmp;
+
+            UpdateOneRead(tmp, sm);
+        }
+        sm.close();
+    }
+    FillInterestingPositions();
+    for (const auto &sf : sam_files_) {
+        MappedSamStream sm(sf.first);
+        while (!sm.eof()) {
+            if (sf.second == io::LibraryType::PairedEnd ) {
+                PairedSamRead tmp;
+                sm >> tmp;
+                UpdateInterestingRead(tmp);
+            } else {
+                SingleSamRead tmp;
+                sm >> tmp;
+                UpdateInterestingRead(tmp);
+            }
+        }
+        sm.close();
+    }
+    io::SingleRead corrected;
+    size_t total_changes = Finalize(corrected);
+    io::OFastaReadStream oss(output_contig_file_);
+    oss << corrected;
 
     return total_changes;
 }
@@ -20,6 +20,7 @@
 #include <io/sam/sam_reader.hpp>
 #include <io/sam/read.hpp>
 #include "pipeline/library.hpp"
+#include "io/reads/single_read.hpp"
 
 #include <string>
 #include <vector>
@@ -30,6 +31,16 @@ namespace corrector {
 using namespace sam_reader;
 
 typedef std::vector<std::pair<std::string, io::LibraryType> > sam_files_type;
+
+/*
+ * Corrects a single contig in two passes over its reads: the first one
+ * collects the pileup, the second one collects the reads covering the
+ * interesting positions found by the pileup.
+ *
+ * The reads are either read from the SAM files of the contig
+ * (ProcessMultipleSamFiles), or are fed by the caller pass by pass
+ * (UpdateOneRead, FillInterestingPositions, UpdateInterestingRead, Finalize).
+ */
 class ContigProcessor {
     sam_files_type sam_files_;
     std::string contig_file_;
@@ -48,16 +59,41 @@ public:
     ContigProcessor(const sam_files_type &sam_files, const std::string &contig_file)
             : sam_files_(sam_files), contig_file_(contig_file) {
         ReadContig();
+        Init();
+    }
+
+    ContigProcessor(const std::string &contig_name, const std::string &contig)
+            : contig_name_(contig_name), contig_(contig) {
+        charts_.resize(contig_.length());
+        Init();
+    }
+
+    size_t ProcessMultipleSamFiles();
+
+    // First pass: the read aligned to the contig
+    void UpdateOneRead(const SingleSamRead &read);
+    // Returns false if there are no interesting positions, so the second pass
+    // could be skipped
+    bool FillInterestingPositions();
+    // Second pass: the read or the pair aligned to the contig. The mates
+    // aligned to the contigs other than contig_id are treated as unaligned,
+    // as in the SAM file of the contig (negative contig_id means any contig)
+    void UpdateInterestingRead(const SingleSamRead &read);
+    void UpdateInterestingRead(const PairedSamRead &read, int contig_id = -1);
+    // Corrected contig, returns the number of changed nucleotides
+    size_t Finalize(io::SingleRead &corrected);
+private:
+    void Init() {
         ipp_.set_contig(contig_);
+        error_counts_.resize(kMaxErrorNum);
 //At least three reads to believe in inexact repeats heuristics.
         interesting_weight_cutoff = 2;
     }
-    size_t ProcessMultipleSamFiles();
-private:
     void ReadContig();
 //Moved from read.hpp
     bool CountPositions(const SingleSamRead &read, std::unordered_map<size_t, position_description> &ps) const;
-    bool CountPositions(const PairedSamRead &read, std::unordered_map<size_t, position_description> &ps) const;
+    bool CountPositions(const PairedSamRead &read, std::unordered_map<size_t, position_description> &ps,
+                        int contig_id) const;
 
     void UpdateOneRead(const SingleSamRead &tmp, MappedSamStream &sm);
     //returns: number of changed nucleotides;
@@ -14,6 +14,7 @@
 #include "utils/filesystem/path_helper.hpp"
 #include "io/reads/osequencestream.hpp"
 #include "utils/parallel/openmp_wrapper.h"
+#include "utils/memory_limit.hpp"
 
 #include <boost/algorithm/string.hpp>
 
@@ -54,6 +55,19 @@ void DatasetProcessor::SplitGenome(const string &genome_splitted_dir) {
     }
 }
 
+void DatasetProcessor::LoadGenome() {
+    io::FileReadStream frs(genome_file_);
+    while (!frs.eof()) {
+        io::SingleRead cur_read;
+        frs >> cur_read;
+        if (contig_ids_.find(cur_read.name()) != contig_ids_.end()) {
+            WARN("Duplicated contig names! Multiple contigs with name" << cur_read.name());
+        }
+        contig_ids_[cur_read.name()] = contigs_.size();
+        contigs_.push_back(cur_read);
+    }
+}
+
 //contigs - set of aligned contig names
 void DatasetProcessor::GetAlignedContigs(const string &read, set<string> &contigs) const {
     vector<string> arr;
@@ -192,9 +206,16 @@ void DatasetProcessor::PrepareContigDirs(const size_t lib_count) {
 
 void DatasetProcessor::ProcessDataset() {
     size_t lib_num = 0;
-    INFO("Splitting assembly...");
-    INFO("Assembly file: " + genome_file_);
-    SplitGenome(work_dir_);
+    bool streaming = corr_cfg::get().streaming;
+    if (streaming) {
+        INFO("Loading assembly...");
+        INFO("Assembly file: " + genome_file_);
+        LoadGenome();
+    } else {
+        INFO("Splitting assembly...");
+        INFO("Assembly file: " + genome_file_);
+        SplitGenome(work_dir_);
+    }
     for (size_t i = 0; i < corr_cfg::get().dataset.lib_count(); ++i) {
         const auto& dataset = corr_cfg::get().dataset[i];
         auto lib_type = dataset.type();
@@ -208,8 +229,10 @@ void DatasetProcessor::ProcessDataset() {
                 if (samf != "") {
                     INFO("Adding samfile " << samf);
                     unsplitted_sam_files_.push_back(make_pair(samf, lib_type));
-                    PrepareContigDirs(lib_num);
-                    SplitPairedLibrary(samf, lib_num);
+                    if (!streaming) {
+                        PrepareContigDirs(lib_num);
+                        SplitPairedLibrary(samf, lib_num);
+                    }
                     lib_num++;
                 } else {
                     FATAL_ERROR("Failed to align paired reads " << left << " and " << right);
@@ -223,8 +246,10 @@ void DatasetProcessor::ProcessDataset() {
                 if (samf != "") {
                     INFO("Adding samfile " << samf);
                     unsplitted_sam_files_.push_back(make_pair(samf, io::LibraryType::SingleReads));
-                    PrepareContigDirs(lib_num);
-                    SplitSingleLibrary(samf, lib_num);
+                    if (!streaming) {
+                        PrepareContigDirs(lib_num);
+                        SplitSingleLibrary(samf, lib_num);
+                    }
                     lib_num++;
                 } else {
                     FATAL_ERROR("Failed to align single reads " << left);
@@ -232,6 +257,13 @@ void DatasetProcessor::ProcessDataset() {
             }
         }
     }
+    if (streaming)
+        ProcessContigsStreaming();
+    else
+        ProcessSplittedContigs();
+}
+
+void DatasetProcessor::ProcessSplittedContigs() {
     INFO("Processing contigs");
     vector<pair<size_t, string> > ordered_contigs;
     for (const auto &ac : all_contigs_) {
@@ -256,6 +288,147 @@ void DatasetProcessor::ProcessDataset() {
     GlueSplittedContigs(output_contig_file_);
 }
 
+// Contigs the read is routed to, the same as when the SAM files are split
+// by contig: the ones the read (or any of the mates) is aligned to with
+// non-zero mapping quality
+static void AlignedContigs(const SingleSamRead &read, vector<int> &contigs) {
+    if (read.contig_id() >= 0 && read.map_qual() > 0)
+        contigs.push_back(read.contig_id());
+}
+
+static void AlignedContigs(const PairedSamRead &read, vector<int> &contigs) {
+    AlignedContigs(read.Left(), contigs);
+    AlignedContigs(read.Right(), contigs);
+    if (contigs.size() == 2 && contigs[0] == contigs[1])
+        contigs.pop_back();
+}
+
+// The file is read in batches, the reads of the batch are grouped by contig
+// and the contigs are processed in parallel, each by a single thread, so
+// every contig gets its reads in the file order. The handler also gets the
+// id of the contig in the SAM file.
+template<class Read, class Handler>
+void DatasetProcessor::StreamSamFile(const string &sam_file, size_t start, size_t end,
+                                     const vector<bool> &routed, Handler handler) {
+    MappedSamStream sm(sam_file);
+    vector<size_t> ids;
+    for (size_t i = 0; i < sm.contig_num(); ++i) {
+        auto it = contig_ids_.find(sm.get_contig_name((int) i));
+        VERIFY_MSG(it != contig_ids_.end(), "wrong contig name in SAM file header: " << sm.get_contig_name((int) i));
+        ids.push_back(it->second);
+    }
+
+    vector<vector<pair<int, Read>>> batch(end - start);
+    vector<size_t> touched;
+    vector<int> contigs;
+    while (!sm.eof()) {
+        size_t buffered = 0;
+        while (!sm.eof() && buffered < kBuffSize) {
+            Read read;
+            sm >> read;
+            contigs.clear();
+            AlignedContigs(read, contigs);
+            for (int contig : contigs) {
+                if (ids[contig] < start || ids[contig] >= end || !routed[ids[contig] - start])
+                    continue;
+
+                auto &reads = batch[ids[contig] - start];
+                if (reads.empty())
+                    touched.push_back(ids[contig] - start);
+                reads.emplace_back(contig, read);
+                buffered += 1;
+            }
+        }
+
+#       pragma omp parallel for num_threads(nthreads_) schedule(dynamic, 1)
+        for (size_t i = 0; i < touched.size(); ++i) {
+            auto &reads = batch[touched[i]];
+            for (const auto &read : reads)
+                handler(touched[i], read.second, read.first);
+            vector<pair<int, Read>>().swap(reads);
+        }
+        touched.clear();
+    }
+    sm.close();
+}
+
+void DatasetProcessor::ProcessContigGroup(size_t start, size_t end, io::OFastaReadStream &oss) {
+    vector<unique_ptr<ContigProcessor>> processors(end - start);
+    for (size_t i = start; i < end; ++i)
+        processors[i - start].reset(new ContigProcessor(contigs_[i].name(), contigs_[i].GetSequenceString()));
+
+    INFO("Collecting pileup of " << end - start << " contigs");
+    vector<bool> routed(end - start, true);
+    for (const auto &sf : unsplitted_sam_files_) {
+        StreamSamFile<SingleSamRead>(sf.first, start, end, routed,
+                                     [&](size_t i, const SingleSamRead &read, int) {
+                                         processors[i]->UpdateOneRead(read);
+                                     });
+    }
+
+    // The second pass is needed only for the contigs with interesting positions
+    vector<char> interesting(end - start);
+#   pragma omp parallel for num_threads(nthreads_) schedule(dynamic, 1)
+    for (size_t i = 0; i < processors.size(); ++i)
+        interesting[i] = processors[i]->FillInterestingPositions();
+    for (size_t i = 0; i < processors.size(); ++i)
+        routed[i] = interesting[i];
+
+    size_t interesting_num = std::count(routed.begin(), routed.end(), true);
+    if (interesting_num) {
+        INFO("Collecting reads over interesting positions of " << interesting_num << " contigs");
+        for (const auto &sf : unsplitted_sam_files_) {
+            if (sf.second == io::LibraryType::PairedEnd) {
+                StreamSamFile<PairedSamRead>(sf.first, start, end, routed,
+                                             [&](size_t i, const PairedSamRead &read, int contig) {
+                                                 processors[i]->UpdateInterestingRead(read, contig);
+                                             });
+            } else {
+                StreamSamFile<SingleSamRead>(sf.first, start, end, routed,
+                                             [&](size_t i, const SingleSamRead &read, int) {
+                                                 processors[i]->UpdateInterestingRead(read);
+                                             });
+            }
+        }
+    }
+
+    vector<io::SingleRead> corrected(end - start);
+#   pragma omp parallel for num_threads(nthreads_) schedule(dynamic, 1)
+    for (size_t i = 0; i < processors.size(); ++i) {
+        size_t changes = processors[i]->Finalize(corrected[i]);
+        processors[i].reset();
+        if (contigs_[start + i].size() > kMinContigLengthForInfo) {
+#           pragma omp critical
+            {
+                INFO("Contig " << contigs_[start + i].name() << " processed with " << changes << " changes in thread " << omp_get_thread_num());
+            }
+        }
+    }
+
+    for (const auto &contig : corrected)
+        oss << contig;
+}
+
+// Contigs are processed in groups which fit into memory, every group takes a
+// pass over the SAM files (and one more if it has interesting positions). All
+// the contigs of the group are finalized once the passes are over.
+void DatasetProcessor::ProcessContigsStreaming() {
+    size_t max_length = std::max<size_t>(utils::get_free_memory() / 4 / kMemoryPerBase, 1);
+    INFO("Processing contigs, up to " << max_length << " bp at once");
+
+    io::OFastaReadStream oss(output_contig_file_);
+    for (size_t start = 0; start < contigs_.size(); ) {
+        size_t end = start, length = 0;
+        do {
+            length += contigs_[end].size();
+            end += 1;
+        } while (end < contigs_.size() && length + contigs_[end].size() <= max_length);
+
+        ProcessContigGroup(start, end, oss);
+        start = end;
+    }
+}
+
 void DatasetProcessor::GlueSplittedContigs(string &out_contigs_filename) {
     ofstream of_c(out_contigs_filename, std::ios_base::binary);
     vector<string> ordered_names;
@@ -10,6 +10,7 @@
 #include "utils/filesystem/path_helper.hpp"
 
 #include "io/reads/file_reader.hpp"
+#include "io/reads/osequencestream.hpp"
 
 #include "pipeline/library.hpp"
 
@@ -43,8 +44,14 @@ class DatasetProcessor {
     size_t nthreads_;
     size_t buffered_count_;
     std::unordered_map<size_t, std::string> lib_dirs_;
+    // Streaming mode: contigs are kept in memory, reads are routed from the
+    // unsplitted SAM files
+    std::vector<io::SingleRead> contigs_;
+    std::unordered_map<std::string, size_t> contig_ids_;
     const size_t kBuffSize = 100000;
     const size_t kMinContigLengthForInfo = 20000;
+    // Approximate memory needed by ContigProcessor per contig base
+    const size_t kMemoryPerBase = 128;
 
 protected:
     DECL_LOGGER("DatasetProcessor")
@@ -59,6 +66,7 @@ public:
     void ProcessDataset();
 private:
     void SplitGenome(const std::string &genome_splitted_dir);
+    void LoadGenome();
     void FlushAll(const size_t lib_count);
     void BufferedOutputRead(const std::string &read, const std::string &contig_name, const size_t lib_count);
     void GetAlignedContigs(const std::string &read, std::set<std::string> &contigs) const;
@@ -69,6 +77,12 @@ private:
     std::string RunSingleBwa(const std::string &single, const size_t lib);
     void PrepareContigDirs(const size_t lib_count);
     std::string GetLibDir(const size_t lib_count);
+    void ProcessSplittedContigs();
+    void ProcessContigsStreaming();
+    void ProcessContigGroup(size_t start, size_t end, io::OFastaReadStream &oss);
+    template<class Read, class Handler>
+    void StreamSamFile(const std::string &sam_file, size_t start, size_t end,
+                       const std::vector<bool> &routed, Handler handler);
 };
 }
 ;
@@ -43,6 +43,8 @@ void load(hammer_config& cfg, boost::property_tree::ptree const& pt) {
   
   load(cfg.hamming_do, pt, "hamming_do");
   load(cfg.hamming_blocksize_quadratic_threshold, pt, "hamming_blocksize_quadratic_threshold");
+  cfg.hamming_in_memory = true;
+  load(cfg.hamming_in_memory, pt, "hamming_in_memory", false);
 
   load(cfg.bayes_do, pt, "bayes_do");
   load(cfg.bayes_nthreads, pt, "bayes_nthreads");
@@ -51,6 +51,7 @@ struct hammer_config {
 
   bool hamming_do;
   unsigned hamming_blocksize_quadratic_threshold;
+  bool hamming_in_memory;
 
   bool bayes_do;
   unsigned bayes_nthreads;
@@ -9,13 +9,19 @@
 
 #include "adt/concurrent_dsu.hpp"
 #include "io/kmers/mmapped_reader.hpp"
+#include "utils/memory_limit.hpp"
+#include "utils/parallel/openmp_wrapper.h"
 #include "parallel_radix_sort.hpp"
 
 #include "config_struct_hammer.hpp"
 #include "globals.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <iterator>
 #include <sstream>
+#include <tuple>
 
 class EncoderKMer {
 public:
@@ -108,9 +114,241 @@ static void processBlockQuadratic(dsu::ConcurrentDSU  &uf,
   }
 }
 
+// Lock-free hash table grouping the positions of the sub-kmers by their values.
+// The positions of a bucket are kept as a list threaded through the positions.
+class SubKMerBuckets {
+  std::vector<std::atomic<uint64_t> > keys_;  // sub-kmer + 1, 0 for the empty bucket
+  std::vector<std::atomic<size_t> > heads_;   // position + 1, 0 for the end of the list
+  std::vector<size_t> next_;
+
+  static size_t capacity(size_t sz) {
+    size_t res = 16;
+    while (res < 2 * sz)
+      res <<= 1;
+    return res;
+  }
+
+ public:
+  explicit SubKMerBuckets(size_t sz)
+      : keys_(capacity(sz)), heads_(capacity(sz)), next_(sz) {}
+
+  static size_t footprint(size_t sz) {
+    return capacity(sz) * (sizeof(uint64_t) + sizeof(size_t)) + sz * sizeof(size_t);
+  }
+
+  size_t size() const { return keys_.size(); }
+
+  // Might be called concurrently for the different positions
+  void insert(size_t pos, const SubKMer &s) {
+    uint64_t key = uint64_t(s.data()[0]) + 1;
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    size_t mask = keys_.size() - 1, bucket = (hash ^ (hash >> 32)) & mask;
+    while (true) {
+      uint64_t cur = 0;
+      if (keys_[bucket].compare_exchange_strong(cur, key) || cur == key)
+        break;
+      bucket = (bucket + 1) & mask;
+    }
+
+    next_[pos] = heads_[bucket].exchange(pos + 1);
+  }
+
+  bool empty(size_t bucket) const {
+    return keys_[bucket].load() == 0;
+  }
+
+  uint64_t key(size_t bucket) const {
+    return keys_[bucket].load() - 1;
+  }
+
+  // Positions of the bucket in increasing order, false for the empty bucket
+  bool positions(size_t bucket, std::vector<size_t> &res) const {
+    res.clear();
+    for (size_t pos = heads_[bucket].load(); pos; pos = next_[pos - 1])
+      res.push_back(pos - 1);
+    std::sort(res.begin(), res.end());
+
+    return !res.empty();
+  }
+};
+
+// Pair of k-mers within tau found in the block of the pass, ordered the same
+// way as the on-disk passes check them.
+struct SubKMerHit {
+  size_t block;
+  uint64_t key;
+  size_t x, y;
+
+  bool operator<(const SubKMerHit &other) const {
+    return std::tie(block, key, x, y) < std::tie(other.block, other.key, other.x, other.y);
+  }
+};
+
+static void checkBlockQuadratic(std::vector<SubKMerHit> &hits,
+                                const std::vector<size_t> &block,
+                                size_t block_id, uint64_t key,
+                                const KMerData &data,
+                                unsigned tau) {
+  std::vector<hammer::KMer> kmers;
+  kmers.reserve(block.size());
+  for (size_t idx : block)
+    kmers.push_back(data.kmer(idx));
+
+  // Every k-mer is compared against all the following ones in one batch
+  std::vector<unsigned> dists(block.size());
+  for (size_t i = 0; i + 1 < block.size(); ++i) {
+    hamming::distances(kmers[i], kmers.data() + i + 1, block.size() - i - 1, dists.data());
+    for (size_t j = i + 1; j < block.size(); ++j)
+      if (dists[j - i - 1] <= tau)
+        hits.push_back({ block_id, key, block[i], block[j] });
+  }
+}
+
+// Distances do not depend on the unions, so only the unions themselves are
+// done sequentially, in the order processBlockQuadratic does them.
+static size_t mergeHits(dsu::ConcurrentDSU &uf,
+                        std::vector<std::vector<SubKMerHit> > &thread_hits) {
+  std::vector<SubKMerHit> hits;
+  for (auto &entry : thread_hits) {
+    hits.insert(hits.end(), entry.begin(), entry.end());
+    std::vector<SubKMerHit>().swap(entry);
+  }
+  std::sort(hits.begin(), hits.end());
+
+  for (const SubKMerHit &hit : hits) {
+    if (!uf.same(hit.x, hit.y) &&
+        canMerge(uf, hit.x, hit.y))
+      uf.unite(hit.x, hit.y);
+  }
+
+  return hits.size();
+}
+
+// Approximate number of candidate pairs kept before they are merged
+static const size_t HIT_BATCH = 1 << 21;
+
+// Checks the items [0, n) in consecutive batches and merges the hits of every
+// batch before the next one is started. Items must be given in the order of
+// the on-disk passes. The batch size follows the hit rate of the previous
+// batch, so that about HIT_BATCH hits are kept at a time.
+template<class Op>
+static void checkInBatches(dsu::ConcurrentDSU &uf, size_t n,
+                           unsigned nthreads, size_t grain, Op &&op) {
+  std::vector<std::vector<SubKMerHit> > hits(nthreads);
+  size_t batch = grain * nthreads;
+  for (size_t start = 0; start < n; ) {
+    size_t end = std::min(n, start + batch);
+#   pragma omp parallel for schedule(dynamic, grain) num_threads(nthreads)
+    for (size_t i = start; i < end; ++i)
+      op(i, omp_get_thread_num(), hits[omp_get_thread_num()]);
+
+    size_t nhits = mergeHits(uf, hits);
+    batch = std::max<size_t>(1, std::min(2 * batch, (end - start) * HIT_BATCH / (nhits + 1)));
+    start = end;
+  }
+}
+
+size_t KMerHamClusterer::inMemoryFootprint(const KMerData &data) const {
+  // Bucket table of a pass, the sorted sub-kmers of a first pass part, the big
+  // blocks of all the first pass parts and a batch of hits with its merged copy
+  return SubKMerBuckets::footprint(data.size()) +
+      2 * data.size() * (sizeof(uint32_t) + sizeof(size_t)) +
+      (tau_ + 1) * data.size() * sizeof(size_t) +
+      4 * HIT_BATCH * sizeof(SubKMerHit);
+}
+
+void KMerHamClusterer::clusterInMemory(const KMerData &data,
+                                       dsu::ConcurrentDSU &uf) {
+  unsigned nthreads = cfg::get().general_max_nthreads;
+  unsigned block_thr = cfg::get().hamming_blocksize_quadratic_threshold;
+
+  // Big blocks in the order the first pass dumps them
+  std::vector<std::vector<size_t> > big_blocks;
+  for (unsigned i = 0; i < tau_ + 1; ++i) {
+    size_t from = (*Globals::subKMerPositions)[i];
+    size_t to = (*Globals::subKMerPositions)[i+1];
+    INFO("Grouping sub-kmers: [" << from << ", " << to << ")");
+
+    SubKMerPartSerializer serializer(from, to);
+    SubKMerBuckets buckets(data.size());
+#   pragma omp parallel for num_threads(nthreads)
+    for (size_t idx = 0; idx < data.size(); ++idx)
+      buckets.insert(idx, serializer.serialize(data.kmer(idx)));
+
+    // Non-empty buckets in the order of their sub-kmers
+    std::vector<uint32_t> keys;
+    std::vector<size_t> order;
+    for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+      if (buckets.empty(bucket))
+        continue;
+      keys.push_back(uint32_t(buckets.key(bucket)));
+      order.push_back(bucket);
+    }
+    parallel_radix_sort::PairSort<uint32_t, size_t>::InitAndSort(keys.data(), order.data(), order.size(), nthreads);
+    std::vector<uint32_t>().swap(keys);
+
+    std::vector<std::vector<size_t> > blocks(nthreads);
+    std::vector<std::vector<std::pair<uint64_t, std::vector<size_t> > > > big(nthreads);
+    checkInBatches(uf, order.size(), nthreads, 1024,
+                   [&](size_t i, unsigned thread, std::vector<SubKMerHit> &hits) {
+                     std::vector<size_t> &block = blocks[thread];
+                     size_t bucket = order[i];
+                     buckets.positions(bucket, block);
+                     if (block.size() < block_thr)
+                       checkBlockQuadratic(hits, block, 0, buckets.key(bucket), data, tau_);
+                     else
+                       big[thread].emplace_back(buckets.key(bucket), block);
+                   });
+
+    std::vector<std::pair<uint64_t, std::vector<size_t> > > part_blocks;
+    for (auto &entry : big)
+      std::move(entry.begin(), entry.end(), std::back_inserter(part_blocks));
+    std::sort(part_blocks.begin(), part_blocks.end());
+    for (auto &entry : part_blocks)
+      big_blocks.push_back(std::move(entry.second));
+  }
+  INFO("Merge done, total " << big_blocks.size() << " big blocks.");
+
+  // Every big block is split by all the strided sub-kmers, all the blocks are merged
+  size_t ntasks = big_blocks.size() * (tau_ + 1);
+  std::vector<std::vector<size_t> > positions(nthreads), blocks(nthreads);
+  checkInBatches(uf, ntasks, nthreads, 1,
+                 [&](size_t task, unsigned thread, std::vector<SubKMerHit> &hits) {
+                   const std::vector<size_t> &big_block = big_blocks[task / (tau_ + 1)];
+                   SubKMerStridedSerializer serializer(task % (tau_ + 1), tau_ + 1);
+
+                   SubKMerBuckets buckets(big_block.size());
+                   for (size_t pos = 0; pos < big_block.size(); ++pos)
+                     buckets.insert(pos, serializer.serialize(data.kmer(big_block[pos])));
+
+                   std::vector<size_t> &block = blocks[thread];
+                   for (size_t bucket = 0; bucket < buckets.size(); ++bucket) {
+                     if (!buckets.positions(bucket, positions[thread]))
+                       continue;
+
+                     block.clear();
+                     for (size_t pos : positions[thread])
+                       block.push_back(big_block[pos]);
+                     checkBlockQuadratic(hits, block, task, buckets.key(bucket), data, tau_);
+                   }
+                 });
+  INFO("Merge done, processed " << ntasks << " blocks.");
+}
+
 void KMerHamClusterer::cluster(const std::string &prefix,
                                const KMerData &data,
                                dsu::ConcurrentDSU &uf) {
+  if (cfg::get().hamming_in_memory) {
+    size_t needed = inMemoryFootprint(data);
+    if (needed < utils::get_free_memory() / 2) {
+      clusterInMemory(data, uf);
+      return;
+    }
+
+    INFO("Not enough memory for in-memory clustering, approx. "
+         << needed / 1024 / 1024 << " MB needed. Using on-disk passes.");
+  }
+
   // First pass - split & sort the k-mers
   std::string fname = prefix + ".first", bfname = fname + ".blocks", kfname = fname + ".kmers";
   std::ofstream bfs(bfname, std::ios::out | std::ios::binary);
@@ -146,6 +146,13 @@ class KMerHamClusterer {
 
   void cluster(const std::string &prefix, const KMerData &data, dsu::ConcurrentDSU &uf);
  private:
+  // Same clustering without the temporary files and the sorts of the sub-kmers.
+  // Sub-kmers are grouped by a lock-free hash table, the candidate pairs are
+  // checked in parallel and the unions are applied in the order of the on-disk
+  // passes, so the clusters are exactly the same.
+  void clusterInMemory(const KMerData &data, dsu::ConcurrentDSU &uf);
+  size_t inMemoryFootprint(const KMerData &data) const;
+
   DECL_LOGGER("Hamming Clustering");
 };
 
@@ -0,0 +1,120 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+// Micro-benchmark of the Hamming distance kernels on clusters of the typical
+// BayesHammer sizes: all the pairs of a cluster are compared, one k-mer against
+// the following ones, as the quadratic clustering does.
+
+#include "sequence/seq_hamming.hpp"
+#include "utils/verify.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// BayesHammer k-mers
+static const unsigned K = 21;
+typedef Seq<K> KMer;
+
+// Per-nucleotide loop the kernels replaced
+static unsigned NucleotideDistance(const KMer &x, const KMer &y) {
+  unsigned dist = 0;
+  for (unsigned i = 0; i < K; ++i)
+    dist += (x[i] != y[i]);
+  return dist;
+}
+
+// Random center and its copies with up to 3 substitutions
+static std::vector<KMer> RandomCluster(size_t size, std::mt19937_64 &rng) {
+  std::uniform_int_distribution<unsigned> nucl(0, 3), pos(0, K - 1), errors(0, 3);
+  KMer center;
+  for (unsigned i = 0; i < K; ++i)
+    center.set(i, (char) nucl(rng));
+
+  std::vector<KMer> res;
+  for (size_t i = 0; i < size; ++i) {
+    KMer kmer = center;
+    for (unsigned e = errors(rng); e > 0; --e)
+      kmer.set(pos(rng), (char) nucl(rng));
+    res.push_back(kmer);
+  }
+  return res;
+}
+
+template<class Op>
+static double Measure(size_t reps, Op &&op) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < reps; ++r)
+    op();
+  return (double) std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t total_pairs = (argc > 1 ? std::stoull(argv[1]) : 50000000);
+  std::mt19937_64 rng(42);
+
+  std::vector<hamming::kernel> kernels = { hamming::kernel::scalar };
+  if (hamming::best_kernel() != hamming::kernel::scalar)
+    kernels.push_back(hamming::kernel::popcnt);
+  if (hamming::best_kernel() == hamming::kernel::avx2)
+    kernels.push_back(hamming::kernel::avx2);
+
+  std::cout << "Best kernel: " << hamming::kernel_name(hamming::best_kernel())
+            << ", ns per comparison:" << std::endl;
+  std::cout << std::setw(8) << "size" << std::setw(12) << "nucleotide";
+  for (auto k : kernels)
+    std::cout << std::setw(12) << hamming::kernel_name(k);
+  std::cout << std::endl;
+
+  for (size_t size : { 2, 4, 16, 64, 256, 1024, 2500 }) {
+    std::vector<KMer> kmers = RandomCluster(size, rng);
+    size_t pairs = size * (size - 1) / 2;
+    size_t reps = std::max<size_t>(1, total_pairs / pairs);
+
+    std::vector<unsigned> expected;
+    for (size_t i = 0; i < size; ++i)
+      for (size_t j = i + 1; j < size; ++j)
+        expected.push_back(NucleotideDistance(kmers[i], kmers[j]));
+
+    volatile unsigned sink = 0;
+    double time = Measure(reps, [&] {
+      unsigned sum = 0;
+      for (size_t i = 0; i < size; ++i)
+        for (size_t j = i + 1; j < size; ++j)
+          sum += NucleotideDistance(kmers[i], kmers[j]);
+      sink = sink + sum;
+    });
+    std::cout << std::setw(8) << size << std::setw(12) << std::fixed << std::setprecision(2)
+              << time / (double) (reps * pairs);
+
+    std::vector<unsigned> dists(size), all;
+    for (auto k : kernels) {
+      all.clear();
+      for (size_t i = 0; i + 1 < size; ++i) {
+        hamming::distances(k, kmers[i].data(), kmers[i + 1].data(), KMer::DataSize, size - i - 1, dists.data());
+        all.insert(all.end(), dists.begin(), dists.begin() + (size - i - 1));
+      }
+      VERIFY_MSG(all == expected, "Kernel " << hamming::kernel_name(k) << " computed wrong distances");
+
+      time = Measure(reps, [&] {
+        unsigned sum = 0;
+        for (size_t i = 0; i + 1 < size; ++i) {
+          hamming::distances(k, kmers[i].data(), kmers[i + 1].data(), KMer::DataSize, size - i - 1, dists.data());
+          sum += dists[0];
+        }
+        sink = sink + sum;
+      });
+      std::cout << std::setw(12) << time / (double) (reps * pairs);
+    }
+    std::cout << std::endl;
+  }
+
+  return 0;
+}
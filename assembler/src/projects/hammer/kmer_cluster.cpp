@@ -122,6 +122,13 @@ double KMerClustering::ClusterBIC(const std::vector<Center> &centers,
 }
 
 
+// Distances from the center to all the packed k-mers of the block in one batch
+static void HamDistances(const hammer::ExpandedSeq &center, const std::vector<hammer::KMer> &kmers,
+                         std::vector<unsigned> &res) {
+  res.resize(kmers.size());
+  hamming::distances(hammer::KMer(center), kmers.data(), kmers.size(), res.data());
+}
+
 double KMerClustering::lMeansClustering(unsigned l, const std::vector<hammer::ExpandedKMer> &kmers,
                                         std::vector<size_t> &indices, std::vector<Center> &centers) {
   centers.resize(l); // there are l centers
@@ -135,15 +142,24 @@ double KMerClustering::lMeansClustering(unsigned l, const std::vector<hammer::Ex
     return ClusterBIC(centers, indices, kmers);
   }
 
+  std::vector<hammer::KMer> packed(kmers.size());
+  for (size_t i = 0; i < kmers.size(); ++i)
+    packed[i] = kmers[i].kmer();
+  std::vector<std::vector<unsigned> > center_dists(l);
+
   // Provide the initial approximation.
   double totalLikelihood = 0.0;
   if (cfg::get().bayes_initial_refine) {
     // Refine the current approximation
     centers[l-1].center_ = kmers[l-1].seq();
+    HamDistances(centers[l-1].center_, packed, center_dists[l-1]);
+    std::vector<hammer::KMer> packed_centers;
+    for (size_t j = 0; j < l; ++j)
+      packed_centers.emplace_back(centers[j].center_);
     for (size_t i = 0; i < kmers.size(); ++i) {
       size_t cidx = indices[i];
-      unsigned cdist = kmers[i].hamdist(centers[cidx].center_, K);
-      unsigned mdist = kmers[i].hamdist(centers[l-1].center_, cdist);
+      unsigned cdist = hamming::distance(packed[i], packed_centers[cidx]);
+      unsigned mdist = center_dists[l-1][i];
       if (mdist < cdist) {
         indices[i] = l - 1;
         cidx = l - 1;
@@ -152,14 +168,16 @@ double KMerClustering::lMeansClustering(unsigned l, const std::vector<hammer::Ex
     }
   } else {
     // We assume that kmers are sorted wrt the count.
-    for (size_t j = 0; j < l; ++j)
+    for (size_t j = 0; j < l; ++j) {
       centers[j].center_ = kmers[j].seq();
+      HamDistances(centers[j].center_, packed, center_dists[j]);
+    }
 
     for (size_t i = 0; i < kmers.size(); ++i) {
       unsigned mdist = K;
       unsigned cidx = 0;
       for (unsigned j = 0; j < l; ++j) {
-        unsigned cdist = kmers[i].hamdist(centers[j].center_, mdist);
+        unsigned cdist = center_dists[j][i];
         if (cdist < mdist) {
           mdist = cdist;
           cidx = j;
@@ -197,12 +215,17 @@ double KMerClustering::lMeansClustering(unsigned l, const std::vector<hammer::Ex
 
     double curlik = 0;
 
+    if (cfg::get().bayes_use_hamming_dist) {
+      for (unsigned j = 0; j < l; ++j)
+        HamDistances(centers[j].center_, packed, center_dists[j]);
+    }
+
     // E step: find which clusters we belong to
     for (size_t i = 0; i < kmers.size(); ++i) {
       size_t newInd = 0;
       if (cfg::get().bayes_use_hamming_dist) {
         for (unsigned j = 0; j < l; ++j)
-          dists[j] = kmers[i].hamdist(centers[j].center_);
+          dists[j] = center_dists[j][i];
 
         newInd = std::min_element(dists.begin(), dists.end()) - dists.begin();
       } else {
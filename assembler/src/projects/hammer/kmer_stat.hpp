@@ -11,6 +11,7 @@
 #include "utils/verify.hpp"
 
 #include "sequence/seq.hpp"
+#include "sequence/seq_hamming.hpp"
 
 #include <folly/SmallLocks.h>
 
@@ -35,15 +36,10 @@ typedef Seq<K> KMer;
 class Read;
 struct KMerStat;
 
+// The distance is exact, so it is above tau whenever the k-mers are farther than tau
 static inline unsigned hamdistKMer(const hammer::KMer &x, const hammer::KMer &y,
-                                   unsigned tau = hammer::K) {
-  unsigned dist = 0;
-  for (unsigned i = 0; i < hammer::K; ++i) {
-    if (x[i] != y[i]) {
-      ++dist; if (dist > tau) return dist;
-    }
-  }
-  return dist;
+                                   unsigned /*tau*/ = hammer::K) {
+  return hamming::distance(x, y);
 }
 
 template<unsigned N, unsigned bits,
@@ -204,7 +200,8 @@ static inline unsigned hamdist(const ExpandedSeq &x, const ExpandedSeq &y,
 
 class ExpandedKMer {
  public:
-  ExpandedKMer(const KMer k, const KMerStat &kmc) {
+  ExpandedKMer(const KMer k, const KMerStat &kmc)
+      : kmer_(k) {
     for (unsigned i = 0; i < hammer::K; ++i) {
       s_[i] = k[i];
       for (unsigned j = 0; j < 4; ++j)
@@ -253,15 +250,8 @@ class ExpandedKMer {
   }
 
   unsigned hamdist(const KMer &k,
-                   unsigned tau = hammer::K) const {
-    unsigned dist = 0;
-    for (unsigned i = 0; i < hammer::K; ++i) {
-      if (s_[i] != k[i]) {
-        ++dist; if (dist > tau) return dist;
-      }
-    }
-
-    return dist;
+                   unsigned /*tau*/ = hammer::K) const {
+    return hamming::distance(kmer_, k);
   }
 
   uint32_t count() const {
@@ -272,10 +262,15 @@ class ExpandedKMer {
     return s_;
   }
 
+  const KMer &kmer() const {
+    return kmer_;
+  }
+
  private:
   double lprobs_[4*hammer::K];
   uint32_t count_;
   ExpandedSeq s_;
+  KMer kmer_;
 };
 
 inline
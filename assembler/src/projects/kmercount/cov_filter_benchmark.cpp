@@ -0,0 +1,191 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+// Throughput of the k-mer coverage filtering on simulated metagenomic reads
+// (a few abundant genomes and a long tail of rare ones): per k-mer CQF
+// insertions and per read median lookups against the batched CQFProcessor and
+// CoverageFilteringReaderWrapper.
+
+#include "io/reads/coverage_filtering_read_wrapper.hpp"
+#include "io/reads/filtering_reader_wrapper.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "utils/kmer_counting.hpp"
+#include "utils/logger/log_writers.hpp"
+#include "utils/verify.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+typedef rolling_hash::SymmetricCyclicHash<> SeqHasher;
+
+static const unsigned K = 31;
+static const unsigned THR = 2;
+static const size_t READ_LENGTH = 150;
+
+// Rolling hashing alone, the lower bound for all the paths
+class NullProcessor {
+public:
+    uint64_t sum = 0;
+
+    void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
+        sum += hash;
+    }
+};
+
+// Per k-mer insertions the batched CQFProcessor replaced
+class UnbatchedCQFProcessor {
+    utils::CQFKmerFilter &cqf_;
+    const unsigned thr_;
+public:
+    UnbatchedCQFProcessor(utils::CQFKmerFilter &cqf, unsigned thr)
+            : cqf_(cqf), thr_(thr) {}
+
+    void ProcessKmer(const RtSeq &/*kmer*/, uint64_t hash) {
+        if (cqf_.lookup(hash) >= thr_)
+            return;
+        cqf_.add(hash, 1, /* lock */ false);
+    }
+};
+
+static std::vector<io::SingleRead> SimulateReads(size_t genome_size, size_t read_cnt, std::mt19937_64 &rng) {
+    std::uniform_int_distribution<int> digit(0, 3);
+    std::uniform_real_distribution<double> unit(0, 1);
+    std::string genome;
+    for (size_t i = 0; i < genome_size; ++i)
+        genome.push_back(nucl(char(digit(rng))));
+
+    // Genome abundances fall geometrically, the first ones get most of the reads
+    const size_t genomes = 16;
+    std::vector<double> weights;
+    for (size_t i = 0; i < genomes; ++i)
+        weights.push_back(std::pow(0.5, double(i)));
+    std::discrete_distribution<size_t> genome_choice(weights.begin(), weights.end());
+    size_t genome_len = genome_size / genomes;
+    std::uniform_int_distribution<size_t> pos(0, genome_len - READ_LENGTH);
+
+    std::vector<io::SingleRead> reads;
+    for (size_t i = 0; i < read_cnt; ++i) {
+        std::string read = genome.substr(genome_choice(rng) * genome_len + pos(rng), READ_LENGTH);
+        for (auto &c : read) {
+            if (unit(rng) < 0.01)
+                c = nucl(char(digit(rng)));
+        }
+        reads.emplace_back("read" + std::to_string(i), read);
+    }
+    return reads;
+}
+
+static void create_console_logger() {
+    using namespace logging;
+
+    logger *lg = create_logger("");
+    lg->add_writer(std::make_shared<console_writer>());
+    attach_logger(lg);
+}
+
+template<class Op>
+static double Measure(Op &&op) {
+    auto start = std::chrono::steady_clock::now();
+    op();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static size_t CountReads(io::ReadStream<io::SingleRead> &stream, size_t &bases) {
+    size_t reads = 0;
+    io::SingleRead r;
+    while (!stream.eof()) {
+        stream >> r;
+        reads += 1;
+        bases += r.size();
+    }
+    return reads;
+}
+
+int main(int argc, char *argv[]) {
+    create_console_logger();
+    size_t read_cnt = (argc > 1 ? std::stoull(argv[1]) : 1000000);
+    size_t genome_size = (argc > 2 ? std::stoull(argv[2]) : 32000000);
+
+    std::mt19937_64 rng(42);
+    std::vector<io::SingleRead> reads = SimulateReads(genome_size, read_cnt, rng);
+    SeqHasher hasher(K);
+    size_t kmers = read_cnt * (READ_LENGTH - K + 1);
+
+    std::cout << std::fixed << std::setprecision(1)
+              << read_cnt << " reads, Kreads/s:" << std::endl;
+
+    double time = Measure([&] {
+        io::VectorReadStream<io::SingleRead> stream(reads);
+        NullProcessor processor;
+        utils::FillFromStream<decltype(stream), SeqHasher, NullProcessor, utils::StoringTypeFilter<utils::SimpleStoring>>(
+                stream, hasher, processor, K);
+        VERIFY(processor.sum);
+    });
+    std::cout << std::setw(24) << "hashing only" << std::setw(10) << double(read_cnt) / time / 1e3 << std::endl;
+
+    utils::CQFKmerFilter unbatched(kmers), batched(kmers), local(1 << 16, batched.hash_bits());
+    time = Measure([&] {
+        io::VectorReadStream<io::SingleRead> stream(reads);
+        UnbatchedCQFProcessor processor(unbatched, THR + 1);
+        utils::FillFromStream<decltype(stream), SeqHasher, UnbatchedCQFProcessor, utils::StoringTypeFilter<utils::SimpleStoring>>(
+                stream, hasher, processor, K);
+    });
+    std::cout << std::setw(24) << "fill, per k-mer" << std::setw(10) << double(read_cnt) / time / 1e3 << std::endl;
+
+    time = Measure([&] {
+        io::VectorReadStream<io::SingleRead> stream(reads);
+        utils::CQFProcessor processor(batched, local, THR + 1);
+        utils::FillFromStream<decltype(stream), SeqHasher, utils::CQFProcessor, utils::StoringTypeFilter<utils::SimpleStoring>>(
+                stream, hasher, processor, K);
+        processor.Flush();
+        batched.merge(local);
+    });
+    std::cout << std::setw(24) << "fill, batched" << std::setw(10) << double(read_cnt) / time / 1e3 << std::endl;
+    {
+        // The counts are capped by the threshold in both the paths
+        io::VectorReadStream<io::SingleRead> stream(reads);
+        io::SingleRead r;
+        while (!stream.eof()) {
+            stream >> r;
+            Sequence s = r.sequence();
+            RtSeq kmer = s.start<RtSeq>(K);
+            for (size_t i = K; ; ++i) {
+                uint64_t hash = hasher.hash(kmer).value();
+                VERIFY_MSG(unbatched.lookup(hash) == batched.lookup(hash), "Batched fill counted different k-mers");
+                if (i == s.size())
+                    break;
+                kmer <<= s[i];
+            }
+        }
+    }
+
+    size_t per_read_cnt = 0, batched_cnt = 0, per_read_bases = 0, batched_bases = 0;
+    time = Measure([&] {
+        io::CoverageFilter<io::SingleRead, SeqHasher> filter(K, hasher, batched, THR);
+        auto stream = io::FilteringWrap<io::SingleRead>(
+                std::make_shared<io::VectorReadStream<io::SingleRead>>(reads),
+                [&](const io::SingleRead &r) { return filter(r); });
+        per_read_cnt = CountReads(*stream, per_read_bases);
+    });
+    std::cout << std::setw(24) << "filter, per read" << std::setw(10) << double(read_cnt) / time / 1e3 << std::endl;
+
+    time = Measure([&] {
+        auto stream = io::CovFilteringWrap<io::SingleRead>(
+                std::make_shared<io::VectorReadStream<io::SingleRead>>(reads),
+                K, hasher, batched, THR);
+        batched_cnt = CountReads(*stream, batched_bases);
+    });
+    std::cout << std::setw(24) << "filter, batched" << std::setw(10) << double(read_cnt) / time / 1e3 << std::endl;
+    VERIFY_MSG(per_read_cnt == batched_cnt && per_read_bases == batched_bases,
+               "Batched filter passed different reads");
+    std::cout << batched_cnt << " reads passed" << std::endl;
+
+    return 0;
+}
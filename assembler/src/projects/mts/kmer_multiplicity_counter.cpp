@@ -1,16 +1,25 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
 #include <algorithm>
+#include <numeric>
+#include <cstdio>
+#include <cstring>
 #include <libcxx/sort.hpp>
-#include <boost/optional/optional.hpp>
+#include <boost/iterator/function_output_iterator.hpp>
 #include "getopt_pp/getopt_pp.h"
 #include "kmc_api/kmc_file.h"
-//#include "omp.h"
+#include "adt/array_vector.hpp"
+#include "adt/loser_tree.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+#include "utils/memory_limit.hpp"
 #include "io/kmers/mmapped_reader.hpp"
 #include "utils/filesystem/path_helper.hpp"
 #include "utils/stl_utils.hpp"
@@ -21,115 +30,217 @@
 using std::string;
 using std::vector;
 
-const string KMER_PARSED_EXTENSION = ".bin";
-const string KMER_SORTED_EXTENSION = ".sorted";
-
+/*
+ * The k-mers of all the samples are routed by hash into partitions, so every
+ * k-mer with all its counts ends up in a single partition. Every partition is
+ * a file of sorted runs, the partitions are merged independently in parallel
+ * straight from the mmapped run files, and the resulting blocks of k-mers and
+ * profiles are appended to the output as soon as they are ready. A k-mer block
+ * and its profile block are appended together, so the order of the k-mers in
+ * the k-mer file is the order of their profiles.
+ *
+ * The partition record is the k-mer followed by a word with the sample number
+ * in the high half and the count in the low half, so after the merge the
+ * records of the same k-mer go one after another, ordered by sample.
+ */
 class KmerMultiplicityCounter {
+    typedef uint16_t Mpl;
+    typedef adt::array_vector<seq_element_type> RecordVector;
+
+    // Upper bound for the size of a partition, which is mmapped during the merge
+    static const size_t kMaxPartitionSize = 512 << 20;
+    // Size of the run buffers of every sample being parsed
+    static const size_t kRunBuffersSize = 64 << 20;
+
+    struct Partition {
+        fs::TmpFile file;
+        std::vector<size_t> runs;
+        std::mutex mutex;
+    };
 
     size_t k_, sample_cnt_;
     std::string file_prefix_;
 
-    //TODO: get rid of intermediate .bin file
-    string ParseKmc(const string& filename) {
+    size_t KmerSize() const {
+        return RtSeq::GetDataSize(k_);
+    }
+
+    size_t RecordSize() const {
+        return KmerSize() + 1;
+    }
+
+    size_t PartitionCount(const std::vector<string>& files, size_t nthreads) const {
+        size_t total = 0;
+        for (const auto &fn : files) {
+            CKMCFile kmcFile;
+            if (!kmcFile.OpenForListing(fn))
+                FATAL_ERROR("Cannot open KMC database " << fn);
+            total += kmcFile.KmerCount();
+            kmcFile.Close();
+        }
+        INFO("Total " << total << " kmers in " << files.size() << " samples");
+
+        // Every thread holds a mmapped partition and the blocks merged from it,
+        // so the partitions being merged take at most a half of the memory limit
+        size_t partition_size = std::min(kMaxPartitionSize, utils::get_memory_limit() / (4 * nthreads));
+        size_t bytes = total * RecordSize() * sizeof(seq_element_type);
+        return std::max(4 * nthreads, (bytes + partition_size - 1) / partition_size);
+    }
+
+    // Sorts the buffered records and appends them to the partition as a run
+    void FlushRun(std::vector<seq_element_type>& buf, Partition& partition) const {
+        size_t cnt = buf.size() / RecordSize();
+        if (!cnt)
+            return;
+
+        RecordVector records(buf.data(), cnt, RecordSize());
+        libcxx::sort(records.begin(), records.end(), adt::array_less<seq_element_type>());
+        {
+            std::lock_guard<std::mutex> lock(partition.mutex);
+            FILE *f = fopen(partition.file->file().c_str(), "ab");
+            if (!f)
+                FATAL_ERROR("Cannot open temporary file " << partition.file->file() << " for writing");
+            size_t res = fwrite(buf.data(), sizeof(seq_element_type), buf.size(), f);
+            if (res != buf.size())
+                FATAL_ERROR("I/O error! Incomplete write! Reason: " << strerror(errno) << ". Error code: " << errno);
+            fclose(f);
+            partition.runs.push_back(cnt);
+        }
+        buf.clear();
+    }
+
+    void ParseKmc(const string& filename, size_t sample, std::vector<Partition>& partitions) const {
+        size_t n = partitions.size();
+        size_t run_size = std::max<size_t>(1024, kRunBuffersSize / n / sizeof(seq_element_type) / RecordSize());
+        std::vector<std::vector<seq_element_type>> bufs(n);
+        for (auto &buf : bufs)
+            buf.reserve(run_size * RecordSize());
+
         CKMCFile kmcFile;
-        kmcFile.OpenForListing(filename);
+        if (!kmcFile.OpenForListing(filename))
+            FATAL_ERROR("Cannot open KMC database " << filename);
         CKmerAPI kmer((unsigned int) k_);
         uint32 count;
-        std::string parsed_filename = filename + KMER_PARSED_EXTENSION;
-        std::ofstream output(parsed_filename, std::ios::binary);
+        std::string kmer_str;
         while (kmcFile.ReadNextKmer(kmer, count)) {
-            RtSeq seq(k_, kmer.to_string());
-            seq.BinWrite(output);
-            seq_element_type tmp = count;
-            output.write((char*) &(tmp), sizeof(seq_element_type));
+            kmer.to_string(kmer_str);
+            RtSeq seq(k_, kmer_str);
+            size_t idx = RtSeq::GetHash(seq.data(), KmerSize()) % n;
+            auto &buf = bufs[idx];
+            buf.insert(buf.end(), seq.data(), seq.data() + KmerSize());
+            buf.push_back(seq_element_type(sample) << 32 | count);
+            if (buf.size() == run_size * RecordSize())
+                FlushRun(buf, partitions[idx]);
         }
-        output.close();
-        return parsed_filename;
-    }
+        kmcFile.Close();
 
-    string SortKmersCountFile(const string& filename) {
-        MMappedRecordArrayReader<seq_element_type> ins(filename, RtSeq::GetDataSize(k_) + 1, false);
-        libcxx::sort(ins.begin(), ins.end(), adt::array_less<seq_element_type>());
-        std::string sorted_filename = filename + KMER_SORTED_EXTENSION;
-        std::ofstream out(sorted_filename);
-        out.write((char*) ins.data(), ins.data_size());
-        out.close();
-        remove(filename.c_str());
-        return sorted_filename;
+        for (size_t i = 0; i < n; ++i)
+            FlushRun(bufs[i], partitions[i]);
     }
 
-    bool ReadKmerWithCount(std::ifstream& infile, std::pair<RtSeq, uint32>& res) {
-        RtSeq seq(res.first.size());
-        if (!seq.BinRead(infile)) {
-            return false;
+    // Merges the runs of the partition and collects the profiles of the k-mers
+    // present in at least all_min samples. The runs are merged right from the
+    // mmapped file, the records of the k-mer are reduced as they come.
+    void MergePartition(Partition& partition, size_t all_min,
+                        std::vector<seq_element_type>& kmers, std::vector<Mpl>& profiles) const {
+        size_t total = std::accumulate(partition.runs.begin(), partition.runs.end(), size_t(0));
+        if (!total)
+            return;
+
+        typedef MMappedRecordArrayReader<seq_element_type> RunFile;
+        size_t rs = RecordSize(), ks = KmerSize();
+        RunFile records(partition.file->file(), rs, /* unlink */ false);
+        VERIFY(records.size() == total);
+
+        std::vector<adt::iterator_range<RunFile::iterator>> ranges;
+        auto beg = records.begin();
+        for (size_t sz : partition.runs) {
+            auto end = std::next(beg, sz);
+            ranges.push_back(adt::make_range(beg, end));
+            beg = end;
         }
-        seq_element_type tmp;
-        infile.read((char*) &tmp, sizeof(seq_element_type));
-        res = {seq, (uint32) tmp};
-        return true;
+
+        const seq_element_type *kmer = nullptr;
+        size_t cnt = 0;
+        std::vector<Mpl> profile(sample_cnt_);
+        auto flush = [&]() {
+            if (cnt >= all_min) {
+                kmers.insert(kmers.end(), kmer, kmer + ks);
+                profiles.insert(profiles.end(), profile.begin(), profile.end());
+            }
+            std::fill(profile.begin(), profile.end(), 0);
+            cnt = 0;
+        };
+        auto reduce = [&](const adt::array_vector<seq_element_type>::reference rec) {
+            const seq_element_type *data = rec.data();
+            if (kmer && !std::equal(kmer, kmer + ks, data))
+                flush();
+            kmer = data;
+            cnt += 1;
+            profile[data[ks] >> 32] += Mpl(data[ks]);
+        };
+
+        adt::loser_tree<RunFile::iterator, adt::array_less<seq_element_type>> tree(ranges);
+        tree.multi_merge(boost::make_function_output_iterator(reduce));
+        flush();
+
+        partition.file.reset();
     }
 
-    fs::TmpFile FilterCombinedKmers(fs::TmpDir workdir, const std::vector<string>& files, size_t all_min) {
-        size_t n = files.size();
-        vector<std::unique_ptr<ifstream>> infiles;
-        infiles.reserve(n);
-        for (auto fn : files) {
-            INFO("Processing " << fn);
-            auto parsed = ParseKmc(fn);
-            auto sorted = SortKmersCountFile(parsed);
-            infiles.emplace_back(new std::ifstream(sorted));
-        }
-        vector<std::pair<RtSeq, uint32>> top_kmer(n, {RtSeq(k_), 0});
-        vector<bool> alive(n, false);
+    fs::TmpFile FilterCombinedKmers(fs::TmpDir workdir, const std::vector<string>& files, size_t all_min, size_t nthreads) {
+        sample_cnt_ = files.size();
+        std::vector<Partition> partitions(PartitionCount(files, nthreads));
+        for (auto &partition : partitions)
+            partition.file = fs::tmp::make_temp_file("part", workdir);
 
-        for (size_t i = 0; i < n; i++) {
-            alive[i] = ReadKmerWithCount(*infiles[i], top_kmer[i]);
+        INFO("Splitting kmers of " << sample_cnt_ << " samples into " << partitions.size() << " partitions");
+#       pragma omp parallel for schedule(dynamic, 1) num_threads(nthreads)
+        for (size_t i = 0; i < sample_cnt_; ++i) {
+            INFO("Processing " << files[i]);
+            ParseKmc(files[i], i, partitions);
         }
 
+        INFO("Merging partitions");
         auto kmer_file = fs::tmp::make_temp_file("kmer", workdir);
-
-        typedef uint16_t Mpl;
         std::ofstream output_kmer(*kmer_file, std::ios::binary);
         std::ofstream mpl_file(file_prefix_ + ".bpr", std::ios_base::binary);
-
-        RtSeq::less3 kmer_less;
-        while (true) {
-            boost::optional<RtSeq> min_kmer;
-            size_t cnt_min = 0;
-            for (size_t i = 0; i < n; ++i) {
-                if (alive[i]) {
-                    RtSeq& cur_kmer = top_kmer[i].first;
-                    if (!min_kmer || kmer_less(cur_kmer, *min_kmer)) {
-                        min_kmer = cur_kmer;
-                        cnt_min = 0;
-                    }
-                    if (cur_kmer == *min_kmer) {
-                        cnt_min++;
-                    }
-                }
-            }
-            if (!min_kmer) {
-                break;
+        // Partitions are written in the index order, so the output does not depend
+        // on the scheduling. Merging does not run ahead of the next partition to
+        // write by more than the window, which bounds the memory for the finished ones.
+        typedef std::pair<std::vector<seq_element_type>, std::vector<Mpl>> MergedPartition;
+        const size_t window = 2 * nthreads;
+        std::map<size_t, MergedPartition> finished;
+        size_t next_to_write = 0;
+        std::mutex output_mutex;
+        std::condition_variable output_cv;
+        size_t kmer_cnt = 0;
+#       pragma omp parallel for schedule(dynamic, 1) num_threads(nthreads)
+        for (size_t i = 0; i < partitions.size(); ++i) {
+            {
+                std::unique_lock<std::mutex> lock(output_mutex);
+                output_cv.wait(lock, [&]() { return i < next_to_write + window; });
             }
-            if (cnt_min >= all_min) {
-                std::vector<uint32> cnt_vector(n, 0);
-                min_kmer.get().BinWrite(output_kmer);
-                for (size_t i = 0; i < n; ++i) {
-                    if (alive[i] && top_kmer[i].first == *min_kmer) {
-                        cnt_vector[i] += top_kmer[i].second;
-                    }
-                }
-
-                for (size_t mpl : cnt_vector) {
-                    mpl_file.write(reinterpret_cast<char *>(&mpl), sizeof(Mpl));
-                }
-            }
-            for (size_t i = 0; i < n; ++i) {
-                if (alive[i] && top_kmer[i].first == *min_kmer) {
-                    alive[i] = ReadKmerWithCount(*infiles[i], top_kmer[i]);
-                }
+
+            MergedPartition merged;
+            MergePartition(partitions[i], all_min, merged.first, merged.second);
+
+            std::lock_guard<std::mutex> lock(output_mutex);
+            finished.emplace(i, std::move(merged));
+            while (!finished.empty() && finished.begin()->first == next_to_write) {
+                const auto &kmers = finished.begin()->second.first;
+                const auto &profiles = finished.begin()->second.second;
+                output_kmer.write((const char*) kmers.data(), kmers.size() * sizeof(seq_element_type));
+                mpl_file.write((const char*) profiles.data(), profiles.size() * sizeof(Mpl));
+                kmer_cnt += kmers.size() / KmerSize();
+                finished.erase(finished.begin());
+                ++next_to_write;
             }
+            output_cv.notify_all();
         }
+        VERIFY(finished.empty() && next_to_write == partitions.size());
+        VERIFY_MSG(!output_kmer.fail() && !mpl_file.fail(), "Failed to write kmer profiles");
+        INFO("Saved profiles of " << kmer_cnt << " kmers");
+
         return kmer_file;
     }
 
@@ -180,7 +291,7 @@ public:
 
     void CombineMultiplicities(const vector<string>& input_files, size_t min_samples, const string& tmpdir, size_t nthreads = 1) {
         auto workdir = fs::tmp::make_temp_dir(tmpdir, "kmidx");
-        auto kmer_file = FilterCombinedKmers(workdir, input_files, min_samples);
+        auto kmer_file = FilterCombinedKmers(workdir, input_files, min_samples, nthreads);
         BuildKmerIndex(workdir, kmer_file, input_files.size(), nthreads);
     }
 private:
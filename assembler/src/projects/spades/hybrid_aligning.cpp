@@ -199,7 +199,7 @@ class PacbioAligner {
         size_t aligned = 0;
         size_t nontrivial_aligned = 0;
 
-        #pragma omp parallel for reduction(+: longer_500, aligned, nontrivial_aligned)
+        #pragma omp parallel for num_threads(thread_cnt) reduction(+: longer_500, aligned, nontrivial_aligned)
         for (size_t i = 0; i < reads.size(); ++i) {
             size_t thread_num = omp_get_thread_num();
             DEBUG(reads[i].name());
@@ -293,7 +293,7 @@ void PacbioAlignLibrary(const conj_graph_pack& gp,
 
     // Initialize index
     pacbio::PacBioMappingIndex<Graph> pac_index(gp.g, pb,
-                                                mode);
+                                                mode, thread_cnt);
 
     PacbioAligner aligner(pac_index, path_storage, gap_storage);
 
@@ -25,6 +25,10 @@
 #include "pipeline/stage.hpp"
 #include "contig_output_stage.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
 namespace spades {
 
 inline bool MetaCompatibleLibraries() {
@@ -47,7 +51,9 @@ inline bool HybridLibrariesPresent() {
     return false;
 }
 
-void assemble_genome() {
+// Contigs of the previous K are taken from and the simplified contigs of a non-main
+// iteration are stored to *iteration_contigs if given
+void assemble_genome(std::vector<io::SingleRead> *iteration_contigs = nullptr) {
     INFO("SPAdes started");
     if (cfg::get().mode == debruijn_graph::config::pipeline_type::meta && !MetaCompatibleLibraries()) {
         ERROR("Sorry, current version of metaSPAdes can work either with single library (paired-end only) "
@@ -60,6 +66,7 @@ void assemble_genome() {
     StageManager SPAdes({cfg::get().developer_mode,
                          cfg::get().load_from,
                          cfg::get().output_saves});
+    SPAdes.profiler().set_report(fs::append_path(cfg::get().output_dir, "stage_profile.json"));
 
     bool two_step_rr = cfg::get().two_step_rr && cfg::get().rr_enable;
     INFO("Two-step RR enabled: " << two_step_rr);
@@ -78,7 +85,10 @@ void assemble_genome() {
     }
 
     // Build the pipeline
-    SPAdes.add<debruijn_graph::Construction>();
+    if (iteration_contigs)
+        SPAdes.add<debruijn_graph::Construction>(std::move(*iteration_contigs));
+    else
+        SPAdes.add<debruijn_graph::Construction>();
 
     if (cfg::get().mode != debruijn_graph::config::pipeline_type::meta)
         SPAdes.add<debruijn_graph::GenomicInfoFiller>();
@@ -146,7 +156,144 @@ void assemble_genome() {
     // For informing spades.py about estimated params
     debruijn_graph::config::write_lib_data(fs::append_path(cfg::get().output_dir, "final"));
 
+    if (iteration_contigs) {
+        iteration_contigs->clear();
+        if (!cfg::get().main_iteration) {
+            const auto &g = conj_gp.g;
+            for (auto it = g.ConstEdgeBegin(true); !it.IsEnd(); ++it)
+                iteration_contigs->emplace_back(std::to_string(g.int_id(*it)), g.EdgeNucls(*it).str());
+        }
+    }
+
     INFO("SPAdes finished");
 }
 
+inline void CheckK(size_t K) {
+    VERIFY(K >= runtime_k::MIN_K && K < runtime_k::MAX_K);
+    VERIFY(K % 2 != 0);
+}
+
+inline std::string KListStr(const std::vector<size_t> &ks) {
+    std::string res;
+    for (size_t K : ks)
+        res += (res.empty() ? "" : ", ") + std::to_string(K);
+    return "[" + res + "]";
+}
+
+// Same as update_k_mers_in_special_cases of spades.py
+inline std::vector<size_t> UpdateKMersInSpecialCases(const debruijn_graph::config::debruijn_config &config,
+                                                     const std::vector<size_t> &ks, size_t RL) {
+    if (RL >= 250 && !config.iterative_K_250.empty()) {
+        INFO("Default k-mer sizes were set to " << KListStr(config.iterative_K_250) << " because estimated "
+             "read length (" << RL << ") is equal to or greater than 250");
+        return config.iterative_K_250;
+    }
+    if (RL >= 150 && !config.iterative_K_150.empty()) {
+        INFO("Default k-mer sizes were set to " << KListStr(config.iterative_K_150) << " because estimated "
+             "read length (" << RL << ") is equal to or greater than 150");
+        return config.iterative_K_150;
+    }
+    if (RL <= ks.back()) {
+        std::vector<size_t> res;
+        std::copy_if(ks.begin(), ks.end(), std::back_inserter(res), [&](size_t K) { return K < RL; });
+        INFO("K-mer sizes were set to " << KListStr(res) << " because estimated "
+             "read length (" << RL << ") is less than " << ks.back());
+        return res;
+    }
+    return ks;
+}
+
+// Runs the iterations for iterative_K the way spades.py does, but in one process.
+// The loaded config, the statistics of the binary reads and the OpenMP threads are
+// reused and the simplified contigs are passed to the next K in memory.
+inline void assemble_iterative_K() {
+    auto base = cfg::get();
+    std::vector<size_t> ks = base.iterative_K;
+    std::sort(ks.begin(), ks.end());
+    VERIFY(ks.size() > 1);
+    for (auto *special : { &base.iterative_K_150, &base.iterative_K_250 }) {
+        std::sort(special->begin(), special->end());
+        VERIFY(special->empty() || special->front() == ks.front());
+    }
+    for (auto *list : { &ks, &base.iterative_K_150, &base.iterative_K_250 })
+        for (size_t K : *list)
+            CheckK(K);
+
+    // Relative tmp_dir was resolved against the output dir of the first K, it
+    // is resolved against the output dir of every K instead
+    std::string tmp_dir = base.tmp_dir;
+    bool relative_tmp_dir = (tmp_dir.compare(0, base.output_dir.size(), base.output_dir) == 0);
+    if (relative_tmp_dir)
+        tmp_dir = tmp_dir.substr(base.output_dir.size());
+
+    std::vector<io::SingleRead> contigs;
+    auto run_iteration = [&](size_t K, bool last_one) {
+        auto &config = cfg::get_writable();
+        config = base;
+        config.K = K;
+        config.main_iteration = last_one;
+        config.use_additional_contigs = !contigs.empty();
+        config.gap_closer_enable = base.gap_closer_enable && (last_one || K >= 55);
+        config.rr_enable = base.rr_enable && last_one;
+        config.correct_mismatches = base.correct_mismatches && last_one;
+        config.need_mapping = config.developer_mode || config.correct_mismatches
+                              || config.gap_closer_enable || config.rr_enable;
+        config.output_dir = config.output_base + "/K" + std::to_string(K) + "/";
+        config.output_saves = config.output_dir + "saves/";
+        config.load_from = config.output_saves;
+        if (relative_tmp_dir)
+            config.tmp_dir = config.output_dir + tmp_dir;
+        fs::make_dir(config.output_dir);
+        fs::make_dir(config.tmp_dir);
+        if (config.developer_mode)
+            fs::make_dir(config.output_saves);
+
+        INFO("Running iteration with K=" << K << (last_one ? " (main iteration)" : ""));
+        assemble_genome(&contigs);
+
+        // Binary reads are not converted and their statistics are not reread for the next K
+        auto &reads = cfg::get_writable().ds.reads;
+        for (size_t i = 0; i < reads.lib_count(); ++i) {
+            const auto &data = reads[i].data();
+            auto &base_data = base.ds.reads[i].data();
+            base_data.binary_reads_info = data.binary_reads_info;
+            base_data.unmerged_read_length = data.unmerged_read_length;
+            base_data.merged_read_length = data.merged_read_length;
+            base_data.read_count = data.read_count;
+            base_data.total_nucls = data.total_nucls;
+        }
+    };
+
+    size_t first_K = ks.front();
+    run_iteration(first_K, false);
+    // spades.py takes the read length from final.lib_data
+    size_t RL = cfg::get().ds.no_merge_RL;
+    ks = UpdateKMersInSpecialCases(base, ks, RL);
+    if (ks.size() < 2 || ks[1] + 1 > RL) {
+        if (base.rr_enable) {
+            if (ks.size() < 2) {
+                INFO("== Rerunning for the first value of K (" << first_K << ") with Repeat Resolving");
+            } else {
+                WARN("Second value of iterative K (" << ks[1] << ") exceeded estimated read length (" << RL << "). "
+                     "Rerunning for the first value of K (" << first_K << ") with Repeat Resolving");
+            }
+            contigs.clear();
+            run_iteration(first_K, true);
+        }
+        return;
+    }
+
+    std::vector<size_t> rest(ks.begin() + 1, ks.end());
+    size_t count = 0;
+    for (size_t K : rest) {
+        count += 1;
+        bool last_one = count == rest.size() || rest[count] + 1 > RL;
+        run_iteration(K, last_one);
+        if (last_one)
+            break;
+    }
+    if (count < rest.size())
+        WARN("Iterations stopped. Value of K (" << rest[count] << ") exceeded estimated read length (" << RL << ")");
+}
+
 }
@@ -89,7 +89,10 @@ int main(int argc, char **argv) {
         INFO("Assembling dataset (" << cfg::get().dataset_file << ") with K=" << cfg::get().K);
         INFO("Maximum # of threads to use (adjusted due to OMP capabilities): " << cfg::get().max_threads);
 
-        spades::assemble_genome();
+        if (cfg::get().iterative_K.size() > 1)
+            spades::assemble_iterative_K();
+        else
+            spades::assemble_genome();
 
     } catch (std::bad_alloc const &e) {
         std::cerr << "Not enough memory to run SPAdes. " << e.what() << std::endl;
@@ -303,7 +303,8 @@ static void ProcessPairedReads(conj_graph_pack &gp,
 
     LatePairedIndexFiller pif(gp.g,
                               weight, round_thr,
-                              gp.paired_indices[ilib]);
+                              gp.paired_indices[ilib],
+                              cfg::get().de.flat_paired_buffer);
     notifier.Subscribe(ilib, &pif);
 
     auto paired_streams = paired_binary_readers(reads, /*followed by rc*/false, (size_t) data.mean_insert_size,
@@ -89,6 +89,7 @@ cov_cutoff = 'off'  # default is 'off'
 
 # hidden options
 save_gp = False
+single_process_k = False
 mismatch_corrector = None
 reference = None
 series_analysis = None
@@ -143,7 +144,7 @@ long_options = "12= merged= threads= memory= tmp-dir= iterations= phred-offset=
                "disable-gzip-output disable-gzip-output:false disable-rr disable-rr:false " \
                "help version test debug debug:false reference= series-analysis= config-file= dataset= "\
                "bh-heap-check= spades-heap-check= read-buffer-size= help-hidden "\
-               "mismatch-correction mismatch-correction:false careful careful:false save-gp save-gp:false "\
+               "mismatch-correction mismatch-correction:false careful careful:false save-gp save-gp:false single-process-k "\
                "continue restart-from= diploid truseq cov-cutoff= hidden-cov-cutoff= read-cov-threshold= " \
                "configs-dir= stop-after=".split()
 short_options = "o:1:2:s:k:t:m:i:hv"
@@ -353,6 +354,7 @@ def usage(spades_version, show_hidden=False, mode=None):
                              " for SPAdes" + "\n")
         sys.stderr.write("--large-genome\tEnables optimizations for large genomes \n")
         sys.stderr.write("--save-gp\tEnables saving graph pack before repeat resolution (even without --debug) \n")
+        sys.stderr.write("--single-process-k\tRuns all k-mer iterations in one process \n")
         sys.stderr.write("--hidden-cov-cutoff\t<float>\t\tcoverage cutoff value deeply integrated in simplification"\
                             " (a positive float number). Base coverage! Will be adjusted depending on K and RL! \n")
         sys.stderr.write("--read-cov-threshold\t<int>\t\tread median coverage threshold (non-negative integer)\n")
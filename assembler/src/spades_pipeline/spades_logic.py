@@ -161,7 +161,7 @@ def add_configs(command, configs_dir):
         command.append(os.path.join(configs_dir, "rna_fast_mode.info"))
     
 
-def run_iteration(configs_dir, execution_home, cfg, log, K, prev_K, last_one):
+def run_iteration(configs_dir, execution_home, cfg, log, K, prev_K, last_one, iterative_K=None):
     data_dir = os.path.join(cfg.output_dir, "K%d" % K)
     stage = BASE_STAGE
     saves_dir = os.path.join(data_dir, 'saves')
@@ -212,6 +212,18 @@ def run_iteration(configs_dir, execution_home, cfg, log, K, prev_K, last_one):
 
     add_configs(command, dst_configs)
 
+    if iterative_K:
+        # spades-core runs all the iterations itself starting from K
+        iterative_K_fn = os.path.join(dst_configs, "iterative_K.info")
+        iterative_K_file = open(iterative_K_fn, "w")
+        iterative_K_file.write("iterative_K \"%s\"\n" % " ".join(map(str, iterative_K)))
+        if options_storage.auto_K_allowed():
+            # update_k_mers_in_special_cases is applied by spades-core
+            iterative_K_file.write("iterative_K_150 \"%s\"\n" % " ".join(map(str, options_storage.K_MERS_150)))
+            iterative_K_file.write("iterative_K_250 \"%s\"\n" % " ".join(map(str, options_storage.K_MERS_250)))
+        iterative_K_file.close()
+        command.append(iterative_K_fn)
+
     #print("Calling: " + " ".join(command))
     support.sys_call(command, log)
 
@@ -305,7 +317,22 @@ def run_spades(configs_dir, execution_home, cfg, dataset_data, ext_python_module
 
     finished_on_stop_after = False
     K = cfg.iterative_K[0]
-    if len(cfg.iterative_K) == 1:
+    if "single_process_k" in cfg.__dict__ and cfg.single_process_k \
+            and len(cfg.iterative_K) > 1 \
+            and not options_storage.continue_mode \
+            and not (options_storage.stop_after and options_storage.stop_after.startswith('k')):
+        all_K = set(cfg.iterative_K)
+        if options_storage.auto_K_allowed():
+            all_K |= set(options_storage.K_MERS_150 + options_storage.K_MERS_250)
+        all_K = sorted(all_K)
+        for k in all_K[1:]:
+            if os.path.exists(os.path.join(cfg.output_dir, "K%d" % k)):
+                shutil.rmtree(os.path.join(cfg.output_dir, "K%d" % k))
+        run_iteration(configs_dir, execution_home, cfg, log, K, None, True, cfg.iterative_K)
+        used_K = [k for k in all_K
+                  if os.path.isfile(os.path.join(cfg.output_dir, "K%d" % k, "final_contigs.fasta"))]
+        K = used_K[-1]
+    elif len(cfg.iterative_K) == 1:
         run_iteration(configs_dir, execution_home, cfg, log, K, None, True)
         used_K.append(K)
     else:
@@ -0,0 +1,67 @@
+#!/bin/bash
+
+############################################################################
+# Copyright (c) 2017 Saint Petersburg State University
+# All Rights Reserved
+# See file LICENSE for details.
+############################################################################
+
+# Checks that the mismatch corrector produces the same contigs in the
+# streaming mode and with the SAM files split by contig. bwa is replaced
+# by a script printing the alignments of the fixture.
+
+if [ "$#" -ne 1 ]; then
+    echo "Usage: streaming_test.sh <spades-corrector-core>"
+    exit 1
+fi
+
+set -e
+
+corrector=$(readlink -f $1)
+data_dir=$(cd $(dirname $0)/data && pwd)
+work_dir=$(mktemp -d)
+trap "rm -rf $work_dir" EXIT
+
+cat > $work_dir/bwa <<END
+#!/bin/bash
+if [ "\$1" == "mem" ]; then
+    cat $data_dir/alignments.sam
+fi
+END
+chmod +x $work_dir/bwa
+
+cat > $work_dir/dataset.yaml <<END
+- left reads: [$data_dir/../../../../test_dataset/ecoli_1K_1.fq.gz]
+  orientation: fr
+  right reads: [$data_dir/../../../../test_dataset/ecoli_1K_2.fq.gz]
+  type: paired-end
+END
+
+for streaming in true false; do
+    mkdir -p $work_dir/$streaming
+    cp $data_dir/contigs.fasta $work_dir/$streaming/
+    cat > $work_dir/$streaming/corrector.info <<END
+{
+dataset: $work_dir/dataset.yaml,
+work_dir: $work_dir/$streaming/tmp,
+output_dir: $work_dir/$streaming/corrected,
+max_nthreads: 4,
+strategy: mapped_squared,
+bwa: $work_dir/bwa,
+streaming: $streaming,
+log_filename: log.properties
+}
+END
+    $corrector $work_dir/$streaming/corrector.info $work_dir/$streaming/contigs.fasta > $work_dir/$streaming/log.txt 2>&1
+done
+
+if ! diff -r -q $work_dir/true/corrected $work_dir/false/corrected -x tmp; then
+    echo "Streaming and split corrector outputs differ"
+    exit 2
+fi
+# Comparison is meaningless if the fixture leads to no corrections
+if diff $data_dir/contigs.fasta $work_dir/true/corrected/*.fasta > /dev/null; then
+    echo "No corrections were made"
+    exit 3
+fi
+echo "Streaming and split corrector outputs are the same"
@@ -10,6 +10,11 @@
 #include <boost/test/unit_test.hpp>
 
 #include "test_utils.hpp"
+#include "pipeline/graphio.hpp"
+#include "assembly_graph/dijkstra/dijkstra_helper.hpp"
+#include "utils/kmer_mph/super_kmer_splitter.hpp"
+
+#include <random>
 
 namespace debruijn_graph {
 
@@ -170,6 +175,16 @@ BOOST_AUTO_TEST_CASE( TestKmerFreeIndex ) {
     CheckIndex<conj_graph_pack>(reads, 5);
 }
 
+BOOST_AUTO_TEST_CASE( TestIndexSaveLoad ) {
+    vector<string> reads = { "CGAAACCAC", "CGAAAACAC", "AACCACACC", "AAACACACC" };
+    CheckIndexSaveLoad<conj_graph_pack>(reads, 5);
+}
+
+BOOST_AUTO_TEST_CASE( TestReadMapping ) {
+    vector<string> reads = { "CGAAACCACACC", "CGAAAACACACC" };
+    CheckReadMapping<conj_graph_pack>(reads, 5);
+}
+
 //BOOST_AUTO_TEST_CASE( TestStrange ) {
 //    vector<string> reads = {"TTCTGCATGGTTATGCATAACCATGCAGAA", "ACACACACTGGGGGTCCCTTTTGGGGGGGGTTTTTTTTG"};
 //    typedef VectorStream<SingleRead> RawStream;
@@ -228,6 +243,310 @@ BOOST_AUTO_TEST_CASE( TestSelfRCEdgeMerge ) {
     BOOST_CHECK_EQUAL(Sequence("AACGCTATTCACGTGAATAGCGTT"), g.EdgeNucls(g.GetUniqueOutgoingEdge(v1)));
 }
 
+template<class Index>
+void CheckSamePairedInfo(const Graph &g, const Index &pi,
+                         const std::map<size_t, EdgeId> &loaded_edges, const Index &loaded_pi) {
+    BOOST_CHECK_EQUAL(pi.size(), loaded_pi.size());
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        EdgeId e1 = *it;
+        for (auto entry : pi.Get(e1)) {
+            auto hist = entry.second.Unwrap();
+            auto loaded_hist = loaded_pi.Get(loaded_edges.at(e1.int_id()), loaded_edges.at(entry.first.int_id())).Unwrap();
+            BOOST_REQUIRE_EQUAL(hist.size(), loaded_hist.size());
+            for (auto p = hist.begin(), q = loaded_hist.begin(); p != hist.end(); ++p, ++q) {
+                BOOST_CHECK_EQUAL(float(p->d), float(q->d));
+                BOOST_CHECK_EQUAL(float(p->weight), float(q->weight));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestBinaryCheckpoint ) {
+    Graph g(55);
+    graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", g);
+    omnigraph::de::UnclusteredPairedInfoIndexT<Graph> pi(g);
+    omnigraph::de::PairedInfoIndexT<Graph> clustered(g);
+    EdgeId prev;
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        EdgeId e = *it;
+        if (prev != EdgeId()) {
+            pi.Add(prev, e, omnigraph::de::RawPoint(100, 1.5));
+            // Not representable in the text format
+            clustered.Add(prev, e, omnigraph::de::Point(120.123f, 2.00001f, 5.5f));
+        }
+        pi.Add(e, g.conjugate(e), omnigraph::de::RawPoint(50, 1));
+        prev = e;
+    }
+
+    graphio::ConjugateDataPrinter<Graph> printer(g);
+    printer.set_binary(true);
+    graphio::PrintBasicGraph("tmp/saves", printer);
+    printer.SavePaired("tmp/saves", pi);
+    printer.SavePaired("tmp/saves_cl", clustered);
+
+    size_t max_id = 0;
+    std::ifstream gid("tmp/saves.gid");
+    BOOST_REQUIRE(gid >> max_id);
+    BOOST_CHECK_EQUAL(max_id, g.GetGraphIdDistributor().GetMax());
+
+    Graph loaded(55);
+    omnigraph::de::UnclusteredPairedInfoIndexT<Graph> loaded_pi(loaded);
+    omnigraph::de::PairedInfoIndexT<Graph> loaded_clustered(loaded);
+    graphio::ConjugateDataScanner<Graph> scanner(loaded);
+    graphio::ScanBasicGraph<Graph>("tmp/saves", scanner);
+    scanner.LoadPaired("tmp/saves", loaded_pi);
+    scanner.LoadPaired("tmp/saves_cl", loaded_clustered);
+
+    std::map<size_t, EdgeId> loaded_edges;
+    for (auto it = loaded.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        loaded_edges[(*it).int_id()] = *it;
+    BOOST_CHECK_EQUAL(g.size(), loaded.size());
+    for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        EdgeId e = *it;
+        BOOST_REQUIRE(loaded_edges.count(e.int_id()));
+        EdgeId le = loaded_edges.at(e.int_id());
+        BOOST_CHECK_EQUAL(g.EdgeNucls(e), loaded.EdgeNucls(le));
+        BOOST_CHECK_EQUAL(g.coverage(e), loaded.coverage(le));
+        BOOST_CHECK_EQUAL(g.conjugate(e).int_id(), loaded.conjugate(le).int_id());
+        BOOST_CHECK_EQUAL(g.EdgeStart(e).int_id(), loaded.EdgeStart(le).int_id());
+        BOOST_CHECK_EQUAL(g.EdgeEnd(e).int_id(), loaded.EdgeEnd(le).int_id());
+    }
+
+    CheckSamePairedInfo(g, pi, loaded_edges, loaded_pi);
+    CheckSamePairedInfo(g, clustered, loaded_edges, loaded_clustered);
+}
+
+BOOST_AUTO_TEST_CASE( TestParallelEmptiedChunkReuse ) {
+    typedef omnigraph::ElementStorage<std::pair<size_t, size_t>> Storage;
+    const size_t n = Storage::ChunkSize;
+    Storage storage;
+
+    // Chunk emptied in parallel is released at the next sequential create
+    for (size_t id = 0; id < n; ++id) {
+        storage.create(id, id, id);
+        storage.attach(id);
+    }
+    auto *slot = storage.get(0);
+#   pragma omp parallel for num_threads(4)
+    for (size_t id = 0; id < n; ++id)
+        storage.destroy(id);
+    BOOST_CHECK_EQUAL(storage.size(), 0u);
+    storage.create(3 * n, 0, 0);
+    BOOST_CHECK_EQUAL(storage.get(3 * n), slot);
+
+    // Or explicitly
+    for (size_t id = 3 * n + 1; id < 4 * n; ++id)
+        storage.create(id, id, id);
+#   pragma omp parallel for num_threads(4)
+    for (size_t id = 3 * n; id < 4 * n; ++id)
+        storage.destroy(id);
+    storage.ReleaseEmptyChunks();
+    storage.create(5 * n, 0, 0);
+    BOOST_CHECK_EQUAL(storage.get(5 * n), slot);
+    BOOST_CHECK(storage.begin() == storage.end());
+}
+
+BOOST_AUTO_TEST_CASE( TestFlatBoundedDijkstra ) {
+    Graph g(55);
+    graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", g);
+    typedef omnigraph::DijkstraHelper<Graph> Helper;
+    //Flat one is reused for all the runs
+    auto flat_dijkstra = Helper::CreateFlatBoundedDijkstra(g, 5000, 20);
+    for (VertexId v : g) {
+        auto dijkstra = Helper::CreateBoundedDijkstra(g, 5000, 20);
+        dijkstra.Run(v);
+        flat_dijkstra.Run(v);
+        for (VertexId u : g) {
+            BOOST_REQUIRE_EQUAL(dijkstra.DistanceCounted(u), flat_dijkstra.DistanceCounted(u));
+            if (dijkstra.DistanceCounted(u))
+                BOOST_CHECK_EQUAL(dijkstra.GetDistance(u), flat_dijkstra.GetDistance(u));
+        }
+    }
+}
+
+template<class graph_pack>
+void CheckIndexMatchesGraph(const graph_pack &gp) {
+    size_t k = gp.index.k();
+    for (auto it = gp.g.ConstEdgeBegin(); !it.IsEnd(); ++it) {
+        Sequence nucls = gp.g.EdgeNucls(*it);
+        for (size_t i = 0; i + k <= nucls.size(); ++i) {
+            auto pos = gp.index.get(nucls.Subseq(i, i + k).start<RtSeq>(k));
+            BOOST_CHECK_EQUAL(*it, pos.first);
+            BOOST_CHECK_EQUAL(i, pos.second);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestBatchedIndexUpdate ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    vector<string> reads = { "CGAAACCAC", "CGAAAACAC", "AACCACACC", "AAACACACC" };
+    conj_graph_pack gp(5, "tmp", 0);
+    auto workdir = fs::tmp::make_temp_dir(gp.workdir, "tests");
+    io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads))));
+    ConstructGraph(config::debruijn_config::construction(), workdir, streams, gp.g, gp.index);
+
+    EdgeId to_delete;
+    for (auto it = gp.g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        if (gp.g.EdgeNucls(*it) == Sequence("CGAAACCACAC"))
+            to_delete = *it;
+    BOOST_REQUIRE(to_delete != EdgeId());
+    RtSeq deleted_kmer = Sequence("AAACCA").start<RtSeq>(6);
+    {
+        omnigraph::ModificationBatch<Graph> batch(gp.g);
+        gp.g.DeleteEdge(to_delete);
+        for (auto it = gp.g.SmartVertexBegin(); !it.IsEnd(); ++it)
+            gp.g.CompressVertex(*it);
+        //index is updated at the end of the batch
+        BOOST_CHECK(gp.index.contains(deleted_kmer));
+    }
+    size_t edges = 0;
+    for (auto it = gp.g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+        ++edges;
+    BOOST_CHECK_EQUAL(2u, edges);
+    BOOST_CHECK(!gp.index.contains(deleted_kmer));
+    CheckIndexMatchesGraph(gp);
+}
+
+BOOST_AUTO_TEST_CASE( TestBatchedVertexDeletion ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    vector<string> reads = { "CGAAACCAC", "CGAAAACAC", "AACCACACC", "AAACACACC" };
+    RtSeq deleted_kmer = Sequence("AAACCA").start<RtSeq>(6);
+    for (bool attached : { true, false }) {
+        conj_graph_pack gp(5, "tmp", 0);
+        auto workdir = fs::tmp::make_temp_dir(gp.workdir, "tests");
+        io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads))));
+        ConstructGraph(config::debruijn_config::construction(), workdir, streams, gp.g, gp.index);
+        if (!attached)
+            gp.index.Detach();
+
+        {
+            //deleted edges still refer to the deleted vertices until the end of the batch
+            omnigraph::ModificationBatch<Graph> batch(gp.g);
+            for (auto it = gp.g.SmartEdgeBegin(); !it.IsEnd(); ++it)
+                gp.g.DeleteEdge(*it);
+            for (auto it = gp.g.SmartVertexBegin(); !it.IsEnd(); ++it)
+                gp.g.DeleteVertex(*it);
+        }
+        BOOST_CHECK_EQUAL(0u, gp.g.size());
+        if (attached)
+            BOOST_CHECK(!gp.index.contains(deleted_kmer));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestBatchedIndexLookup ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    vector<string> reads = { "CGAAACCACAGTTACG", "CGAAAACACTTGACCA", "AACCACACCGGTAACA", "AAACACACCTTTGACA" };
+    conj_graph_pack gp(5, "tmp", 0);
+    auto workdir = fs::tmp::make_temp_dir(gp.workdir, "tests");
+    io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads))));
+    ConstructGraph(config::debruijn_config::construction(), workdir, streams, gp.g, gp.index);
+
+    // Both the k-mers of the graph and the absent ones
+    const auto &index = gp.index.inner_index();
+    vector<RtSeq> kmers;
+    for (const string &read : reads) {
+        Sequence seq(read);
+        for (size_t i = 0; i + index.k() <= seq.size(); ++i)
+            kmers.push_back(seq.Subseq(i, i + index.k()).start<RtSeq>(index.k()));
+    }
+    for (size_t i = 0; i < 64; ++i) {
+        string kmer;
+        for (size_t j = 0; j < index.k(); ++j)
+            kmer.push_back("ACGT"[(i * 7 + j * 5 + j * j) % 4]);
+        kmers.push_back(Sequence(kmer).start<RtSeq>(index.k()));
+    }
+
+    vector<decltype(index.ConstructKWH(kmers[0]))> kwhs;
+    vector<EdgeInfo<EdgeId>> values;
+    index.ConstructKWH(kmers, kwhs);
+    index.get_values(kwhs, values);
+    BOOST_REQUIRE_EQUAL(kmers.size(), kwhs.size());
+    BOOST_REQUIRE_EQUAL(kmers.size(), values.size());
+    for (size_t i = 0; i < kmers.size(); ++i) {
+        auto kwh = index.ConstructKWH(kmers[i]);
+        BOOST_CHECK_EQUAL(kwh.idx(), kwhs[i].idx());
+        BOOST_CHECK_EQUAL(kwh.is_minimal(), kwhs[i].is_minimal());
+        BOOST_CHECK_EQUAL(index.contains(kwh), index.contains(kwhs[i]));
+        if (index.valid(kwh)) {
+            BOOST_CHECK_EQUAL(index.get_value(kwh).edge_id, values[i].edge_id);
+            BOOST_CHECK_EQUAL(index.get_value(kwh).offset, values[i].offset);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestKMersFromKPOMers ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    typedef utils::StoringTypeFilter<utils::InvertableStoring> KmerFilter;
+    vector<string> reads = { "CGAAACCACAGTTACG", "CGAAAACACTTGACCA", "AACCACACCGGTAACA", "AAACACACCTTTGACA" };
+    unsigned k = 5;
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads))));
+
+    utils::DeBruijnReadKMerSplitter<io::SingleRead, KmerFilter> splitter(workdir, k + 1, 0xDEADBEEF, streams);
+    utils::KMerInMemoryCounter<RtSeq> kpomers(workdir, splitter);
+    kpomers.CountAll(2, 2, /* merge */ false);
+
+    utils::DeBruijnKMerKMerSplitter<KmerFilter> kmer_splitter(workdir, k, k + 1, true);
+    for (unsigned i = 0; i < kpomers.num_buckets(); ++i)
+        kmer_splitter.AddKMers(kpomers.GetBucket(i, /* unlink */ false));
+    utils::KMerInMemoryCounter<RtSeq> expected(workdir, kmer_splitter);
+    expected.Count(4, 2);
+
+    utils::DeBruijnKMerKMerCounter<KmerFilter> counter(workdir, k, kpomers, true);
+    BOOST_CHECK_EQUAL(expected.kmers(), counter.Count(4, 2));
+    for (unsigned i = 0; i < 4; ++i) {
+        auto bucket = counter.GetBucket(i), expected_bucket = expected.GetBucket(i);
+        BOOST_REQUIRE_EQUAL(expected_bucket->data_size(), bucket->data_size());
+        BOOST_CHECK(!memcmp(expected_bucket->data(), bucket->data(), bucket->data_size()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE( TestSuperKMerSplitting ) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    typedef utils::StoringTypeFilter<utils::InvertableStoring> KmerFilter;
+    unsigned k = 21;
+    // Random reads and the low-complexity ones
+    std::mt19937 rnd(42);
+    vector<string> reads;
+    for (size_t i = 0; i < 200; ++i) {
+        string read;
+        for (size_t j = 0; j < 100; ++j)
+            read.push_back("ACGT"[rnd() % 4]);
+        reads.push_back(read);
+    }
+    reads.push_back(string(100, 'A'));
+    reads.push_back(string(50, 'A') + reads[0].substr(0, 50));
+    auto workdir = fs::tmp::make_temp_dir("tmp", "tests");
+    io::ReadStreamList<io::SingleRead> streams(io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads))));
+
+    auto counted_kmers = [&](utils::KMerSplitter<RtSeq> &splitter) {
+        utils::KMerDiskCounter<RtSeq> counter(workdir, splitter);
+        counter.Count(4, 2);
+
+        size_t kmer_size = RtSeq::GetDataSize(k + 1) * sizeof(RtSeq::DataType);
+        std::set<string> res;
+        for (unsigned i = 0; i < counter.num_buckets(); ++i) {
+            auto bucket = counter.GetBucket(i);
+            for (size_t pos = 0; pos < bucket->data_size(); pos += kmer_size)
+                res.insert(string((const char*)bucket->data() + pos, kmer_size));
+        }
+        BOOST_CHECK_EQUAL(counter.kmers(), res.size());
+        return res;
+    };
+
+    utils::DeBruijnReadKMerSplitter<io::SingleRead, KmerFilter> splitter(workdir, k + 1, 0xDEADBEEF, streams);
+    auto expected = counted_kmers(splitter);
+    BOOST_CHECK(!expected.empty());
+
+    utils::DeBruijnReadSuperKMerSplitter<io::SingleRead, KmerFilter> super_splitter(workdir, k + 1, 0xDEADBEEF, streams);
+    BOOST_CHECK(expected == counted_kmers(super_splitter));
+
+    // Tiny buffers, so that the raw files are expanded by several chunks
+    utils::DeBruijnReadSuperKMerSplitter<io::SingleRead, KmerFilter> chunked_splitter(workdir, k + 1, 0xDEADBEEF, streams,
+                                                                                      nullptr, 256);
+    BOOST_CHECK(expected == counted_kmers(chunked_splitter));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 }
@@ -8,6 +8,7 @@
 
 #include <boost/test/unit_test.hpp>
 #include "paired_info/paired_info_helpers.hpp"
+#include "paired_info/flat_pair_info_buffer.hpp"
 
 namespace debruijn_graph {
 
@@ -414,6 +415,44 @@ BOOST_AUTO_TEST_CASE(PairedInfoMerge) {
 }
 
 
+BOOST_AUTO_TEST_CASE(PairedInfoFlatBuffer) {
+    MockGraph graph;
+    std::vector<std::pair<std::pair<int, int>, RawPoint>> points = {
+        {{1, 3}, {10, 1}}, {{1, 3}, {10, 2}}, {{4, 2}, {12, 1}}, {{1, 3}, {11, 1}},
+        {{1, 9}, {20, 1}}, {{1, 1}, {0, 1}}, {{2, 2}, {0, 1}}, {{3, 13}, {5, 3}}};
+    MockIndex etalon(graph);
+    for (const auto &p : points)
+        etalon.Add(p.first.first, p.first.second, p.second);
+
+    // Without flushes and with every third point of a thread flushed into the index
+    for (bool flush : { false, true }) {
+        MockIndex pi(graph);
+        FlatPairedBuffer<MockGraph, RawPointTraits> buffer(graph, 2);
+        if (flush) {
+            buffer.clear(2, 3 * sizeof(std::pair<std::pair<int, int>, RawGapPoint>));
+            buffer.FlushTo(pi);
+        }
+        for (size_t i = 0; i < points.size(); ++i) {
+            const auto &p = points[i];
+            buffer.Add(i % 2, p.first.first, p.first.second, p.second);
+        }
+        if (flush)
+            BOOST_CHECK(buffer.size() < points.size() && pi.size() > 0);
+        else
+            BOOST_CHECK_EQUAL(buffer.size(), points.size());
+
+        buffer.FillIndex(pi);
+        BOOST_CHECK_EQUAL(buffer.size(), 0);
+        BOOST_CHECK_EQUAL(pi.size(), etalon.size());
+        BOOST_CHECK_EQUAL(GetEdgePairInfo(pi), GetEdgePairInfo(etalon));
+        for (auto i = omnigraph::de::pair_begin(etalon); i != omnigraph::de::pair_end(etalon); ++i)
+            for (auto p : *i)
+                for (auto q : pi.Get(i.first(), i.second()))
+                    if (math::eq(p.d, q.d))
+                        BOOST_CHECK_EQUAL(p.weight, q.weight);
+    }
+}
+
 BOOST_AUTO_TEST_CASE(PairedInfoPairTraverse) {
     MockGraph graph;
     MockIndex pi(graph);
@@ -20,6 +20,7 @@
 #include "test_utils.hpp"
 #include "modules/path_extend/path_visualizer.hpp"
 #include "modules/path_extend/pe_utils.hpp"
+#include "modules/path_extend/pe_resolver.hpp"
 namespace path_extend {
 
 BOOST_FIXTURE_TEST_SUITE(path_extend_basic, fs::TmpFolderFixture)
@@ -764,6 +765,84 @@ BOOST_AUTO_TEST_CASE( BidirectionalPathLoopDetector ) {
     BOOST_CHECK_EQUAL(path1.Back(), e7);
 }
 
+//Follows the first outgoing edge until a used unique one, the path through the second one is added to the storage
+class FirstEdgeExtender : public PathExtender {
+    UsedUniqueStorage &used_storage_;
+    size_t max_length_;
+
+public:
+    FirstEdgeExtender(const Graph &g, UsedUniqueStorage &used_storage, size_t max_length)
+            : PathExtender(g), used_storage_(used_storage), max_length_(max_length) {}
+
+    bool MakeGrowStep(BidirectionalPath& path, PathContainer* paths_storage) override {
+        if (path.Length() >= max_length_ || g_.OutgoingEdgeCount(g_.EdgeEnd(path.Back())) == 0)
+            return false;
+
+        auto edges = g_.OutgoingEdges(g_.EdgeEnd(path.Back()));
+        auto it = edges.begin();
+        EdgeId e = *it;
+        if (path.Contains(e))
+            return false;
+
+        if (paths_storage && ++it != edges.end()) {
+            BidirectionalPath *p = new BidirectionalPath(path);
+            p->PushBack(*it);
+            paths_storage->AddPair(p, new BidirectionalPath(p->Conjugate()));
+        }
+        return used_storage_.TryUseEdge(path, e, Gap());
+    }
+};
+
+//Speculative growth is used when the factory is given
+static void GrowSeeds(const Graph &g, PathContainer &seeds, const ScaffoldingUniqueEdgeStorage &unique,
+                      int nthreads, bool speculative, GraphCoverageMap &cover_map, PathContainer &paths) {
+    auto make_extenders = [&g](const GraphCoverageMap&, UsedUniqueStorage& used_storage) {
+        return CompositeExtender::Extenders{ std::make_shared<FirstEdgeExtender>(g, used_storage, 3000) };
+    };
+
+    int max_threads = omp_get_max_threads();
+    omp_set_num_threads(nthreads);
+    UsedUniqueStorage used_storage(unique);
+    CompositeExtender extender(g, cover_map, used_storage, make_extenders(cover_map, used_storage),
+                               speculative ? CompositeExtender::ExtendersFactory(make_extenders) : nullptr);
+    extender.GrowAll(seeds, paths);
+    omp_set_num_threads(max_threads);
+}
+
+BOOST_AUTO_TEST_CASE( SpeculativeSeedGrowth ) {
+    debruijn_graph::conj_graph_pack gp(55, "tmp", 0);
+    graphio::ScanBasicGraph("./src/test/debruijn/graph_fragments/ecoli_400k/distance_estimation", gp.g);
+    const Graph &g = gp.g;
+    //Seeds share unique edges, so the used ones are looked up by the speculations
+    ScaffoldingUniqueEdgeStorage unique;
+    ScaffoldingUniqueEdgeAnalyzer(gp, 500, 0.5).FillUniqueEdgeStorage(unique);
+    BOOST_REQUIRE(unique.size() > 0);
+
+    PathExtendResolver resolver(g);
+    auto seeds = resolver.MakeSimpleSeeds();
+    seeds.SortByLength();
+
+    GraphCoverageMap cover_map(g);
+    PathContainer paths;
+    GrowSeeds(g, seeds, unique, 1, false, cover_map, paths);
+    BOOST_CHECK(paths.size() > 0);
+
+    for (int nthreads : { 1, 4 }) {
+        GraphCoverageMap speculative_cover_map(g);
+        PathContainer speculative_paths;
+        GrowSeeds(g, seeds, unique, nthreads, true, speculative_cover_map, speculative_paths);
+
+        BOOST_REQUIRE_EQUAL(paths.size(), speculative_paths.size());
+        for (size_t i = 0; i < paths.size(); ++i) {
+            BOOST_CHECK(*paths.Get(i) == *speculative_paths.Get(i));
+            BOOST_CHECK(*paths.GetConjugate(i) == *speculative_paths.GetConjugate(i));
+            if (i > 0)
+                BOOST_CHECK(speculative_paths.Get(i - 1)->GetId() < speculative_paths.Get(i)->GetId());
+        }
+        for (auto it = g.ConstEdgeBegin(); !it.IsEnd(); ++it)
+            BOOST_CHECK_EQUAL(cover_map.GetCoverage(*it), speculative_cover_map.GetCoverage(*it));
+    }
+}
 
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,97 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <numeric>
+
+#include "pipeline/stage.hpp"
+#include "pipeline/graph_pack.hpp"
+
+namespace debruijn_graph {
+
+BOOST_FIXTURE_TEST_SUITE(stage_profiler_tests, fs::TmpFolderFixture)
+
+class DummyStage : public spades::AssemblyStage {
+public:
+    DummyStage(const char *name, const char *id)
+            : AssemblyStage(name, id) {}
+
+    void run(conj_graph_pack &, const char *) override {
+        std::vector<size_t> v(1 << 20);
+        std::iota(v.begin(), v.end(), 0);
+        BOOST_CHECK_EQUAL(v.back(), v.size() - 1);
+    }
+};
+
+class DummyCompositeStage : public spades::CompositeStageBase {
+public:
+    class DummyPhase : public PhaseBase {
+    public:
+        DummyPhase(const char *name, const char *id)
+                : PhaseBase(name, id) {}
+
+        void run(conj_graph_pack &, const char *) override {}
+    };
+
+    DummyCompositeStage()
+            : CompositeStageBase("Composite", "composite") {
+        add<DummyPhase>("First phase", "first_phase");
+        add<DummyPhase>("Second \"phase\"", "second_phase");
+    }
+
+    void init(conj_graph_pack &, const char *) override {}
+    void fini(conj_graph_pack &) override {}
+};
+
+BOOST_AUTO_TEST_CASE( TestStageProfileReport ) {
+    conj_graph_pack gp(5, "tmp", 0);
+    std::string report = fs::append_path("tmp", "stage_profile.json");
+
+    spades::StageManager manager;
+    manager.add<DummyStage>("Dummy", "dummy")
+           .add<DummyCompositeStage>();
+    manager.profiler().set_report(report);
+    manager.run(gp);
+
+    // Phases are recorded before the stage they belong to
+    const auto &records = manager.profiler().records();
+    std::vector<std::string> ids = { "dummy", "composite:first_phase", "composite:second_phase", "composite" };
+    BOOST_REQUIRE_EQUAL(records.size(), ids.size());
+
+    boost::property_tree::ptree pt;
+    boost::property_tree::read_json(report, pt);
+    const auto &stages = pt.get_child("stages");
+    BOOST_REQUIRE_EQUAL(stages.size(), ids.size());
+
+    size_t i = 0;
+    for (const auto &entry : stages) {
+        const auto &stage = entry.second;
+        BOOST_CHECK_EQUAL(records[i].id, ids[i]);
+        BOOST_CHECK_EQUAL(stage.get<std::string>("id"), ids[i]);
+        BOOST_CHECK_EQUAL(stage.get<std::string>("name"), records[i].name);
+        BOOST_CHECK_EQUAL(stage.get<std::string>("type"), records[i].phase ? "phase" : "stage");
+        BOOST_CHECK_EQUAL(stage.get<size_t>("threads"), records[i].threads);
+        BOOST_CHECK(stage.get<double>("wall_time") >= 0);
+        BOOST_CHECK(stage.get<double>("cpu_time") >= 0);
+        BOOST_CHECK(stage.get<double>("thread_utilization") >= 0);
+        BOOST_CHECK(stage.get<size_t>("max_rss") > 0);
+        for (const char *key : { "max_rss_delta", "heap_allocated", "heap_allocated_delta",
+                                 "heap_active", "heap_active_delta", "read_chars", "write_chars",
+                                 "storage_read", "storage_write" })
+            BOOST_CHECK(stage.get_optional<long long>(key));
+        ++i;
+    }
+    BOOST_CHECK_EQUAL(records[2].name, "Second \"phase\"");
+    BOOST_CHECK(!records[0].phase && records[1].phase && records[2].phase && !records[3].phase);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+}
@@ -252,4 +252,88 @@ void CheckIndex(const vector<string> &reads, size_t k) {
     }
 }
 
+template<class graph_pack>
+void CheckIndexSaveLoad(const vector<string> &reads, size_t k) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    graph_pack gp(k, "tmp", 0);
+    auto workdir = fs::tmp::make_temp_dir(gp.workdir, "tests");
+    auto stream = io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads)));
+    io::ReadStreamList<io::SingleRead> streams(stream);
+    ConstructGraph(config::debruijn_config::construction(), workdir,
+                   streams, gp.g, gp.index);
+
+    std::string filename = workdir->dir() + "/index";
+    graphio::SaveEdgeIndex(filename, gp.index.inner_index());
+    BOOST_CHECK(graphio::LoadEdgeIndex(filename, gp.index.inner_index()));
+    // Save the mapped index once again, the file should not be overwritten in-place
+    graphio::SaveEdgeIndex(filename, gp.index.inner_index());
+    BOOST_CHECK(graphio::LoadEdgeIndex(filename, gp.index.inner_index()));
+    // Only coverage is loaded, positions are restored from the graph
+    gp.index.Update();
+
+    stream->reset();
+    io::SingleRead read;
+    while(!(stream->eof())) {
+        (*stream) >> read;
+        RtSeq kmer = read.sequence().start<RtSeq>(k + 1) >> 'A';
+        for(size_t i = k; i < read.size(); i++) {
+            kmer = kmer << read[i];
+            BOOST_CHECK(gp.index.contains(kmer));
+        }
+    }
+}
+
+template<class graph_pack>
+void CheckReadMapping(const vector<string> &reads, size_t k) {
+    typedef io::VectorReadStream<io::SingleRead> RawStream;
+    graph_pack gp(k, "tmp", 0);
+    auto workdir = fs::tmp::make_temp_dir(gp.workdir, "tests");
+    auto stream = io::RCWrap<io::SingleRead>(make_shared<RawStream>(MakeReads(reads)));
+    io::ReadStreamList<io::SingleRead> streams(stream);
+    ConstructGraph(config::debruijn_config::construction(), workdir,
+                   streams, gp.g, gp.index);
+    gp.kmer_mapper.Attach();
+    gp.EnsureBasicMapping();
+    auto mapper = MapperInstance(gp);
+
+    vector<io::SingleRead> batch;
+    for (const string &s : reads) {
+        // Mask some nucleotides so that the read is split into several parts
+        string masked = s;
+        masked[k + 1] = 'N';
+        masked[k + 2] = 'N';
+        masked.back() = 'N';
+        io::SingleRead read("read", masked);
+
+        MappingPath<EdgeId> etalon;
+        etalon.join(mapper->MapSequence(Sequence(s.substr(0, k + 1))), 0);
+        etalon.join(mapper->MapSequence(Sequence(s.substr(k + 3, s.size() - k - 4))), int(k + 3));
+
+        MappingPath<EdgeId> path = mapper->MapRead(read);
+        BOOST_CHECK_EQUAL(etalon.size(), path.size());
+        for (size_t i = 0; i < std::min(etalon.size(), path.size()); ++i) {
+            BOOST_CHECK_EQUAL(etalon[i].first, path[i].first);
+            BOOST_CHECK_EQUAL(etalon[i].second, path[i].second);
+        }
+
+        batch.push_back(read);
+        batch.push_back(io::SingleRead("read", s));
+    }
+
+    vector<MappingPath<EdgeId>> paths;
+    // The second call should reuse the paths filled by the first one
+    for (size_t attempt = 0; attempt < 2; ++attempt) {
+        mapper->MapReads(batch, paths);
+        BOOST_CHECK_EQUAL(batch.size(), paths.size());
+        for (size_t i = 0; i < batch.size(); ++i) {
+            MappingPath<EdgeId> path = mapper->MapRead(batch[i]);
+            BOOST_CHECK_EQUAL(path.size(), paths[i].size());
+            for (size_t j = 0; j < std::min(path.size(), paths[i].size()); ++j) {
+                BOOST_CHECK_EQUAL(path[j].first, paths[i][j].first);
+                BOOST_CHECK_EQUAL(path[j].second, paths[i][j].second);
+            }
+        }
+    }
+}
+
 }
@@ -0,0 +1,89 @@
+//***************************************************************************
+//* Copyright (c) 2015 Saint Petersburg State University
+//* Copyright (c) 2011-2014 Saint Petersburg Academic University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#ifndef HAMMER_HAMCLUSTERTEST_HPP_
+#define HAMMER_HAMCLUSTERTEST_HPP_
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <boost/property_tree/info_parser.hpp>
+#include "cute/cute.h"
+#include "adt/concurrent_dsu.hpp"
+#include "config_struct_hammer.hpp"
+#include "globals.hpp"
+#include "hamcluster.hpp"
+#include "kmer_data.hpp"
+
+// Groups of k-mers within a few substitutions from random centers
+static void FillSimilarKMers(KMerData &data) {
+  std::srand(42);
+  for (size_t center = 0; center < 300; ++center) {
+    std::string s(hammer::K, 'A');
+    for (char &c : s)
+      c = nucl(std::rand() % 4);
+
+    for (size_t variant = 0; variant < 60; ++variant) {
+      std::string v = s;
+      for (int subst = std::rand() % 4; subst > 0; --subst)
+        v[std::rand() % hammer::K] = nucl(std::rand() % 4);
+      data.push_back(hammer::KMer(v.c_str()), KMerStat());
+    }
+  }
+}
+
+static std::vector<size_t> HammingClusters(const KMerData &data, unsigned tau, bool in_memory) {
+  cfg::get_writable().hamming_in_memory = in_memory;
+  cfg::get_writable().general_tau = tau;
+
+  std::vector<uint32_t> positions(tau + 2);
+  for (unsigned i = 0; i < tau + 1; ++i)
+    positions[i] = i * hammer::K / (tau + 1);
+  positions[tau + 1] = hammer::K;
+  Globals::subKMerPositions = &positions;
+
+  dsu::ConcurrentDSU uf(data.size());
+  KMerHamClusterer(tau).cluster("hamcluster_test", data, uf);
+  Globals::subKMerPositions = NULL;
+
+  // Every k-mer is labeled by the first k-mer of its cluster
+  std::map<size_t, size_t> first;
+  std::vector<size_t> res(data.size());
+  for (size_t i = 0; i < data.size(); ++i)
+    res[i] = first.insert({ uf.find_set(i), i }).first->second;
+
+  return res;
+}
+
+void TestHammingClustersInMemory() {
+  boost::property_tree::ptree pt;
+  boost::property_tree::read_info("./configs/hammer/config.info", pt);
+  pt.put("dataset", "./configs/debruijn/toy.yaml");
+  cfg::create_instance(pt);
+  cfg::get_writable().general_max_nthreads = 4;
+  // Small threshold, so that the big blocks are split on the second pass too
+  cfg::get_writable().hamming_blocksize_quadratic_threshold = 8;
+
+  KMerData data;
+  FillSimilarKMers(data);
+
+  for (unsigned tau = 1; tau <= 3; ++tau) {
+    std::vector<size_t> expected = HammingClusters(data, tau, false);
+    std::vector<size_t> actual = HammingClusters(data, tau, true);
+    ASSERT_EQUAL(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+      ASSERT_EQUAL(expected[i], actual[i]);
+  }
+}
+
+cute::suite HamClusterSuite() {
+  cute::suite s;
+  s.push_back(CUTE(TestHammingClustersInMemory));
+  return s;
+}
+
+#endif  // HAMMER_HAMCLUSTERTEST_HPP_
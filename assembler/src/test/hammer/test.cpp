@@ -9,10 +9,24 @@
 #include "cute/cute_runner.h"
 #include "cute/ide_listener.h"
 #include "valid_kmer_generator_test.hpp"
+#include "hamcluster_test.hpp"
+
+std::vector<uint32_t> * Globals::subKMerPositions = NULL;
+KMerData *Globals::kmer_data = NULL;
+int Globals::iteration_no = 0;
+
+char Globals::char_offset = 0;
+bool Globals::char_offset_user = true;
+
+double Globals::quality_probs[256] = { 0 };
+double Globals::quality_lprobs[256] = { 0 };
+double Globals::quality_rprobs[256] = { 0 };
+double Globals::quality_lrprobs[256] = { 0 };
 
 void runSuite() {
   cute::suite s;
   s += ValidKMerGeneratorSuite();
+  s += HamClusterSuite();
   cute::ide_listener lis;
   cute::makeRunner(lis)(s, "The Suite");
 }
@@ -0,0 +1,118 @@
+//***************************************************************************
+//* Copyright (c) 2017 Saint Petersburg State University
+//* All Rights Reserved
+//* See file LICENSE for details.
+//***************************************************************************
+
+#pragma once
+
+#include <boost/test/unit_test.hpp>
+#include <fstream>
+#include <iterator>
+
+#include "io/reads/binary_converter.hpp"
+#include "io/reads/binary_streams.hpp"
+#include "io/reads/vector_reader.hpp"
+#include "utils/filesystem/path_helper.hpp"
+
+BOOST_FIXTURE_TEST_SUITE(binary_reads_tests, fs::TmpFolderFixture)
+
+static std::vector<io::SingleRead> MakeBinaryTestReads(size_t count) {
+    std::vector<io::SingleRead> reads;
+    uint64_t state = 42;
+    for (size_t i = 0; i < count; ++i) {
+        std::string s(50 + i % 100, 'A');
+        for (char &c : s) {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            c = nucl(char(state >> 62));
+        }
+        reads.emplace_back("read", s);
+    }
+    return reads;
+}
+
+static std::vector<Sequence> ReadAll(io::ReadStream<io::SingleReadSeq> &stream) {
+    std::vector<Sequence> res;
+    io::SingleReadSeq read;
+    while (!stream.eof()) {
+        stream >> read;
+        res.push_back(read.sequence());
+    }
+    return res;
+}
+
+BOOST_AUTO_TEST_CASE( TestBinaryReadsBlocks ) {
+    const size_t file_num = 2;
+    auto reads = MakeBinaryTestReads(100000);
+    io::ReadStreamStat stat;
+    {
+        io::VectorReadStream<io::SingleRead> stream(reads);
+        io::BinaryWriter writer("tmp/reads", file_num, 1 << 20);
+        stat = writer.ToBinary(stream);
+    }
+    BOOST_CHECK_EQUAL(reads.size(), stat.read_count);
+    BOOST_CHECK_EQUAL(149, stat.max_len);
+
+    for (size_t i = 0; i < file_num; ++i) {
+        std::vector<Sequence> etalon;
+        for (size_t j = i; j < reads.size(); j += file_num)
+            etalon.push_back(reads[j].sequence());
+
+        io::BinaryFileSingleStream stream("tmp/reads", i);
+        std::vector<Sequence> all = ReadAll(stream);
+        BOOST_CHECK(etalon == all);
+
+        // Read once again after reset
+        stream.reset();
+        BOOST_CHECK(etalon == ReadAll(stream));
+
+        // Split the file into two streams by blocks
+        size_t blocks = io::BinaryFileBlockCount("tmp/reads", i);
+        BOOST_CHECK(blocks > 1);
+        io::BinaryFileSingleStream first("tmp/reads", i, 0, blocks / 2), second("tmp/reads", i, blocks / 2);
+        std::vector<Sequence> parts = ReadAll(first), rest = ReadAll(second);
+        BOOST_CHECK(!parts.empty() && !rest.empty());
+        parts.insert(parts.end(), rest.begin(), rest.end());
+        BOOST_CHECK(etalon == parts);
+    }
+}
+
+static std::string FileContents(const std::string &fname) {
+    std::ifstream f(fname, std::ios_base::binary);
+    return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+}
+
+BOOST_AUTO_TEST_CASE( TestBinaryConversionThreads ) {
+    const size_t file_num = 3;
+    auto reads = MakeBinaryTestReads(30000);
+    int max_threads = omp_get_max_threads();
+
+    std::vector<std::string> etalon;
+    for (int nthreads : { 1, 2, 4 }) {
+        omp_set_num_threads(nthreads);
+        io::ReadStreamStat stat;
+        {
+            io::VectorReadStream<io::SingleRead> stream(reads);
+            io::BinaryWriter writer("tmp/threads", file_num, 1 << 20);
+            stat = writer.ToBinary(stream);
+        }
+        BOOST_CHECK_EQUAL(reads.size(), stat.read_count);
+
+        std::vector<std::string> contents;
+        for (size_t i = 0; i < file_num; ++i)
+            contents.push_back(FileContents("tmp/threads_" + std::to_string(i) + ".seq"));
+        if (etalon.empty())
+            etalon = contents;
+        // Files do not depend on the number of workers
+        BOOST_CHECK(etalon == contents);
+    }
+    omp_set_num_threads(max_threads);
+
+    io::BinaryFileSingleStream stream("tmp/threads", 1);
+    std::vector<Sequence> etalon_reads;
+    for (size_t j = 1; j < reads.size(); j += file_num)
+        etalon_reads.push_back(reads[j].sequence());
+    BOOST_CHECK(etalon_reads == ReadAll(stream));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
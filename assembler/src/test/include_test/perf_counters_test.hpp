@@ -0,0 +1,55 @@
+#pragma once
+#include <boost/test/unit_test.hpp>
+#include "utils/perf/hot_counters.hpp"
+#include "utils/parallel/openmp_wrapper.h"
+
+#include <algorithm>
+#include <numeric>
+
+inline const utils::perf::counter_value *FindCounter(const std::vector<utils::perf::counter_value> &values,
+                                                     const std::string &name) {
+    auto it = std::find_if(values.begin(), values.end(),
+                           [&](const utils::perf::counter_value &value) { return value.name == name; });
+    return it == values.end() ? nullptr : &*it;
+}
+
+// Counters report values only in the build with SPADES_ENABLE_PERF_COUNTERS
+BOOST_AUTO_TEST_CASE( TestPerfCounters ) {
+    utils::perf::reset();
+#   pragma omp parallel for num_threads(4)
+    for (size_t i = 0; i < 1000; ++i) {
+        PERF_SCOPED_TIMER("perf_counters_test.timer");
+        PERF_COUNT("perf_counters_test.count", 2);
+        PERF_HISTOGRAM("perf_counters_test.histogram", i);
+    }
+    auto values = utils::perf::collect();
+
+#ifdef SPADES_ENABLE_PERF_COUNTERS
+    const auto *count = FindCounter(values, "perf_counters_test.count");
+    BOOST_REQUIRE(count);
+    BOOST_CHECK(count->kind == utils::perf::counter_kind::count);
+    BOOST_CHECK_EQUAL(count->count, 1000u);
+    BOOST_CHECK_EQUAL(count->total, 2000u);
+
+    const auto *histogram = FindCounter(values, "perf_counters_test.histogram");
+    BOOST_REQUIRE(histogram);
+    BOOST_CHECK_EQUAL(histogram->count, 1000u);
+    BOOST_CHECK_EQUAL(histogram->total, 999u * 1000u / 2);
+    // Values with bit width 0..10, the last bucket holds 512..999
+    BOOST_REQUIRE_EQUAL(histogram->buckets.size(), 11u);
+    BOOST_CHECK_EQUAL(histogram->buckets[0], 1u);
+    BOOST_CHECK_EQUAL(histogram->buckets[1], 1u);
+    BOOST_CHECK_EQUAL(histogram->buckets[2], 2u);
+    BOOST_CHECK_EQUAL(histogram->buckets[10], 488u);
+    BOOST_CHECK_EQUAL(std::accumulate(histogram->buckets.begin(), histogram->buckets.end(), uint64_t(0)), 1000u);
+
+    const auto *timer = FindCounter(values, "perf_counters_test.timer");
+    BOOST_REQUIRE(timer);
+    BOOST_CHECK(timer->kind == utils::perf::counter_kind::timer);
+    BOOST_CHECK_EQUAL(timer->count, 1000u);
+#else
+    BOOST_CHECK(!FindCounter(values, "perf_counters_test.count"));
+    BOOST_CHECK(!FindCounter(values, "perf_counters_test.histogram"));
+    BOOST_CHECK(!FindCounter(values, "perf_counters_test.timer"));
+#endif
+}
@@ -8,6 +8,7 @@
 #pragma once
 #include <boost/test/unit_test.hpp>
 #include "sequence/sequence.hpp"
+#include "sequence/sequence_arena.hpp"
 #include "sequence/nucl.hpp"
 #include <string>
 #include "utils/perf/memory.hpp"
@@ -70,6 +71,31 @@ BOOST_AUTO_TEST_CASE( TestSequenceRefCount2 ) {
     delete ss;
 }
 
+BOOST_AUTO_TEST_CASE( TestSequenceArenaAppend ) {
+    SequenceArena arena(64);
+    Sequence s1 = arena.Append(Sequence("ACGTACGTACGTAAGT"));
+    Sequence s2 = arena.Append(Sequence("TTGCA"));
+    // Does not fit into the block
+    Sequence s3 = arena.Append(Sequence("ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT"));
+    BOOST_CHECK_EQUAL("ACGTACGTACGTAAGT", s1.str());
+    BOOST_CHECK_EQUAL("TTGCA", s2.str());
+    BOOST_CHECK_EQUAL("TGCAA", (!s2).str());
+    BOOST_CHECK_EQUAL(68, s3.size());
+    BOOST_CHECK_EQUAL("ACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGTACGT", s3.str());
+}
+
+BOOST_AUTO_TEST_CASE( TestSequenceArenaMerge ) {
+    SequenceArena arena;
+    Sequence s = arena.Append(Sequence("ACGTTGCAAC"));
+    // Adjacent parts are merged back without copying
+    BOOST_CHECK(s == arena.Merge({ s.Subseq(0, 6), s.Subseq(3) }, 3));
+    BOOST_CHECK((!s) == arena.Merge({ (!s).Subseq(0, 6), (!s).Subseq(3) }, 3));
+    BOOST_CHECK_EQUAL("ACGTTGCAACGG",
+                      arena.Merge({ s, Sequence("AACGG") }, 3).str());
+    BOOST_CHECK_EQUAL("GTTGCAACGTCACGTTGCAAC",
+                      arena.Merge({ !s, Sequence("GTCAC"), s }, 2).str());
+}
+
 //todo is it suitable here???
 //BOOST_AUTO_TEST_CASE( TestSequenceMemory ) {
 //    time_t now = time(NULL);
@@ -16,6 +16,8 @@
 #include "quality_test.hpp"
 #include "nucl_test.hpp"
 #include "cyclic_hash_test.hpp"
+#include "binary_reads_test.hpp"
+#include "perf_counters_test.hpp"
 
 #define BOOST_TEST_SOURCE
 #include <boost/test/impl/unit_test_main.ipp>
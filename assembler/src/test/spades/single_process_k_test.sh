@@ -0,0 +1,61 @@
+#!/bin/bash
+
+############################################################################
+# Copyright (c) 2017 Saint Petersburg State University
+# All Rights Reserved
+# See file LICENSE for details.
+############################################################################
+
+# Checks that spades.py with --single-process-k runs the same K values and
+# produces the same output layout as the usual run with one spades-core
+# process per K. Both the explicit K list (with a K above the read length)
+# and the default K values are checked on the E. coli 1K test dataset.
+
+if [ "$#" -ne 1 ]; then
+    echo "Usage: single_process_k_test.sh <spades.py>"
+    exit 1
+fi
+
+set -e
+
+spades=$(readlink -f $1)
+data_dir=$(cd $(dirname $spades)/test_dataset && pwd)
+work_dir=$(mktemp -d)
+trap "rm -rf $work_dir" EXIT
+
+# Files of the output, except for the per-process configs and logs
+layout() {
+    (cd $1 && find . -path ./tmp -prune -o -path '*/configs' -prune -o -type f -print |
+              grep -v -e '\.log$' -e 'params.txt$' -e 'stage_profile.json$' | sort)
+}
+
+status=0
+for k in "-k 21,33,55,127" ""; do
+    for mode in multi single; do
+        opts=""
+        if [ $mode == single ]; then
+            opts="--single-process-k"
+        fi
+        $spades --only-assembler -t 4 $k $opts -o $work_dir/$mode \
+                -1 $data_dir/ecoli_1K_1.fq.gz -2 $data_dir/ecoli_1K_2.fq.gz > $work_dir/$mode.log 2>&1
+    done
+
+    multi_K=$(cd $work_dir/multi && ls -d K*)
+    single_K=$(cd $work_dir/single && ls -d K*)
+    echo "K values (${k:-default}): " $multi_K
+    if [ "$multi_K" != "$single_K" ]; then
+        echo "K values differ, single process: " $single_K
+        status=1
+    fi
+
+    if ! diff <(layout $work_dir/multi) <(layout $work_dir/single); then
+        echo "Output layouts differ"
+        status=1
+    fi
+    rm -rf $work_dir/multi $work_dir/single
+done
+
+if [ $status == 0 ]; then
+    echo "K values and output layouts are the same"
+fi
+exit $status
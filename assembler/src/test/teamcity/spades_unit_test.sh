@@ -26,10 +26,29 @@ then
     exit $errlvl
 fi
 
+# Hot path counters are compiled out by default, make sure they still build
+make pt
+errlvl=$?
+if [ "$errlvl" -ne 0 ]
+then
+    echo "make pt finished with exit code $errlvl"
+    exit $errlvl
+fi
+
+make rcrt
+errlvl=$?
+if [ "$errlvl" -ne 0 ]
+then
+    echo "make rcrt finished with exit code $errlvl"
+    exit $errlvl
+fi
+
 echo "### RUNNING ###"
 
 set -e
 ./run rdt
+./run pt
+./run rcrt
 
 errlvl=$?
 